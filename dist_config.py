@@ -1,8 +1,8 @@
 import os
 
 package = 'libt3highlight'
-excludesrc = '/(Makefile|TODO.*|SciTE.*|test\.c|run|valgrind|debug)$'
-auxsources = [ 'src/.objects/*.bytes', 'src.util/.objects/*.bytes', 'src/highlight_api.h',
+excludesrc = '/(Makefile|TODO.*|SciTE.*|test\.c|run|valgrind|debug|gen_builtin_data\.sh)$'
+auxsources = [ 'src/.objects/*.bytes', 'src/.objects/builtin_data.h', 'src.util/.objects/*.bytes', 'src/highlight_api.h',
 	'src/highlight_errors.h', 'src/highlight_shared.c' ]
 auxfiles = [ 'doc/doxygen.conf', 'doc/DoxygenLayout.xml', 'doc/main_doc.h' ]
 extrabuilddirs = [ 'doc' ]
@@ -145,9 +145,10 @@ the @c format key.
 
 @section highlight_definitions Highlight Definitions
 
-A highlight definition can have three forms: a single matching item using the
-@c regex key, a state definition using the @c start and @c end keys, and a
-reference to a named highlight using the @c use key.
+A highlight definition can have four forms: a single matching item using the
+@c regex key, a list of words using the @c keywords key (format @c 3 files
+only), a state definition using the @c start and @c end keys, and a reference
+to a named highlight using the @c use key.
 
 @subsection single_regex Single Regular Expression
 
@@ -165,6 +166,30 @@ key. The style can be selected using the @c style key. For example:
 will ensure that the words @c int, @c float and @c bool will be styled as
 keywords.
 
+@subsection keywords_list Keywords List
+
+For long lists of words, the regular expression can be replaced by a list of
+the words using the @c keywords key. Rather than trying a regular expression,
+the word at the current position is looked up in a hash table, which is much
+faster for large lists. The example above can be written as:
+
+@verbatim
+%highlight {
+  keywords = ( "int", "float", "bool" )
+  style = "keyword"
+}
+@endverbatim
+
+By default, a word from the list only matches if it is not directly preceded
+or followed by a word character, like the @c \b construct in regular
+expressions. Word characters are letters, digits and the underscore. Further
+characters can be added using the @c word-chars key, e.g.
+<code>word-chars = "-$"</code>. Setting the @c word-boundary key to @c false
+will make the words match anywhere, in which case the longest matching word is
+used. When the @c ignore-case key is set to @c true, the words are compared
+without regard to (ASCII) case. The @c exit key can be used as with the @c regex
+key.
+
 @subsection state_definition State Definitions
 
 A state definition uses the @c start and @c end regular-expression keys. Once
@@ -324,6 +349,45 @@ which can be used as follows:
 There is no check for multiple highlights with the same name, and only the
 first defined highlight with a certain name is used.
 
+@section sync Synchronisation Points
+
+Programs which display only a part of a large text, such as editors, would
+rather not highlight the text from the start to find the state at the start of
+the part they display. Format @c 3 files can help them by listing patterns for
+lines from which highlighting can start in a known state, in a top-level @c sync
+section. For example:
+
+@verbatim
+%highlight {
+  start = '/\*'
+  end = '\*/'
+  style = "comment"
+  name = "comment"
+}
+
+sync {
+  max-lines = 500
+  %pattern {
+    regex = '#\s*(?:include|define)\b'
+  }
+  %pattern {
+    regex = '\s+\* '
+    state = "comment"
+  }
+}
+@endverbatim
+
+Each @c @%pattern regular expression is matched at the start of a line. When it
+matches, highlighting is started from that line in the state named by the @c
+state key, or in the initial state if the @c state key is absent. States are
+named using the @c name key of a state definition which can be entered from
+the initial state, either directly or through a @c use key. The @c name key can
+not be combined with the @c extract and @c on-entry keys. The @c max-lines key
+limits the number of lines to look back for a matching pattern, and defaults to
+@c 1000. When no pattern matches within that number of lines, highlighting
+starts in the initial state, which may result in incorrect highlighting of the
+first lines. See t3_highlight_sync for the function using this information.
+
 @section style_names Style Names
 
 As shown in the previous section, the style to be used for highlighting items
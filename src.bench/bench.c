@@ -0,0 +1,582 @@
+/* Copyright (C) 2026 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <t3highlight/highlight.h>
+#include <time.h>
+
+/* This header must be included after all the others to prevent issues with the
+   definition of _. */
+/* clang-format off */
+#include "optionMacros.h"
+/* clang-format on */
+
+#define RESULTS_VERSION 1
+#define DEFAULT_SIZE (4 * 1024 * 1024)
+#define LONG_LINE_SIZE 65536
+#define MINIFIED_LINE_SIZE 32768
+#define NESTING_DEPTH 200
+
+typedef struct {
+  char *data;
+  size_t size, allocated;
+} buffer_t;
+
+/* An input to highlight. Inputs are either read from a corpus file, and repeated until the
+   requested size is reached, or produced by a generator. */
+typedef struct {
+  const char *name;
+  const char *lang_file;
+  const char *corpus_file;
+  void (*generate)(buffer_t *buffer, const buffer_t *sample, size_t size);
+} input_t;
+
+typedef struct {
+  double seconds;
+  size_t lines, tokens;
+  double p50, p99; /* Latency per line in microseconds. */
+  size_t memory;
+} match_result_t;
+
+static long option_size = DEFAULT_SIZE;
+static int option_repeat = 3;
+static const char *option_output;
+static const char *option_filter;
+static int option_no_synthetic;
+
+static input_t *inputs;
+static size_t inputs_used, inputs_allocated;
+
+/* Pseudo random numbers for the generators. A fixed seed is used for each input, such that
+   the generated inputs are the same across runs and commits. */
+static unsigned long random_state;
+
+static void add_input(const char *name, const char *lang_file, const char *corpus_file,
+                      void (*generate)(buffer_t *, const buffer_t *, size_t));
+
+/** Alert the user of a fatal error and quit.
+    @param fmt The format string for the message. See fprintf(3) for details.
+    @param ... The arguments for printing.
+*/
+#ifdef __GNUC__
+void fatal(const char *fmt, ...) __attribute__((noreturn));
+#endif
+void fatal(const char *fmt, ...) {
+  va_list args;
+
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  exit(EXIT_FAILURE);
+}
+
+/* clang-format off */
+static PARSE_FUNCTION(parse_args)
+  OPTIONS
+    OPTION('s', "size", REQUIRED_ARG)
+      PARSE_INT(option_size, 1, 1024L * 1024 * 1024);
+    END_OPTION
+    OPTION('r', "repeat", REQUIRED_ARG)
+      PARSE_INT(option_repeat, 1, 1000);
+    END_OPTION
+    OPTION('o', "output", REQUIRED_ARG)
+      option_output = optArg;
+    END_OPTION
+    OPTION('f', "filter", REQUIRED_ARG)
+      option_filter = optArg;
+    END_OPTION
+    BOOLEAN_LONG_OPTION("no-synthetic", option_no_synthetic)
+    OPTION('h', "help", NO_ARG)
+      printf("Usage: t3highlight-bench [<options>] <corpus file>...\n"
+        "  -f<text>,--filter=<text>        Only run the inputs with <text> in their name\n"
+        "  --no-synthetic                  Don't run the generated inputs\n"
+        "  -o<file>,--output=<file>        Write the results to <file>\n"
+        "  -r<count>,--repeat=<count>      Report the fastest of <count> runs\n"
+        "  -s<bytes>,--size=<bytes>        Highlight at least <bytes> bytes per input\n"
+        "\n"
+        "The language of each corpus file is taken from its name, which must be the\n"
+        "name of a language file without the .lang suffix.\n"
+      );
+      exit(EXIT_SUCCESS);
+    END_OPTION
+    DOUBLE_DASH
+      NO_MORE_OPTIONS;
+    END_OPTION
+
+    fatal(_("No such option %.*s\n"), OPTPRARG);
+  NO_OPTION
+    add_input(NULL, NULL, optcurrent, NULL);
+  END_OPTIONS
+END_FUNCTION
+/* clang-format on */
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char *safe_strdup(const char *str) {
+  char *result;
+  size_t len = strlen(str) + 1;
+
+  if ((result = malloc(len)) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  memcpy(result, str, len);
+  return result;
+}
+
+static void append(buffer_t *buffer, const char *data, size_t size) {
+  if (buffer->allocated - buffer->size < size) {
+    size_t new_allocated = buffer->allocated == 0 ? 65536 : buffer->allocated;
+    char *new_data;
+
+    while (new_allocated - buffer->size < size) {
+      new_allocated *= 2;
+    }
+    if ((new_data = realloc(buffer->data, new_allocated)) == NULL) {
+      fatal(_("Out of memory\n"));
+    }
+    buffer->data = new_data;
+    buffer->allocated = new_allocated;
+  }
+  memcpy(buffer->data + buffer->size, data, size);
+  buffer->size += size;
+}
+
+static void append_string(buffer_t *buffer, const char *string) {
+  append(buffer, string, strlen(string));
+}
+
+/** Append formatted text to @p buffer. The result must fit in 256 bytes. */
+static void append_format(buffer_t *buffer, const char *fmt, ...) {
+  char text[256];
+  va_list args;
+
+  va_start(args, fmt);
+  vsnprintf(text, sizeof(text), fmt, args);
+  va_end(args);
+  append_string(buffer, text);
+}
+
+/** Return a pseudo random number in the range [0, @p range). */
+static unsigned long next_random(unsigned long range) {
+  random_state = random_state * 6364136223846793005UL + 1442695040888963407UL;
+  return (random_state >> 33) % range;
+}
+
+static const char *pick(const char *const *list, size_t count) {
+  return list[next_random(count)];
+}
+
+static void read_file(const char *name, buffer_t *buffer) {
+  char block[65536];
+  size_t bytes_read;
+  FILE *file;
+
+  if ((file = fopen(name, "rb")) == NULL) {
+    fatal(_("Can't open '%s': %s\n"), name, strerror(errno));
+  }
+  while ((bytes_read = fread(block, 1, sizeof(block), file)) > 0) {
+    append(buffer, block, bytes_read);
+  }
+  if (ferror(file)) {
+    fatal(_("Error reading '%s': %s\n"), name, strerror(errno));
+  }
+  fclose(file);
+  if (buffer->size > 0 && buffer->data[buffer->size - 1] != '\n') {
+    append(buffer, "\n", 1);
+  }
+}
+
+/** Generator which repeats the corpus file. */
+static void generate_repeat(buffer_t *buffer, const buffer_t *sample, size_t size) {
+  while (buffer->size < size) {
+    append(buffer, sample->data, sample->size);
+  }
+}
+
+/** Generator which joins the lines of the corpus file into lines of LONG_LINE_SIZE bytes. */
+static void generate_long_lines(buffer_t *buffer, const buffer_t *sample, size_t size) {
+  size_t line_start = 0, i;
+
+  while (buffer->size < size) {
+    for (i = 0; i < sample->size; i++) {
+      if (sample->data[i] != '\n') {
+        append(buffer, sample->data + i, 1);
+      } else if (buffer->size - line_start < LONG_LINE_SIZE) {
+        append(buffer, " ", 1);
+      } else {
+        append(buffer, "\n", 1);
+        line_start = buffer->size;
+      }
+    }
+  }
+  append(buffer, "\n", 1);
+}
+
+/** Generator for Perl code with many here-documents, each with a different terminator. */
+static void generate_perl_heredoc(buffer_t *buffer, const buffer_t *sample, size_t size) {
+  static const char *const quotes[] = {"", "\"", "'"};
+  static const char *const words[] = {"alpha", "$beta", "@{[ gamma() ]}", "delta\\n", "${eps}",
+                                      "zeta", "# not a comment", "'eta'", "\"theta\""};
+  unsigned long count = 0;
+
+  while (buffer->size < size) {
+    const char *quote = pick(quotes, 3);
+    int lines = 1 + next_random(8), i, j;
+
+    append_format(buffer, "my $text%lu = <<%sEND_%lu%s;\n", count, quote, count, quote);
+    for (i = 0; i < lines; i++) {
+      for (j = next_random(10); j >= 0; j--) {
+        append_string(buffer, pick(words, 9));
+        append(buffer, " ", 1);
+      }
+      append(buffer, "\n", 1);
+    }
+    append_format(buffer, "END_%lu\n", count);
+    append_format(buffer, "print $text%lu if $count{%lu}++ < %lu;\n", count, count, count % 7);
+    count++;
+  }
+}
+
+/** Generator for Perl code with deeply nested braces in quote-like operators. */
+static void generate_perl_nesting(buffer_t *buffer, const buffer_t *sample, size_t size) {
+  static const char *const operators[] = {"q", "qq", "qw", "m", "qr"};
+
+  while (buffer->size < size) {
+    int depth = 1 + next_random(NESTING_DEPTH), i;
+
+    append_format(buffer, "my $nested = %s{\n", pick(operators, 5));
+    for (i = 0; i < depth; i++) {
+      append_format(buffer, "%*s{ level %d \\} $x\n", i % 40, "", i);
+    }
+    for (i = depth - 1; i >= 0; i--) {
+      append_format(buffer, "%*s}\n", i % 40, "");
+    }
+    append_string(buffer, "};\n");
+  }
+}
+
+/** Generator for minified JavaScript, with lines of MINIFIED_LINE_SIZE bytes. */
+static void generate_javascript_minified(buffer_t *buffer, const buffer_t *sample, size_t size) {
+  static const char *const tokens[] = {
+      "function(e,t){",  "return ",      "var n=",           "}",           ";",
+      "if(",             "){",           "else{",            "for(var r=0;r<e.length;r++){",
+      "e[r]",            "t.push(",      ")",                "\"string\\\"with escapes\"",
+      "'single'",        "`tpl ${n} x`", "/[a-z]+\\d*/gi",   "0x1F",        "3.14e-2",
+      "!0",              "void 0",       "typeof e==\"undefined\"", "n&&t||r", "a.b.c(d)",
+      "new Map",         "=>",           "(e)=>e*2",         ",",           "this.x=",
+      "/*c*/",           "null",         "{a:1,b:[2,3]}",    "e.replace(/\\s+/g,\" \")"};
+  size_t line_start = buffer->size;
+
+  while (buffer->size < size) {
+    append_string(buffer, pick(tokens, sizeof(tokens) / sizeof(tokens[0])));
+    if (buffer->size - line_start >= MINIFIED_LINE_SIZE) {
+      append(buffer, "\n", 1);
+      line_start = buffer->size;
+    }
+  }
+  append(buffer, "\n", 1);
+}
+
+/** Generator for HTML with deeply nested elements, and embedded scripts and styles. */
+static void generate_html_nesting(buffer_t *buffer, const buffer_t *sample, size_t size) {
+  static const char *const elements[] = {"div", "span", "section", "ul", "li", "table", "td"};
+
+  append_string(buffer, "<!DOCTYPE html>\n<html>\n<body>\n");
+  while (buffer->size < size) {
+    int depth = 1 + next_random(NESTING_DEPTH), i;
+    const char *stack[NESTING_DEPTH];
+
+    for (i = 0; i < depth; i++) {
+      stack[i] = pick(elements, 7);
+      append_format(buffer, "%*s<%s class=\"c%d\" data-x='%lu' id=n%d>text &amp; more\n",
+                    i % 40, "", stack[i], i, next_random(1000), i);
+      if (next_random(16) == 0) {
+        append_format(buffer, "<script>var x%d = \"</div>\" + '<' + %d;</script>\n", i, i);
+      } else if (next_random(16) == 0) {
+        append_format(buffer, "<style>.c%d > p { color: #%06lx; }</style>\n", i,
+                      next_random(0x1000000));
+      } else if (next_random(16) == 0) {
+        append_string(buffer, "<!-- comment <div> -->\n");
+      }
+    }
+    for (i = depth - 1; i >= 0; i--) {
+      append_format(buffer, "%*s</%s>\n", i % 40, "", stack[i]);
+    }
+  }
+  append_string(buffer, "</body>\n</html>\n");
+}
+
+static void add_input(const char *name, const char *lang_file, const char *corpus_file,
+                      void (*generate)(buffer_t *, const buffer_t *, size_t)) {
+  if (inputs_used == inputs_allocated) {
+    input_t *new_inputs;
+    inputs_allocated = inputs_allocated == 0 ? 16 : inputs_allocated * 2;
+    if ((new_inputs = realloc(inputs, inputs_allocated * sizeof(input_t))) == NULL) {
+      fatal(_("Out of memory\n"));
+    }
+    inputs = new_inputs;
+  }
+
+  /* For corpus files, the name of the input and the language follow from the file name. */
+  if (name == NULL) {
+    const char *base = strrchr(corpus_file, '/');
+    char *lang;
+
+    base = base == NULL ? corpus_file : base + 1;
+    name = base;
+    if ((lang = malloc(strlen(base) + 6)) == NULL) {
+      fatal(_("Out of memory\n"));
+    }
+    strcpy(lang, base);
+    strcat(lang, ".lang");
+    lang_file = lang;
+  }
+  inputs[inputs_used].name = name;
+  inputs[inputs_used].lang_file = lang_file;
+  inputs[inputs_used].corpus_file = corpus_file;
+  inputs[inputs_used].generate = generate == NULL ? generate_repeat : generate;
+  inputs_used++;
+}
+
+/** Add the generated inputs, based on the corpus files given on the command line. */
+static void add_synthetic_inputs(void) {
+  static const struct {
+    const char *name;
+    const char *language;
+    void (*generate)(buffer_t *, const buffer_t *, size_t);
+  } generators[] = {{"perl-heredoc", "perl", generate_perl_heredoc},
+                    {"perl-nesting", "perl", generate_perl_nesting},
+                    {"javascript-minified", "javascript", generate_javascript_minified},
+                    {"html-nesting", "html", generate_html_nesting}};
+  size_t corpus_count = inputs_used, i;
+
+  for (i = 0; i < corpus_count; i++) {
+    char *name = malloc(strlen(inputs[i].name) + 12);
+    if (name == NULL) {
+      fatal(_("Out of memory\n"));
+    }
+    strcpy(name, inputs[i].name);
+    strcat(name, "-long-lines");
+    add_input(name, inputs[i].lang_file, inputs[i].corpus_file, generate_long_lines);
+  }
+  for (i = 0; i < sizeof(generators) / sizeof(generators[0]); i++) {
+    char lang_file[32];
+    strcpy(lang_file, generators[i].language);
+    strcat(lang_file, ".lang");
+    add_input(generators[i].name, safe_strdup(lang_file), NULL, generators[i].generate);
+  }
+}
+
+static int map_style(void *data, const char *name) { return strcmp(name, "normal") != 0; }
+
+static t3_highlight_t *load(const char *lang_file) {
+  t3_highlight_error_t error;
+  t3_highlight_t *result;
+
+  if ((result = t3_highlight_load(lang_file, map_style, NULL,
+                                  T3_HIGHLIGHT_USE_PATH | T3_HIGHLIGHT_VERBOSE_ERROR |
+                                      T3_HIGHLIGHT_UTF8,
+                                  &error)) == NULL) {
+    if (error.file_name != NULL) {
+      fatal("%s:%d: %s\n", error.file_name, error.line_number, t3_highlight_strerror(error.error));
+    }
+    fatal(_("Can't load '%s': %s\n"), lang_file, t3_highlight_strerror(error.error));
+  }
+  return result;
+}
+
+static size_t total_bytes(const t3_highlight_stats_t *stats) {
+  return stats->regex_bytes + stats->jit_bytes + stats->table_bytes;
+}
+
+static int compare_double(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : x > y;
+}
+
+/** Measure the time to load @p lang_file. Returns the median in microseconds. */
+static double measure_load(const char *lang_file, double *min, size_t *memory) {
+  double *times, median;
+  int i;
+
+  if ((times = malloc(option_repeat * sizeof(double))) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  for (i = 0; i < option_repeat; i++) {
+    double start = now();
+    t3_highlight_t *highlight = load(lang_file);
+    t3_highlight_stats_t stats;
+
+    times[i] = (now() - start) * 1e6;
+    t3_highlight_get_stats(highlight, &stats);
+    *memory = total_bytes(&stats);
+    t3_highlight_free(highlight);
+  }
+  qsort(times, option_repeat, sizeof(double), compare_double);
+  *min = times[0];
+  median = times[option_repeat / 2];
+  free(times);
+  return median;
+}
+
+/** Highlight all lines in @p text once, and record the time taken for each line. */
+static void run_match(const t3_highlight_t *highlight, const buffer_t *text, double *latencies,
+                      match_result_t *result) {
+  t3_highlight_match_t *match;
+  t3_highlight_stats_t stats;
+  const char *line = text->data, *end = text->data + text->size;
+  double start;
+
+  if ((match = t3_highlight_new_match(highlight)) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+
+  result->lines = 0;
+  result->tokens = 0;
+  start = now();
+  while (line < end) {
+    const char *newline = memchr(line, '\n', end - line);
+    size_t length = newline == NULL ? (size_t)(end - line) : (size_t)(newline - line);
+    double line_start = now();
+
+    t3_highlight_next_line(match);
+    while (t3_highlight_match(match, line, length)) {
+      result->tokens++;
+    }
+    latencies[result->lines++] = (now() - line_start) * 1e6;
+    line += length + 1;
+  }
+  result->seconds = now() - start;
+
+  t3_highlight_get_match_stats(match, &stats);
+  result->memory = stats.table_bytes;
+  t3_highlight_free_match(match);
+
+  qsort(latencies, result->lines, sizeof(double), compare_double);
+  result->p50 = latencies[result->lines / 2];
+  result->p99 = latencies[result->lines * 99 / 100];
+}
+
+static size_t count_lines(const buffer_t *text) {
+  size_t i, count = 0;
+  for (i = 0; i < text->size; i++) {
+    count += text->data[i] == '\n';
+  }
+  return count + (text->size > 0 && text->data[text->size - 1] != '\n');
+}
+
+static void run_input(FILE *out, const input_t *input) {
+  buffer_t sample = {NULL, 0, 0}, text = {NULL, 0, 0};
+  t3_highlight_t *highlight;
+  t3_highlight_stats_t stats;
+  match_result_t best, result;
+  double *latencies;
+  int i;
+
+  if (input->corpus_file != NULL) {
+    read_file(input->corpus_file, &sample);
+    if (sample.size == 0) {
+      fatal(_("Corpus file '%s' is empty\n"), input->corpus_file);
+    }
+  }
+  random_state = 1;
+  input->generate(&text, &sample, option_size);
+  free(sample.data);
+
+  if ((latencies = malloc((count_lines(&text) + 1) * sizeof(double))) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+
+  highlight = load(input->lang_file);
+  for (i = 0; i < option_repeat; i++) {
+    run_match(highlight, &text, latencies, &result);
+    if (i == 0 || result.seconds < best.seconds) {
+      best = result;
+    }
+  }
+  t3_highlight_get_stats(highlight, &stats);
+  best.memory += total_bytes(&stats);
+  t3_highlight_free(highlight);
+
+  fprintf(out, "match\t%s\t%s\t%zu\t%zu\t%zu\t%.2f\t%.0f\t%.2f\t%.2f\t%zu\n", input->name,
+          input->lang_file, text.size, best.lines, best.tokens,
+          text.size / best.seconds / (1024 * 1024), best.tokens / best.seconds, best.p50,
+          best.p99, best.memory);
+  fflush(out);
+  free(latencies);
+  free(text.data);
+}
+
+int main(int argc, char *argv[]) {
+  t3_highlight_lang_t *list;
+  t3_highlight_error_t error;
+  struct rusage usage;
+  FILE *out = stdout;
+  size_t i;
+
+  parse_args(argc, argv);
+  if (inputs_used == 0) {
+    fatal(_("No corpus files specified\n"));
+  }
+  if (!option_no_synthetic) {
+    add_synthetic_inputs();
+  }
+  if (option_output != NULL && (out = fopen(option_output, "w")) == NULL) {
+    fatal(_("Can't open '%s': %s\n"), option_output, strerror(errno));
+  }
+
+  fprintf(out, "# t3highlight-bench %d size=%ld repeat=%d\n", RESULTS_VERSION, option_size,
+          option_repeat);
+
+  /* Load time is measured for all languages, regardless of the inputs. */
+  if ((list = t3_highlight_list(T3_HIGHLIGHT_VERBOSE_ERROR, &error)) == NULL) {
+    fatal(_("Error loading highlight listing: %s\n"), t3_highlight_strerror(error.error));
+  }
+  fprintf(out, "#load\tlanguage\tmedian_us\tmin_us\tmemory\n");
+  for (i = 0; list[i].name != NULL; i++) {
+    double median, min;
+    size_t memory;
+
+    if (option_filter != NULL && strstr(list[i].lang_file, option_filter) == NULL) {
+      continue;
+    }
+    median = measure_load(list[i].lang_file, &min, &memory);
+    fprintf(out, "load\t%s\t%.1f\t%.1f\t%zu\n", list[i].lang_file, median, min, memory);
+  }
+  t3_highlight_free_list(list);
+
+  fprintf(out, "#match\tinput\tlanguage\tbytes\tlines\ttokens\tmb_per_s\ttokens_per_s\tp50_us\t"
+               "p99_us\tmemory\n");
+  for (i = 0; i < inputs_used; i++) {
+    if (option_filter != NULL && strstr(inputs[i].name, option_filter) == NULL) {
+      continue;
+    }
+    run_input(out, &inputs[i]);
+  }
+
+  getrusage(RUSAGE_SELF, &usage);
+  fprintf(out, "maxrss_kb\t%ld\n", usage.ru_maxrss);
+  if (out != stdout && fclose(out) != 0) {
+    fatal(_("Error writing '%s': %s\n"), option_output, strerror(errno));
+  }
+  return EXIT_SUCCESS;
+}
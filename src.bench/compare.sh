@@ -0,0 +1,31 @@
+#!/bin/bash
+
+# Compare two result files written by t3highlight-bench. For each input the old and new values
+# are printed, with the change relative to the old value.
+
+if [ $# -ne 2 ] ; then
+	echo "Usage: compare.sh <old results> <new results>"
+	exit 1
+fi
+
+awk -F'\t' '
+	FNR == NR {
+		if ($1 == "load") {
+			old["load " $2] = $3
+		} else if ($1 == "match") {
+			old["match " $2] = $7
+			old["p99 " $2] = $10
+		}
+		next
+	}
+	function report(key, value, unit) {
+		if (key in old && old[key] > 0) {
+			printf "%-36s %12.2f %12.2f %8.1f%% %s\n", key, old[key], value,
+				(value - old[key]) * 100 / old[key], unit
+		} else {
+			printf "%-36s %12s %12.2f %9s %s\n", key, "-", value, "", unit
+		}
+	}
+	$1 == "load" { report("load " $2, $3, "us") }
+	$1 == "match" { report("match " $2, $7, "MB/s"); report("p99 " $2, $10, "us") }
+' "$1" "$2"
@@ -13,12 +13,21 @@
 */
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <fnmatch.h>
 #include <locale.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
 #include <t3config/config.h>
 #include <t3highlight/highlight.h>
 #include <unistd.h>
@@ -33,19 +42,107 @@
 
 #define DEFAULT_STYLE "esc.style"
 
+#define OUTPUT_BUFFER_SIZE 65536
+#define INPUT_BLOCK_SIZE 65536
+/* Lines longer than this are highlighted in parts when read in blocks. */
+#define LINE_CHUNK_SIZE (1024 * 1024)
+#define ERROR_SIZE 1024
+/* Checkpoints for --index are made every INDEX_LINE_INTERVAL lines or INDEX_BYTE_INTERVAL
+   bytes. If the file would need more than INDEX_MAX_CHECKPOINTS, the intervals are increased
+   to keep the index file small. */
+#define INDEX_LINE_INTERVAL 1000
+#define INDEX_BYTE_INTERVAL (256 * 1024)
+#define INDEX_MAX_CHECKPOINTS 65536
+#define INDEX_HEADER "t3highlight-index"
+
+/* Input from which lines are returned without copying them. Regular files are mapped into
+   memory as a whole. Other files are read in large blocks into buffer, in which case data
+   and size describe the part of the buffer that has been read but not yet returned. The
+   first returned bytes of data are the parts of an incomplete line that were already
+   returned. */
+typedef struct {
+  int fd;
+  const char *data;
+  size_t size;
+  size_t returned;
+  void *mapping;
+  size_t mapping_size;
+  char *buffer;
+  size_t buffer_size;
+  t3_bool eof;
+} input_t;
+
 typedef struct {
   char *tag;
   char *start;
   char *end;
+  size_t start_len;
+  size_t end_len;
 } style_def_t;
 
-typedef struct {
+typedef struct translation_t {
   char *search;
   char *replace;
   size_t search_len;
   size_t replace_len;
+  /* Next translation with the same first byte in the search string. */
+  struct translation_t *next;
 } translation_t;
 
+/* A loaded output style, for a single document type. */
+typedef struct style_t {
+  char *name;
+  char *document_type; /* NULL for the default document type. */
+  style_def_t *defs;
+  translation_t *translations;
+  /* For each byte value, the translations with a search string starting with that byte. */
+  translation_t *translations_by_first[256];
+  char *header;
+  char *footer;
+  struct style_t *next;
+} style_t;
+
+/* Buffered output for a single output file. */
+typedef struct {
+  FILE *file;
+  const style_t *style;
+  const char *name; /* The name of the input file, or NULL for standard input. */
+  int attribute;    /* The attribute of the currently open run, or -1 if none is open. */
+  size_t fill;
+  char buffer[OUTPUT_BUFFER_SIZE];
+} output_t;
+
+/* Highlighting patterns loaded for one language and style. The highlight member is NULL if
+   loading failed, in which case error holds the error message. */
+typedef struct cache_entry_t {
+  char *language; /* The language name if by_name is set, or the language file otherwise. */
+  t3_bool by_name;
+  const style_t *style;
+  t3_highlight_t *highlight;
+  char *error;
+  struct cache_entry_t *next;
+} cache_entry_t;
+
+/* A request read in server mode. */
+typedef struct {
+  char *language;
+  char *style;
+  char *document_type;
+  char *name;
+  char *content;
+  size_t length;
+} request_t;
+
+/* Identification of the contents of an input file, stored in its index file. The hash is only
+   computed if the size or modification time differ, as it requires reading the whole file. */
+typedef struct {
+  uintmax_t size;
+  long long mtime_sec;
+  long mtime_nsec;
+  unsigned long long hash;
+  t3_bool hash_valid;
+} file_key_t;
+
 typedef struct tag_t {
   const char *name;
   const char *value;
@@ -53,12 +150,31 @@ typedef struct tag_t {
   struct tag_t *next;
 } tag_t;
 
-static style_def_t *styles;
-static translation_t *translations;
-static char *header;
-static char *footer;
+static style_t *default_style;
 static tag_t *tags;
 
+/* The input files to highlight. A NULL entry means standard input. */
+static const char **inputs;
+static size_t inputs_used, inputs_allocated;
+/* The highlighting patterns to use for all files, if a language was specified. */
+static t3_highlight_t *fixed_highlight;
+
+static pthread_mutex_t work_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t next_input;
+static t3_bool batch_failed;
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static cache_entry_t *highlight_cache;
+
+/* Styles loaded in server mode. */
+static pthread_mutex_t style_lock = PTHREAD_MUTEX_INITIALIZER;
+static style_t *style_cache;
+
+/* Limits the number of requests that are handled concurrently in server mode. */
+static pthread_mutex_t slot_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t slot_available = PTHREAD_COND_INITIALIZER;
+static int slots_used;
+
 static const char style_schema[] = {
 #include "style.bytes"
 };
@@ -66,14 +182,29 @@ static const char style_schema[] = {
 static int option_verbose;
 static const char *option_language;
 static char *option_style;
-static const char *option_input;
 static const char *option_language_file;
+static const char *option_output;
+static const char *option_files_from;
+static int option_jobs;
 static const char *option_document_type;
+static int option_stats;
+static int option_profile;
+static int option_lint;
+static int option_skip_normal;
+static int option_serve;
+static const char *option_socket;
+static const char *option_index;
+/* The range of lines to write, counting from 0. The last line is not included. */
+static size_t option_first_line;
+static size_t option_last_line = (size_t)-1;
 
 static t3_bool set_tag(const char *name, const char *value);
-static void write_data(const char *string, size_t size);
+static void add_input(const char *name);
+static void write_output(output_t *output, const char *data, size_t size);
+static void write_data(output_t *output, const char *string, size_t size);
 static void list_styles(void);
 static void list_document_types(const char *name);
+static void parse_lines(const char *range);
 
 /** Alert the user of a fatal error and quit.
     @param fmt The format string for the message. See fprintf(3) for details.
@@ -160,14 +291,47 @@ static PARSE_FUNCTION(parse_args)
         strcat(option_style, ".style");
       }
     END_OPTION
+    LONG_OPTION("files-from", REQUIRED_ARG)
+      option_files_from = optArg;
+    END_OPTION
+    OPTION('j', "jobs", REQUIRED_ARG)
+      PARSE_INT(option_jobs, 1, 1024);
+    END_OPTION
+    OPTION('o', "output", REQUIRED_ARG)
+      option_output = optArg;
+    END_OPTION
+    LONG_OPTION("index", OPTIONAL_ARG)
+      option_index = optArg == NULL ? "%{name}.t3index" : optArg;
+    END_OPTION
+    LONG_OPTION("lines", REQUIRED_ARG)
+      parse_lines(optArg);
+    END_OPTION
+    LONG_OPTION("serve", OPTIONAL_ARG)
+      option_serve = 1;
+      option_socket = optArg;
+    END_OPTION
+    BOOLEAN_LONG_OPTION("skip-normal", option_skip_normal)
+    BOOLEAN_LONG_OPTION("stats", option_stats)
+    BOOLEAN_LONG_OPTION("profile", option_profile)
+    BOOLEAN_LONG_OPTION("lint", option_lint)
     OPTION('h', "help", NO_ARG)
-      printf("Usage: t3highlight [<options>] [<file>]\n"
+      printf("Usage: t3highlight [<options>] [<file>...]\n"
         "  -d<type>,--document-type=<type> Output using document type <type>\n"
         "  -D,--list-document-types        List the document types for the current style\n"
+        "  --files-from=<file>             Read the names of the input files from <file>\n"
+        "  -j<jobs>,--jobs=<jobs>          Highlight up to <jobs> files in parallel\n"
+        "  --index[=<tmpl>]                Keep an index of states in the file named by <tmpl>\n"
         "  -l<lang>,--language=<lang>      Highlight using language <lang>\n"
         "  --language-file=<file>          Load highlighting description file <file>\n"
         "  -L,--list                       List available languages and styles\n"
+        "  --lines=<first>-<last>          Only write lines <first> up to and including <last>\n"
+        "  --lint                          Check the highlighting patterns for slow constructs\n"
+        "  -o<tmpl>,--output=<tmpl>        Write the output to the file named by <tmpl>\n"
+        "  --profile                       Print the slowest patterns to standard error\n"
         "  -s<style>,--style=<style>       Output using style <style>\n"
+        "  --serve[=<socket>]              Handle requests on standard input or <socket>\n"
+        "  --skip-normal                   Don't write the style's markup for normal text\n"
+        "  --stats                         Print size statistics to standard error\n"
         "  -t<tag>,--tag=<tag>             Define tag <tag>, which must be <name>=<value>\n"
         "  -v,--verbose                    Enable verbose output mode\n"
       );
@@ -196,10 +360,7 @@ static PARSE_FUNCTION(parse_args)
 
     fatal(_("No such option %.*s\n"), OPTPRARG);
   NO_OPTION
-    if (option_input != NULL) {
-      fatal(_("Error: only one input file allowed\n"));
-    }
-    option_input = optcurrent;
+    add_input(strcmp(optcurrent, "-") == 0 ? NULL : optcurrent);
   END_OPTIONS
 
   if (option_list_document_types) {
@@ -209,6 +370,33 @@ static PARSE_FUNCTION(parse_args)
 END_FUNCTION
 /* clang-format on */
 
+/** Parse the argument of --lines, which is either <first>-<last>, <first>- or <first>. */
+static void parse_lines(const char *range) {
+  unsigned long first, last;
+  char *end;
+
+  errno = 0;
+  first = strtoul(range, &end, 10);
+  if (end == range || first == 0 || errno != 0) {
+    fatal(_("Invalid line range '%s'\n"), range);
+  }
+  if (*end == 0) {
+    last = first;
+  } else if (strcmp(end, "-") == 0) {
+    last = 0;
+  } else if (*end == '-') {
+    const char *last_text = end + 1;
+    last = strtoul(last_text, &end, 10);
+    if (end == last_text || *end != 0 || last < first || errno != 0) {
+      fatal(_("Invalid line range '%s'\n"), range);
+    }
+  } else {
+    fatal(_("Invalid line range '%s'\n"), range);
+  }
+  option_first_line = first - 1;
+  option_last_line = last == 0 ? (size_t)-1 : last;
+}
+
 static t3_bool set_tag(const char *name, const char *value) {
   tag_t *ptr;
   for (ptr = tags; ptr != NULL; ptr = ptr->next) {
@@ -229,6 +417,46 @@ static t3_bool set_tag(const char *name, const char *value) {
   return t3_true;
 }
 
+static void add_input(const char *name) {
+  if (inputs_used == inputs_allocated) {
+    const char **new_inputs;
+
+    inputs_allocated = inputs_allocated == 0 ? 16 : inputs_allocated * 2;
+    if ((new_inputs = realloc(inputs, inputs_allocated * sizeof(const char *))) == NULL) {
+      fatal(_("Out of memory\n"));
+    }
+    inputs = new_inputs;
+  }
+  inputs[inputs_used++] = name;
+}
+
+/** Add the input files named in @p name, one per line. */
+static void read_file_list(const char *name) {
+  FILE *file;
+  char *line = NULL;
+  size_t n;
+  ssize_t chars_read;
+
+  if (strcmp(name, "-") == 0) {
+    file = stdin;
+  } else if ((file = fopen(name, "r")) == NULL) {
+    fatal(_("Can't open '%s': %s\n"), name, strerror(errno));
+  }
+
+  while ((chars_read = getline(&line, &n, file)) > 0) {
+    if (line[chars_read - 1] == '\n') {
+      line[--chars_read] = 0;
+    }
+    if (chars_read > 0) {
+      add_input(safe_strdup(line));
+    }
+  }
+  free(line);
+  if (file != stdin) {
+    fclose(file);
+  }
+}
+
 static int style_filter(const struct dirent *entry) {
   /* FIXME: filter out directories and other non-file entries. */
   return fnmatch("*.style", entry->d_name, 0) == 0;
@@ -266,7 +494,17 @@ static void list_styles(void) {
   list_dir_styles(DATADIR);
 }
 
-static t3_config_t *open_style(const char *name) {
+/** Store an error message in @p error, which must be able to hold ERROR_SIZE bytes. */
+static void set_error(char *error, const char *fmt, ...) {
+  va_list args;
+
+  va_start(args, fmt);
+  vsnprintf(error, ERROR_SIZE, fmt, args);
+  va_end(args);
+}
+
+/** Open and validate a style file. Returns @c NULL and sets @p error on failure. */
+static t3_config_t *open_style(const char *name, char *error) {
   t3_config_t *style_config;
   t3_config_schema_t *schema;
   t3_config_error_t config_error;
@@ -285,31 +523,36 @@ static t3_config_t *open_style(const char *name) {
     path[0] = tmp;
   }
 
-  if ((style_file = t3_config_open_from_path(path[0] == NULL ? path + 1 : path, name, 0)) == NULL) {
-    fatal("Can't open '%s': %s\n", name, strerror(errno));
-  }
+  style_file = t3_config_open_from_path(path[0] == NULL ? path + 1 : path, name, 0);
   free(tmp);
-
-  if ((style_config = t3_config_read_file(style_file, &config_error, NULL)) == NULL) {
-    fprintf(stderr, _("Error reading style file: "));
-    fatal("%s:%d: %s\n", name, config_error.line_number, t3_config_strerror(config_error.error));
+  if (style_file == NULL) {
+    set_error(error, _("Can't open '%s': %s"), name, strerror(errno));
+    return NULL;
   }
+
+  style_config = t3_config_read_file(style_file, &config_error, NULL);
   fclose(style_file);
+  if (style_config == NULL) {
+    set_error(error, _("Error reading style file: %s:%d: %s"), name, config_error.line_number,
+              t3_config_strerror(config_error.error));
+    return NULL;
+  }
 
   if ((schema = t3_config_read_schema_buffer(style_schema, sizeof(style_schema), &config_error,
                                              NULL)) == NULL) {
     if (config_error.error != T3_ERR_OUT_OF_MEMORY) {
       config_error.error = T3_ERR_INTERNAL;
     }
-    fprintf(stderr, _("Error reading style file: "));
-    fatal("%s\n", t3_config_strerror(config_error.error));
+    fatal(_("Error reading style file: %s\n"), t3_config_strerror(config_error.error));
   }
 
   if (!t3_config_validate(style_config, schema, &config_error, T3_CONFIG_VERBOSE_ERROR)) {
-    fprintf(stderr, _("Error reading style file: "));
-    fatal("%s:%d: %s%s%s\n", name, config_error.line_number, t3_config_strerror(config_error.error),
-          config_error.extra == NULL ? "" : ": ",
-          config_error.extra == NULL ? "" : config_error.extra);
+    set_error(error, _("Error reading style file: %s:%d: %s%s%s"), name, config_error.line_number,
+              t3_config_strerror(config_error.error), config_error.extra == NULL ? "" : ": ",
+              config_error.extra == NULL ? "" : config_error.extra);
+    t3_config_delete_schema(schema);
+    t3_config_delete(style_config);
+    return NULL;
   }
   t3_config_delete_schema(schema);
   return style_config;
@@ -317,7 +560,12 @@ static t3_config_t *open_style(const char *name) {
 
 static void list_document_types(const char *name) {
   t3_config_t *document;
-  t3_config_t *style_config = open_style(name);
+  char error[ERROR_SIZE];
+  t3_config_t *style_config = open_style(name, error);
+
+  if (style_config == NULL) {
+    fatal("%s\n", error);
+  }
   printf(_("Available document types for style '%.*s':\n"), (int)(strrchr(name, '.') - name), name);
   for (document = t3_config_get(t3_config_get(style_config, "documents"), NULL); document != NULL;
        document = t3_config_get_next(document)) {
@@ -342,14 +590,24 @@ static void list_document_types(const char *name) {
 
 static int map_style(void *_styles, const char *name) {
   style_def_t *styles = _styles;
-  int i;
+  int i, j;
 
   for (i = 0; styles[i].tag != NULL; i++) {
     if (strcmp(styles[i].tag, name) == 0) {
-      return i;
+      break;
+    }
+  }
+  if (styles[i].tag == NULL) {
+    return 0;
+  }
+  /* Map styles with the same markup to the same attribute, such that their runs are merged. */
+  for (j = 0; j < i; j++) {
+    if (strcmp(styles[j].start, styles[i].start) == 0 &&
+        strcmp(styles[j].end, styles[i].end) == 0) {
+      return j;
     }
   }
-  return 0;
+  return i;
 }
 
 static char *expand_string(const char *str, t3_bool expand_escapes) {
@@ -365,42 +623,90 @@ static char *expand_string(const char *str, t3_bool expand_escapes) {
   return result;
 }
 
-static void init_translations(t3_config_t *translate, const char *name, t3_bool expand_escapes) {
+static t3_bool init_translations(style_t *style, t3_config_t *translate, const char *name,
+                                 t3_bool expand_escapes, char *error) {
   int count, i;
   if ((count = t3_config_get_length(translate)) == 0) {
-    return;
+    return t3_true;
   }
 
-  if ((translations = malloc(sizeof(translation_t) * (count + 1))) == NULL) {
-    fatal(_("Out of memory"));
+  if ((style->translations = calloc(count + 1, sizeof(translation_t))) == NULL) {
+    fatal(_("Out of memory\n"));
   }
   for (i = 0, translate = t3_config_get(translate, NULL); translate != NULL;
        i++, translate = t3_config_get_next(translate)) {
-    translations[i].search = t3_config_take_string(t3_config_get(translate, "search"));
-    translations[i].replace = t3_config_take_string(t3_config_get(translate, "replace"));
+    style->translations[i].search = t3_config_take_string(t3_config_get(translate, "search"));
+    style->translations[i].replace = t3_config_take_string(t3_config_get(translate, "replace"));
     if (expand_escapes) {
-      translations[i].search_len = parse_escapes(translations[i].search);
-      translations[i].replace_len = parse_escapes(translations[i].replace);
+      style->translations[i].search_len = parse_escapes(style->translations[i].search);
+      style->translations[i].replace_len = parse_escapes(style->translations[i].replace);
     } else {
-      translations[i].search_len = strlen(translations[i].search);
-      translations[i].replace_len = strlen(translations[i].replace);
+      style->translations[i].search_len = strlen(style->translations[i].search);
+      style->translations[i].replace_len = strlen(style->translations[i].replace);
+    }
+    if (style->translations[i].search_len == 0) {
+      set_error(error, _("Empty search string: %s:%d"), name,
+                t3_config_get_line_number(t3_config_get(translate, "search")));
+      return t3_false;
     }
-    if (translations[i].search_len == 0) {
-      fatal(_("Empty search string: %s:%d\n"), name,
-            t3_config_get_line_number(t3_config_get(translate, "search")));
+  }
+  style->translations[i].search = NULL;
+  style->translations[i].replace = NULL;
+
+  /* Chain the translations by first byte. Insert from the back, such that the order of the
+     translations is maintained. */
+  while (i > 0) {
+    translation_t *translation = &style->translations[--i];
+    translation->next = style->translations_by_first[(unsigned char)translation->search[0]];
+    style->translations_by_first[(unsigned char)translation->search[0]] = translation;
+  }
+  return t3_true;
+}
+
+static void free_style(style_t *style) {
+  int i;
+
+  if (style->defs != NULL) {
+    for (i = 0; style->defs[i].tag != NULL; i++) {
+      free(style->defs[i].tag);
+      free(style->defs[i].start);
+      free(style->defs[i].end);
+    }
+    free(style->defs);
+  }
+  if (style->translations != NULL) {
+    for (i = 0; style->translations[i].search != NULL || style->translations[i].replace != NULL;
+         i++) {
+      free(style->translations[i].search);
+      free(style->translations[i].replace);
     }
+    free(style->translations);
   }
-  translations[i].search = NULL;
-  translations[i].replace = NULL;
+  free(style->header);
+  free(style->footer);
+  free(style->name);
+  free(style->document_type);
+  free(style);
 }
 
-static style_def_t *load_style(const char *name) {
+/** Load a style, using @p document_type or the first document type if @c NULL.
+    Returns @c NULL and sets @p error on failure.
+*/
+static style_t *load_style(const char *name, const char *document_type, char *error) {
   t3_config_t *style_config, *styles, *ptr, *normal, *document;
   t3_bool expand_escapes = t3_false;
   style_def_t *result;
+  style_t *style;
   int count;
 
-  style_config = open_style(name);
+  if ((style_config = open_style(name, error)) == NULL) {
+    return NULL;
+  }
+  if ((style = calloc(1, sizeof(style_t))) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  style->name = safe_strdup(name);
+  style->document_type = document_type == NULL ? NULL : safe_strdup(document_type);
 
   expand_escapes = t3_config_get_bool(t3_config_get(style_config, "expand-escapes"));
   styles = t3_config_get(t3_config_get(style_config, "styles"), NULL);
@@ -414,6 +720,7 @@ static style_def_t *load_style(const char *name) {
   if ((result = malloc(sizeof(style_def_t) * count)) == NULL) {
     fatal(_("Out of memory\n"));
   }
+  style->defs = result;
 
   result[0].tag = safe_strdup("normal");
   if (normal == NULL) {
@@ -434,40 +741,61 @@ static style_def_t *load_style(const char *name) {
         expand_string(t3_config_get_string(t3_config_get(ptr, "end")), expand_escapes);
   }
   result[count].tag = NULL;
+  for (count = 0; result[count].tag != NULL; count++) {
+    result[count].start_len = strlen(result[count].start);
+    result[count].end_len = strlen(result[count].end);
+  }
+  if (option_skip_normal) {
+    result[0].start[0] = 0;
+    result[0].end[0] = 0;
+    result[0].start_len = 0;
+    result[0].end_len = 0;
+  }
 
-  init_translations(t3_config_get(style_config, "translate"), name, expand_escapes);
+  if (!init_translations(style, t3_config_get(style_config, "translate"), name, expand_escapes,
+                         error)) {
+    goto return_error;
+  }
 
-  if (option_document_type != NULL) {
-    document = t3_config_get(t3_config_get(style_config, "documents"), option_document_type);
+  if (document_type != NULL) {
+    document = t3_config_get(t3_config_get(style_config, "documents"), document_type);
     if (document == NULL) {
-      fatal(_("Document type '%s' is not defined\n"), option_document_type);
+      set_error(error, _("Document type '%s' is not defined"), document_type);
+      goto return_error;
     }
   } else {
     document = t3_config_get(t3_config_get(style_config, "documents"), NULL);
   }
 
   if (document != NULL) {
-    header = t3_config_take_string(t3_config_get(document, "header"));
-    footer = t3_config_take_string(t3_config_get(document, "footer"));
+    style->header = t3_config_take_string(t3_config_get(document, "header"));
+    style->footer = t3_config_take_string(t3_config_get(document, "footer"));
   }
 
   if (expand_escapes) {
-    if (header != NULL) {
-      parse_escapes(header);
+    if (style->header != NULL) {
+      parse_escapes(style->header);
     }
-    if (footer != NULL) {
-      parse_escapes(footer);
+    if (style->footer != NULL) {
+      parse_escapes(style->footer);
     }
   }
 
   t3_config_delete(normal);
   t3_config_delete(style_config);
 
-  return result;
+  return style;
+
+return_error:
+  t3_config_delete(normal);
+  t3_config_delete(style_config);
+  free_style(style);
+  return NULL;
 }
 
-static void write_header(void) {
-  char *ptr, *prev_ptr = header;
+static void write_header(output_t *output) {
+  const char *header = output->style->header;
+  const char *ptr, *prev_ptr = header;
   tag_t *tag_ptr;
   if (header == NULL) {
     return;
@@ -475,117 +803,1083 @@ static void write_header(void) {
 
   for (ptr = strchr(header, '%'); ptr != NULL; ptr = strchr(prev_ptr, '%')) {
     if (ptr != prev_ptr) {
-      fwrite(prev_ptr, 1, ptr - prev_ptr, stdout);
+      write_output(output, prev_ptr, ptr - prev_ptr);
     }
     if (ptr[1] == '{') {
       for (tag_ptr = tags; tag_ptr != NULL; tag_ptr = tag_ptr->next) {
         if (strncmp(ptr + 2, tag_ptr->name, tag_ptr->name_len) == 0 &&
             ptr[tag_ptr->name_len + 2] == '}') {
-          write_data(tag_ptr->value, strlen(tag_ptr->value));
+          write_data(output, tag_ptr->value, strlen(tag_ptr->value));
           ptr += tag_ptr->name_len + 2;
           break;
         }
       }
       if (tag_ptr == NULL) {
-        char *close_ptr = strchr(ptr, '}');
+        const char *close_ptr = strchr(ptr, '}');
         if (close_ptr == NULL) {
           ptr++;
-          putc(*ptr, stdout);
+          write_output(output, ptr, 1);
         } else {
+          /* The name tag is defined per input file, unless it was overridden by the user. */
+          if (output->name != NULL && close_ptr == ptr + 6 && strncmp(ptr + 2, "name", 4) == 0) {
+            write_data(output, output->name, strlen(output->name));
+          }
           ptr = close_ptr;
         }
       }
     } else {
       ptr++;
-      putc(*ptr, stdout);
+      write_output(output, ptr, 1);
     }
     prev_ptr = ptr + 1;
   }
-  fwrite(prev_ptr, 1, header + strlen(header) - prev_ptr, stdout);
+  write_output(output, prev_ptr, header + strlen(header) - prev_ptr);
+}
+
+static void flush_output(output_t *output) {
+  if (output->fill > 0 && fwrite(output->buffer, 1, output->fill, output->file) != output->fill) {
+    fatal(_("Error writing output: %s\n"), strerror(errno));
+  }
+  output->fill = 0;
 }
 
-static void write_data(const char *string, size_t size) {
+/** Write data to the output file through the output buffer. */
+static void write_output(output_t *output, const char *data, size_t size) {
+  if (output->fill + size > OUTPUT_BUFFER_SIZE) {
+    flush_output(output);
+    /* Don't bother copying data which does not fit in the buffer anyway. */
+    if (size > OUTPUT_BUFFER_SIZE) {
+      if (fwrite(data, 1, size, output->file) != size) {
+        fatal(_("Error writing output: %s\n"), strerror(errno));
+      }
+      return;
+    }
+  }
+  memcpy(output->buffer + output->fill, data, size);
+  output->fill += size;
+}
+
+static void write_data(output_t *output, const char *string, size_t size) {
   translation_t *ptr;
-  size_t i;
+  size_t i, copied = 0;
 
-  if (translations == NULL) {
-    fwrite(string, 1, size, stdout);
+  if (output->style->translations == NULL) {
+    write_output(output, string, size);
     return;
   }
 
   for (i = 0; i < size; i++) {
-    for (ptr = translations; ptr->search != NULL; ptr++) {
-      if (i + ptr->search_len <= size && strncmp(string + i, ptr->search, ptr->search_len) == 0) {
-        fwrite(ptr->replace, 1, ptr->replace_len, stdout);
-        i += ptr->search_len - 1;
+    for (ptr = output->style->translations_by_first[(unsigned char)string[i]]; ptr != NULL;
+         ptr = ptr->next) {
+      if (i + ptr->search_len <= size && memcmp(string + i, ptr->search, ptr->search_len) == 0) {
         break;
       }
     }
-    if (ptr->search == NULL) {
-      putc(string[i], stdout);
+    if (ptr == NULL) {
+      continue;
     }
+    /* Copy the untranslated data in one go. */
+    write_output(output, string + copied, i - copied);
+    write_output(output, ptr->replace, ptr->replace_len);
+    i += ptr->search_len - 1;
+    copied = i + 1;
   }
+  write_output(output, string + copied, size - copied);
 }
 
-static void highlight_file(t3_highlight_t *highlight) {
-  FILE *input;
-  char *line = NULL;
-  size_t n;
-  ssize_t chars_read;
+/** Close the currently open run of text with the same attribute, if any. */
+static void end_run(output_t *output) {
+  if (output->attribute >= 0) {
+    const style_def_t *def = &output->style->defs[output->attribute];
+    write_output(output, def->end, def->end_len);
+    output->attribute = -1;
+  }
+}
+
+/** Write text with @p attribute, extending the currently open run if it has the same attribute. */
+static void write_run(output_t *output, int attribute, const char *data, size_t size) {
+  if (size == 0) {
+    return;
+  }
+  if (attribute != output->attribute) {
+    end_run(output);
+    write_output(output, output->style->defs[attribute].start,
+                 output->style->defs[attribute].start_len);
+    output->attribute = attribute;
+  }
+  write_data(output, data, size);
+}
+
+static void print_stats(const char *title, const t3_highlight_stats_t *stats) {
+  fprintf(stderr, "%s:\n", title);
+  fprintf(stderr, _("  States:           %lu\n"), (unsigned long)stats->states);
+  fprintf(stderr, _("  Patterns:         %lu\n"), (unsigned long)stats->patterns);
+  fprintf(stderr, _("  Dynamic mappings: %lu\n"), (unsigned long)stats->dynamic_mappings);
+  fprintf(stderr, _("  Regex bytes:      %lu\n"), (unsigned long)stats->regex_bytes);
+  fprintf(stderr, _("  JIT bytes:        %lu\n"), (unsigned long)stats->jit_bytes);
+  fprintf(stderr, _("  Table bytes:      %lu\n"), (unsigned long)stats->table_bytes);
+  fprintf(stderr, _("  Line end states:  %lu\n"), (unsigned long)stats->line_end_states);
+}
+
+#define PROFILE_ENTRIES 20
+
+static int compare_profile_time(const void *a, const void *b) {
+  const t3_highlight_profile_t *profile_a = *(const t3_highlight_profile_t *const *)a;
+  const t3_highlight_profile_t *profile_b = *(const t3_highlight_profile_t *const *)b;
+
+  if (profile_a->time_nsec == profile_b->time_nsec) {
+    return 0;
+  }
+  return profile_a->time_nsec < profile_b->time_nsec ? 1 : -1;
+}
+
+static void print_profile(const t3_highlight_match_t *match) {
+  const t3_highlight_profile_t *profile, **sorted;
+  size_t count, used = 0, i;
+
+  if ((profile = t3_highlight_get_profile(match, &count)) == NULL) {
+    return;
+  }
+  if ((sorted = malloc((count == 0 ? 1 : count) * sizeof(t3_highlight_profile_t *))) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  for (i = 0; i < count; i++) {
+    if (profile[i].attempts > 0) {
+      sorted[used++] = &profile[i];
+    }
+  }
+  qsort(sorted, used, sizeof(t3_highlight_profile_t *), compare_profile_time);
+
+  fprintf(stderr, _("Most time consuming patterns:\n"));
+  fprintf(stderr, "%10s %10s %10s %10s %12s  %s\n", _("Time (ms)"), _("Attempts"), _("Successes"),
+          _("Wins"), _("Bytes"), _("Location"));
+  for (i = 0; i < used && i < PROFILE_ENTRIES; i++) {
+    fprintf(stderr, "%10.3f %10lu %10lu %10lu %12llu  %s:%d\n", sorted[i]->time_nsec / 1e6,
+            sorted[i]->attempts, sorted[i]->successes, sorted[i]->wins, sorted[i]->bytes,
+            sorted[i]->file_name == NULL ? "" : sorted[i]->file_name, sorted[i]->line_number);
+  }
+  free(sorted);
+}
+
+static void lint(const t3_highlight_t *highlight) {
+  t3_highlight_error_t error;
+  t3_highlight_lint_t *findings;
+  int i;
+
+  findings = t3_highlight_lint_file(t3_highlight_get_langfile(highlight),
+                                    (option_language_file == NULL ? T3_HIGHLIGHT_USE_PATH : 0) |
+                                        T3_HIGHLIGHT_VERBOSE_ERROR | T3_HIGHLIGHT_UTF8,
+                                    &error);
+  if (findings == NULL) {
+    fatal(_("Error checking highlighting patterns: %s\n"), t3_highlight_strerror(error.error));
+  }
+
+  for (i = 0; findings[i].type != T3_HIGHLIGHT_LINT_END; i++) {
+    printf("%s:%d: %s", findings[i].file_name == NULL ? "" : findings[i].file_name,
+           findings[i].line_number, t3_highlight_lint_description(findings[i].type));
+    if (findings[i].extra != NULL) {
+      printf(": %s", findings[i].extra);
+    }
+    putchar('\n');
+  }
+  t3_highlight_free_lint(findings);
+  exit(i == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+/** Open the input file @p name, or standard input if @p name is @c NULL. */
+static t3_bool open_input(input_t *input, const char *name) {
+  struct stat statbuf;
+
+  memset(input, 0, sizeof(input_t));
+  if (name == NULL) {
+    input->fd = STDIN_FILENO;
+  } else if ((input->fd = open(name, O_RDONLY)) < 0) {
+    fprintf(stderr, _("Can't open '%s': %s\n"), name, strerror(errno));
+    return t3_false;
+  }
+
+  if (fstat(input->fd, &statbuf) == 0 && S_ISREG(statbuf.st_mode) && statbuf.st_size > 0 &&
+      (uintmax_t)statbuf.st_size <= SIZE_MAX) {
+    input->mapping_size = statbuf.st_size;
+    input->mapping = mmap(NULL, input->mapping_size, PROT_READ, MAP_PRIVATE, input->fd, 0);
+    if (input->mapping != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+      madvise(input->mapping, input->mapping_size, MADV_SEQUENTIAL);
+#endif
+      input->data = input->mapping;
+      input->size = input->mapping_size;
+      input->eof = t3_true;
+      return t3_true;
+    }
+    /* Fall back to reading the file. */
+    input->mapping = NULL;
+    input->mapping_size = 0;
+  }
+
+  input->buffer_size = INPUT_BLOCK_SIZE;
+  if ((input->buffer = malloc(input->buffer_size)) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  input->data = input->buffer;
+  return t3_true;
+}
+
+/** Read more data into the input buffer. Returns @c t3_false if no more data is available. */
+static t3_bool fill_input(input_t *input) {
+  ssize_t bytes_read;
+
+  if (input->eof) {
+    return t3_false;
+  }
+
+  /* Move the partial line to the start of the buffer, and make room for at least a full
+     block of data after it. */
+  if (input->data != input->buffer) {
+    memmove(input->buffer, input->data, input->size);
+    input->data = input->buffer;
+  }
+  if (input->buffer_size - input->size < INPUT_BLOCK_SIZE) {
+    char *new_buffer;
+
+    if ((new_buffer = realloc(input->buffer, input->buffer_size * 2)) == NULL) {
+      fatal(_("Out of memory\n"));
+    }
+    input->buffer = new_buffer;
+    input->buffer_size *= 2;
+    input->data = input->buffer;
+  }
+
+  do {
+    bytes_read = read(input->fd, input->buffer + input->size, input->buffer_size - input->size);
+  } while (bytes_read < 0 && errno == EINTR);
+  if (bytes_read < 0) {
+    fatal(_("Error reading input: %s\n"), strerror(errno));
+  } else if (bytes_read == 0) {
+    input->eof = t3_true;
+    return t3_false;
+  }
+  input->size += bytes_read;
+  return t3_true;
+}
+
+/** Get the next line from the input, excluding the newline character.
+
+    The returned line points into the input data, and is only valid until the next call.
+    Very long lines are returned in parts, in which case @p complete is set to @c t3_false.
+    The next call then returns the same line again, without the first @p skip bytes and
+    with more data appended.
+*/
+static t3_bool next_line(input_t *input, size_t skip, const char **line, size_t *length,
+                         t3_bool *complete) {
+  const char *newline;
+  size_t searched;
+
+  input->data += skip;
+  input->size -= skip;
+  input->returned -= skip;
+  searched = input->returned;
+  *complete = t3_true;
+
+  while ((newline = memchr(input->data + searched, '\n', input->size - searched)) == NULL) {
+    searched = input->size;
+    if (input->size - input->returned >= LINE_CHUNK_SIZE) {
+      *line = input->data;
+      *length = input->size;
+      input->returned = input->size;
+      *complete = t3_false;
+      return t3_true;
+    }
+    if (!fill_input(input)) {
+      if (input->size == 0) {
+        return t3_false;
+      }
+      /* Last line, without a newline at the end. */
+      *line = input->data;
+      *length = input->size;
+      input->data += input->size;
+      input->size = 0;
+      input->returned = 0;
+      return t3_true;
+    }
+  }
+  *line = input->data;
+  *length = newline - input->data;
+  input->size -= newline + 1 - input->data;
+  input->data = newline + 1;
+  input->returned = 0;
+  return t3_true;
+}
+
+static void close_input(input_t *input) {
+  if (input->mapping != NULL) {
+    munmap(input->mapping, input->mapping_size);
+  }
+  free(input->buffer);
+  if (input->fd >= 0 && input->fd != STDIN_FILENO) {
+    close(input->fd);
+  }
+}
+
+/** Highlight the lines selected by --lines from @p input.
+
+    If @p index is not @c NULL, @p input must be mapped into memory. If @p fill_index is set,
+    the whole input is highlighted to add checkpoints to @p index. Otherwise highlighting
+    starts at the checkpoint nearest to the first selected line, and stops after the last.
+*/
+static void highlight_file(t3_highlight_t *highlight, input_t *input, output_t *output,
+                           t3_highlight_index_t *index, t3_bool fill_index) {
+  const char *line;
+  size_t chars_read;
+  /* The position in the line of the first byte of the data returned by next_line, and the
+     number of bytes of that data that are no longer needed. */
+  size_t offset = 0, skip = 0;
+  t3_bool complete, at_line_start = t3_true, valid = t3_true, in_range;
+  size_t line_number = 0;
+  /* If every line ends in the initial state, the lines before the range need not be
+     highlighted. */
+  t3_bool skip_before = !fill_index && t3_highlight_is_line_independent(highlight);
 
   t3_highlight_match_t *match = t3_highlight_new_match(highlight);
-  t3_bool match_result;
+  int match_result;
 
-  if (match == NULL) {
+  if (match == NULL || (option_profile && !t3_highlight_set_profile(match, t3_true))) {
     fatal(_("Out of memory\n"));
   }
 
-  if (option_input == NULL) {
-    input = stdin;
-  } else if ((input = fopen(option_input, "rb")) == NULL) {
-    fatal(_("Can't open '%s': %s\n"), option_input, strerror(errno));
+  if (index != NULL && !fill_index && option_first_line > 0) {
+    size_t checkpoint_offset;
+
+    if (!t3_highlight_index_seek(index, match, option_first_line, &line_number,
+                                 &checkpoint_offset)) {
+      fatal(_("Out of memory\n"));
+    }
+    if (checkpoint_offset <= input->size) {
+      input->data += checkpoint_offset;
+      input->size -= checkpoint_offset;
+    } else {
+      /* The index does not match the input after all. */
+      t3_highlight_reset(match, 0);
+      line_number = 0;
+    }
   }
 
-  write_header();
+  write_header(output);
 
-  while ((chars_read = getline(&line, &n, input)) > 0) {
-    if (line[chars_read - 1] == '\n') {
-      chars_read--;
-    }
-
-    t3_highlight_next_line(match);
-    do {
-      match_result = t3_highlight_match(match, line, chars_read);
-      size_t start = t3_highlight_get_start(match),
-             match_start = t3_highlight_get_match_start(match), end = t3_highlight_get_end(match);
-      if (start != match_start) {
-        fputs(styles[t3_highlight_get_begin_attr(match)].start, stdout);
-        write_data(line + start, match_start - start);
-        fputs(styles[t3_highlight_get_begin_attr(match)].end, stdout);
+  while (line_number < option_last_line || fill_index) {
+    if (!next_line(input, skip, &line, &chars_read, &complete)) {
+      break;
+    }
+    if (at_line_start) {
+      t3_highlight_next_line(match);
+      if (fill_index && !t3_highlight_index_update(index, match, line_number,
+                                                   line - (const char *)input->mapping)) {
+        fatal(_("Out of memory\n"));
       }
-      if (match_start != end) {
-        fputs(styles[t3_highlight_get_match_attr(match)].start, stdout);
-        write_data(line + match_start, end - match_start);
-        fputs(styles[t3_highlight_get_match_attr(match)].end, stdout);
+      at_line_start = t3_false;
+      valid = !skip_before || line_number >= option_first_line;
+    }
+    in_range = line_number >= option_first_line && line_number < option_last_line;
+    while (valid) {
+      size_t start, match_start, end;
+
+      match_result = t3_highlight_match_chunk(match, line, chars_read, offset, complete);
+      if (match_result == T3_HIGHLIGHT_CHUNK_ERROR) {
+        /* The rest of an invalid line is left out. */
+        valid = t3_false;
+        break;
       }
-    } while (match_result);
-    write_data("\n", 1);
+      start = t3_highlight_get_start(match) - offset;
+      match_start = t3_highlight_get_match_start(match) - offset;
+      end = t3_highlight_get_end(match) - offset;
+      if (in_range) {
+        write_run(output, t3_highlight_get_begin_attr(match), line + start, match_start - start);
+        write_run(output, t3_highlight_get_match_attr(match), line + match_start,
+                  end - match_start);
+      }
+      if (match_result != T3_HIGHLIGHT_CHUNK_MATCH) {
+        break;
+      }
+    }
+
+    if (!complete) {
+      skip = valid ? t3_highlight_get_chunk_keep(match) - offset : chars_read;
+      offset += skip;
+      continue;
+    }
+    skip = 0;
+    offset = 0;
+    at_line_start = t3_true;
+    line_number++;
+    if (in_range) {
+      /* Runs are not continued on the next line, as styles may not allow markup to span
+         lines. */
+      end_run(output);
+      write_data(output, "\n", 1);
+    }
+  }
+  if (output->style->footer != NULL) {
+    write_output(output, output->style->footer, strlen(output->style->footer));
+  }
+  flush_output(output);
+  if (fflush(output->file) != 0) {
+    fatal(_("Error writing output: %s\n"), strerror(errno));
+  }
+  if (option_stats) {
+    t3_highlight_stats_t stats;
+
+    t3_highlight_get_stats(highlight, &stats);
+    print_stats(_("Highlighting pattern"), &stats);
+    t3_highlight_get_match_stats(match, &stats);
+    print_stats(_("Match state"), &stats);
   }
-  if (footer != NULL) {
-    fwrite(footer, 1, strlen(footer), stdout);
+  if (option_profile) {
+    print_profile(match);
   }
-  fflush(stdout);
   t3_highlight_free_match(match);
-  fclose(input);
+}
+
+/** Format the error from loading highlighting patterns into @p message. */
+static void format_load_error(const t3_highlight_error_t *error, char *message) {
+  if (error->file_name == NULL) {
+    set_error(message, _("Error loading highlighting patterns: %s"),
+              t3_highlight_strerror(error->error));
+  } else {
+    set_error(message, _("Error loading highlighting patterns: %s:%d: %s%s%s"), error->file_name,
+              error->line_number, t3_highlight_strerror(error->error),
+              error->extra == NULL ? "" : ": ", error->extra == NULL ? "" : error->extra);
+  }
+}
+
+/** Print the error from loading highlighting patterns, prefixed by @p input_name if not @c NULL. */
+static void print_load_error(const char *input_name, const char *message) {
+  fprintf(stderr, "%s%s%s\n", input_name == NULL ? "" : input_name,
+          input_name == NULL ? "" : ": ", message);
+}
+
+/** Get the cached highlighting patterns for a language and style, loading them if necessary.
+    @param language The language name if @p by_name is set, or the language file otherwise.
+    @param by_name Whether @p language is a language name.
+    @param style The style to map the highlighting pattern's styles to.
+
+    Highlighting patterns are cached, such that they are loaded only once for all inputs of
+    the same language. Failures are cached as well.
+*/
+static const cache_entry_t *get_cache_entry(const char *language, t3_bool by_name,
+                                            const style_t *style) {
+  t3_highlight_error_t error;
+  cache_entry_t *entry;
+
+  pthread_mutex_lock(&cache_lock);
+  for (entry = highlight_cache; entry != NULL; entry = entry->next) {
+    if (entry->by_name == by_name && entry->style == style &&
+        strcmp(entry->language, language) == 0) {
+      break;
+    }
+  }
+  if (entry == NULL) {
+    if ((entry = malloc(sizeof(cache_entry_t))) == NULL) {
+      fatal(_("Out of memory\n"));
+    }
+    if (by_name) {
+      entry->highlight = t3_highlight_load_by_langname(
+          language, map_style, style->defs, T3_HIGHLIGHT_VERBOSE_ERROR | T3_HIGHLIGHT_UTF8, &error);
+    } else {
+      entry->highlight =
+          t3_highlight_load(language, map_style, style->defs,
+                            T3_HIGHLIGHT_VERBOSE_ERROR | T3_HIGHLIGHT_UTF8 | T3_HIGHLIGHT_USE_PATH,
+                            &error);
+    }
+    entry->error = NULL;
+    if (entry->highlight == NULL) {
+      if ((entry->error = malloc(ERROR_SIZE)) == NULL) {
+        fatal(_("Out of memory\n"));
+      }
+      format_load_error(&error, entry->error);
+    }
+    entry->language = safe_strdup(language);
+    entry->by_name = by_name;
+    entry->style = style;
+    entry->next = highlight_cache;
+    highlight_cache = entry;
+  }
+  pthread_mutex_unlock(&cache_lock);
+  return entry;
+}
+
+/** Get the highlighting patterns for an input file.
+
+    Returns @c NULL, after printing an error message, if no highlighting patterns could be
+    loaded.
+*/
+static t3_highlight_t *get_highlight(const char *input_name, t3_bool batch) {
+  t3_highlight_lang_t lang;
+  t3_highlight_error_t error;
+  const cache_entry_t *entry;
+  char message[ERROR_SIZE];
+
+  if (fixed_highlight != NULL) {
+    return fixed_highlight;
+  }
+
+  if (!t3_highlight_lang_by_filename(input_name, T3_HIGHLIGHT_VERBOSE_ERROR, &lang, &error)) {
+    format_load_error(&error, message);
+    print_load_error(batch ? input_name : NULL, message);
+    return NULL;
+  }
+
+  entry = get_cache_entry(lang.lang_file, t3_false, default_style);
+  t3_highlight_free_lang(lang);
+  if (entry->highlight == NULL) {
+    print_load_error(batch ? input_name : NULL, entry->error);
+  }
+  return entry->highlight;
+}
+
+/** Build a file name from the template given for -o/--output or --index, and create its
+    directories. */
+static char *make_output_name(const char *template, const char *input_name) {
+  const char *ptr, *name = input_name == NULL ? "stdin" : input_name;
+  size_t name_len = strlen(name), length = 0;
+  char *result, *dir_ptr;
+
+  for (ptr = template; *ptr != 0; ptr++) {
+    if (strncmp(ptr, "%{name}", 7) == 0) {
+      length += name_len;
+      ptr += 6;
+    } else {
+      length++;
+    }
+  }
+  if ((result = malloc(length + 1)) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  for (length = 0, ptr = template; *ptr != 0; ptr++) {
+    if (strncmp(ptr, "%{name}", 7) == 0) {
+      memcpy(result + length, name, name_len);
+      length += name_len;
+      ptr += 6;
+    } else {
+      result[length++] = *ptr;
+    }
+  }
+  result[length] = 0;
+
+  for (dir_ptr = strchr(result, '/'); dir_ptr != NULL; dir_ptr = strchr(dir_ptr + 1, '/')) {
+    if (dir_ptr == result) {
+      continue;
+    }
+    *dir_ptr = 0;
+    if (mkdir(result, 0777) != 0 && errno != EEXIST) {
+      fatal(_("Can't create directory '%s': %s\n"), result, strerror(errno));
+    }
+    *dir_ptr = '/';
+  }
+  return result;
+}
+
+/** Fill in the size and modification time of the key for @p input. */
+static void get_file_key(const input_t *input, file_key_t *key) {
+  struct stat statbuf;
+
+  memset(key, 0, sizeof(file_key_t));
+  if (fstat(input->fd, &statbuf) == 0) {
+    key->size = statbuf.st_size;
+    key->mtime_sec = statbuf.st_mtim.tv_sec;
+    key->mtime_nsec = statbuf.st_mtim.tv_nsec;
+  }
+}
+
+static unsigned long long get_file_hash(const input_t *input, file_key_t *key) {
+  if (!key->hash_valid) {
+    const unsigned char *ptr = input->mapping, *end = ptr + input->mapping_size;
+    unsigned long long hash = 5381;
+
+    for (; ptr < end; ptr++) {
+      hash = hash * 33 + *ptr;
+    }
+    key->hash = hash;
+    key->hash_valid = t3_true;
+  }
+  return key->hash;
+}
+
+/** Read the index file @p name, if it belongs to the current contents of @p input.
+    @p rewrite is set if the index is valid, but the key stored with it is not up to date.
+    Returns @c NULL if the index file does not exist or is not valid. */
+static t3_highlight_index_t *load_index(const char *name, const t3_highlight_t *highlight,
+                                        const input_t *input, file_key_t *key,
+                                        t3_bool *rewrite) {
+  t3_highlight_index_t *index = NULL;
+  struct stat statbuf;
+  FILE *file;
+  char *data = NULL;
+  uintmax_t size;
+  long long mtime_sec;
+  long mtime_nsec;
+  unsigned long long hash;
+  int header_length = 0;
+
+  *rewrite = t3_false;
+  if ((file = fopen(name, "rb")) == NULL) {
+    return NULL;
+  }
+  if (fstat(fileno(file), &statbuf) != 0 || !S_ISREG(statbuf.st_mode) ||
+      (uintmax_t)statbuf.st_size >= SIZE_MAX) {
+    goto end;
+  }
+  if ((data = malloc(statbuf.st_size + 1)) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  if (fread(data, 1, statbuf.st_size, file) != (size_t)statbuf.st_size) {
+    goto end;
+  }
+  data[statbuf.st_size] = 0;
+
+  if (sscanf(data, INDEX_HEADER " %ju %lld %ld %llu\n%n", &size, &mtime_sec, &mtime_nsec, &hash,
+             &header_length) != 4 ||
+      header_length == 0 || size != key->size) {
+    goto end;
+  }
+  if (mtime_sec != key->mtime_sec || mtime_nsec != key->mtime_nsec) {
+    /* The file may have been copied or touched, so compare the contents. */
+    if (hash != get_file_hash(input, key)) {
+      goto end;
+    }
+    *rewrite = t3_true;
+  }
+  key->hash = hash;
+  key->hash_valid = t3_true;
+  index = t3_highlight_read_index(highlight, data + header_length,
+                                  statbuf.st_size - header_length);
+
+end:
+  free(data);
+  fclose(file);
+  return index;
+}
+
+/** Write @p index to the index file @p name. Failure is reported, but is not fatal. */
+static void save_index(const char *name, const t3_highlight_t *highlight,
+                       const t3_highlight_index_t *index, const input_t *input,
+                       file_key_t *key) {
+  char *data, *temp_name;
+  size_t size;
+  FILE *file;
+  t3_bool failed;
+
+  if ((data = t3_highlight_write_index(index, highlight, &size)) == NULL ||
+      (temp_name = malloc(strlen(name) + 32)) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  /* Write to a temporary file first, such that other processes never see a partial file. */
+  sprintf(temp_name, "%s.%ld", name, (long)getpid());
+  if ((file = fopen(temp_name, "wb")) == NULL) {
+    fprintf(stderr, _("Can't open '%s': %s\n"), temp_name, strerror(errno));
+    goto end;
+  }
+  fprintf(file, INDEX_HEADER " %ju %lld %ld %llu\n", key->size, key->mtime_sec, key->mtime_nsec,
+          get_file_hash(input, key));
+  fwrite(data, 1, size, file);
+  failed = ferror(file) != 0;
+  if (fclose(file) != 0) {
+    failed = t3_true;
+  }
+  if (failed || rename(temp_name, name) != 0) {
+    fprintf(stderr, _("Error writing index file '%s': %s\n"), name, strerror(errno));
+    unlink(temp_name);
+  }
+
+end:
+  free(temp_name);
+  free(data);
+}
+
+/** Highlight a single input file. Returns @c t3_false if the file could not be highlighted. */
+static t3_bool process_file(const char *input_name, output_t *output) {
+  t3_highlight_t *highlight;
+  t3_highlight_index_t *index = NULL;
+  char *output_name = NULL, *index_name = NULL;
+  t3_bool fill_index = t3_false, write_index = t3_false;
+  file_key_t key;
+  input_t input;
+
+  if ((highlight = get_highlight(input_name, inputs_used > 1)) == NULL) {
+    return t3_false;
+  }
+  if (!open_input(&input, input_name)) {
+    return t3_false;
+  }
+
+  if (option_output == NULL) {
+    output->file = stdout;
+  } else {
+    output_name = make_output_name(option_output, input_name);
+    if ((output->file = fopen(output_name, "wb")) == NULL) {
+      fatal(_("Can't open '%s': %s\n"), output_name, strerror(errno));
+    }
+  }
+  output->style = default_style;
+  output->name = input_name;
+  output->attribute = -1;
+  output->fill = 0;
+
+  /* The index is only used for files that can be mapped into memory, as starting in the
+     middle requires random access. */
+  if (option_index != NULL && input_name != NULL && input.mapping != NULL) {
+    index_name = make_output_name(option_index, input_name);
+    get_file_key(&input, &key);
+    if ((index = load_index(index_name, highlight, &input, &key, &write_index)) == NULL) {
+      if ((index = t3_highlight_new_index(INDEX_LINE_INTERVAL, INDEX_BYTE_INTERVAL,
+                                          INDEX_MAX_CHECKPOINTS)) == NULL) {
+        fatal(_("Out of memory\n"));
+      }
+      fill_index = write_index = t3_true;
+    }
+  }
+
+  highlight_file(highlight, &input, output, index, fill_index);
+
+  if (write_index) {
+    save_index(index_name, highlight, index, &input, &key);
+  }
+  t3_highlight_free_index(index);
+  free(index_name);
+  close_input(&input);
+  if (output_name != NULL) {
+    if (fclose(output->file) != 0) {
+      fatal(_("Error writing output: %s\n"), strerror(errno));
+    }
+    free(output_name);
+  }
+  return t3_true;
+}
+
+/** Highlight input files until none are left. This is run in each of the worker threads. */
+static void *highlight_worker(void *data) {
+  output_t *output;
+  t3_bool failed = t3_false;
+  size_t idx;
+
+  (void)data;
+  if ((output = malloc(sizeof(output_t))) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+
+  while (1) {
+    pthread_mutex_lock(&work_lock);
+    idx = next_input++;
+    pthread_mutex_unlock(&work_lock);
+    if (idx >= inputs_used) {
+      break;
+    }
+    if (!process_file(inputs[idx], output)) {
+      failed = t3_true;
+    }
+  }
+  free(output);
+
+  if (failed) {
+    pthread_mutex_lock(&work_lock);
+    batch_failed = t3_true;
+    pthread_mutex_unlock(&work_lock);
+  }
+  return NULL;
+}
+
+/** Get a style for server mode. Returns @c NULL and sets @p error on failure. */
+static const style_t *get_style(const char *name, const char *document_type, char *error) {
+  char *file_name;
+  style_t *style;
+
+  if (name == NULL && document_type == NULL) {
+    return default_style;
+  } else if (name == NULL) {
+    name = default_style->name;
+  } else if (strchr(name, '/') != NULL) {
+    set_error(error, _("Invalid style name '%s'"), name);
+    return NULL;
+  }
+
+  /* Style names are used without the .style suffix, like for the -s option. */
+  if ((file_name = malloc(strlen(name) + 7)) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  strcpy(file_name, name);
+  if (strcmp(name, default_style->name) != 0) {
+    strcat(file_name, ".style");
+  }
+
+  pthread_mutex_lock(&style_lock);
+  for (style = style_cache; style != NULL; style = style->next) {
+    if (strcmp(style->name, file_name) == 0 &&
+        (style->document_type == NULL
+             ? document_type == NULL
+             : document_type != NULL && strcmp(style->document_type, document_type) == 0)) {
+      break;
+    }
+  }
+  if (style == NULL && (style = load_style(file_name, document_type, error)) != NULL) {
+    style->next = style_cache;
+    style_cache = style;
+  }
+  pthread_mutex_unlock(&style_lock);
+  free(file_name);
+  return style;
+}
+
+static void free_request(request_t *request) {
+  free(request->language);
+  free(request->style);
+  free(request->document_type);
+  free(request->name);
+  free(request->content);
+  memset(request, 0, sizeof(request_t));
+}
+
+/** Read a request in server mode.
+
+    A request consists of header lines of the form "<key>: <value>", followed by an empty line
+    and the number of bytes of content given by the length header. Returns @c t3_false at the
+    end of the input, or if the request is malformed, in which case @p error is set.
+*/
+static t3_bool read_request(FILE *in, request_t *request, char *error) {
+  char *line = NULL, *value, **field;
+  size_t n;
+  ssize_t chars_read;
+  t3_bool have_header = t3_false, have_length = t3_false;
+
+  memset(request, 0, sizeof(request_t));
+  error[0] = 0;
+  while ((chars_read = getline(&line, &n, in)) > 0) {
+    if (line[chars_read - 1] == '\n') {
+      line[--chars_read] = 0;
+    }
+    if (chars_read > 0 && line[chars_read - 1] == '\r') {
+      line[--chars_read] = 0;
+    }
+    if (chars_read == 0) {
+      break;
+    }
+
+    if ((value = strchr(line, ':')) == NULL) {
+      set_error(error, _("Invalid header line '%s'"), line);
+      goto return_error;
+    }
+    *value++ = 0;
+    value += strspn(value, " \t");
+    have_header = t3_true;
+
+    if (strcmp(line, "length") == 0) {
+      char *endptr;
+      unsigned long long length;
+
+      errno = 0;
+      length = strtoull(value, &endptr, 10);
+      if (*value == 0 || *endptr != 0 || errno != 0 || length > SIZE_MAX - 1) {
+        set_error(error, _("Invalid length '%s'"), value);
+        goto return_error;
+      }
+      request->length = length;
+      have_length = t3_true;
+      continue;
+    } else if (strcmp(line, "language") == 0) {
+      field = &request->language;
+    } else if (strcmp(line, "style") == 0) {
+      field = &request->style;
+    } else if (strcmp(line, "document-type") == 0) {
+      field = &request->document_type;
+    } else if (strcmp(line, "name") == 0) {
+      field = &request->name;
+    } else {
+      set_error(error, _("Unknown header '%s'"), line);
+      goto return_error;
+    }
+    free(*field);
+    *field = safe_strdup(value);
+  }
+
+  if (chars_read < 0) {
+    /* End of input between requests is the normal way to end the session. */
+    if (have_header) {
+      set_error(error, _("Incomplete request"));
+    }
+    goto return_error;
+  }
+  if (!have_length) {
+    set_error(error, _("Missing length header"));
+    goto return_error;
+  }
+  if ((request->content = malloc(request->length + 1)) == NULL) {
+    set_error(error, _("Out of memory"));
+    goto return_error;
+  }
+  if (fread(request->content, 1, request->length, in) != request->length) {
+    set_error(error, _("Incomplete request"));
+    goto return_error;
+  }
+  free(line);
+  return t3_true;
+
+return_error:
   free(line);
+  free_request(request);
+  return t3_false;
+}
+
+/** Write a reply in server mode, in the same format as a request. */
+static t3_bool write_reply(FILE *out, t3_bool ok, const char *data, size_t size) {
+  fprintf(out, "status: %s\nlength: %lu\n\n", ok ? "ok" : "error", (unsigned long)size);
+  return fwrite(data, 1, size, out) == size && fflush(out) == 0;
+}
+
+/** Handle a single request, and write the reply. */
+static t3_bool handle_request(FILE *out, const request_t *request, output_t *output) {
+  char error[ERROR_SIZE];
+  const style_t *style;
+  const cache_entry_t *entry;
+  char *result;
+  size_t result_size;
+  input_t input;
+  t3_bool success;
+
+  if (request->language == NULL) {
+    set_error(error, _("Missing language header"));
+    return write_reply(out, t3_false, error, strlen(error));
+  }
+  if ((style = get_style(request->style, request->document_type, error)) == NULL) {
+    return write_reply(out, t3_false, error, strlen(error));
+  }
+  entry = get_cache_entry(request->language, t3_true, style);
+  if (entry->highlight == NULL) {
+    return write_reply(out, t3_false, entry->error, strlen(entry->error));
+  }
+
+  if ((output->file = open_memstream(&result, &result_size)) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  output->style = style;
+  output->name = request->name;
+  output->attribute = -1;
+  output->fill = 0;
+
+  memset(&input, 0, sizeof(input_t));
+  input.fd = -1;
+  input.data = request->content;
+  input.size = request->length;
+  input.eof = t3_true;
+
+  /* Only a limited number of requests is highlighted at the same time, if requested. */
+  if (option_jobs > 0) {
+    pthread_mutex_lock(&slot_lock);
+    while (slots_used >= option_jobs) {
+      pthread_cond_wait(&slot_available, &slot_lock);
+    }
+    slots_used++;
+    pthread_mutex_unlock(&slot_lock);
+  }
+
+  highlight_file(entry->highlight, &input, output, NULL, t3_false);
+
+  if (option_jobs > 0) {
+    pthread_mutex_lock(&slot_lock);
+    slots_used--;
+    pthread_cond_signal(&slot_available);
+    pthread_mutex_unlock(&slot_lock);
+  }
+
+  if (fclose(output->file) != 0) {
+    fatal(_("Out of memory\n"));
+  }
+  success = write_reply(out, t3_true, result, result_size);
+  free(result);
+  return success;
+}
+
+/** Handle requests from @p in until the end of the input, or until the connection fails. */
+static void serve_stream(FILE *in, FILE *out) {
+  char error[ERROR_SIZE];
+  request_t request;
+  output_t *output;
+
+  if ((output = malloc(sizeof(output_t))) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  while (read_request(in, &request, error)) {
+    t3_bool success = handle_request(out, &request, output);
+    free_request(&request);
+    if (!success) {
+      break;
+    }
+  }
+  /* A malformed request ends the session, as the start of the next request is unknown. */
+  if (error[0] != 0) {
+    write_reply(out, t3_false, error, strlen(error));
+  }
+  free(output);
+}
+
+static void *serve_connection(void *data) {
+  int fd = (int)(intptr_t)data, out_fd;
+  FILE *in, *out;
+
+  if ((out_fd = dup(fd)) < 0) {
+    close(fd);
+    return NULL;
+  }
+  if ((in = fdopen(fd, "r")) == NULL || (out = fdopen(out_fd, "w")) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  serve_stream(in, out);
+  fclose(in);
+  fclose(out);
+  return NULL;
+}
+
+/** Accept connections on the Unix domain socket @p path, and handle each in its own thread. */
+static void serve_socket(const char *path) {
+  struct sockaddr_un address;
+  struct stat statbuf;
+  pthread_attr_t attributes;
+  pthread_t thread;
+  int fd, connection;
+
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    fatal(_("Socket name too long: %s\n"), path);
+  }
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path);
+
+  /* Remove a socket left by a previous instance, but never any other type of file. */
+  if (lstat(path, &statbuf) == 0 && S_ISSOCK(statbuf.st_mode)) {
+    unlink(path);
+  }
+  if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+      bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+    fatal(_("Can't listen on '%s': %s\n"), path, strerror(errno));
+  }
+
+  pthread_attr_init(&attributes);
+  pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+  while (1) {
+    if ((connection = accept(fd, NULL, NULL)) < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      fatal(_("Error accepting connection: %s\n"), strerror(errno));
+    }
+    if ((errno = pthread_create(&thread, &attributes, serve_connection,
+                                (void *)(intptr_t)connection)) != 0) {
+      fatal(_("Can't create thread: %s\n"), strerror(errno));
+    }
+  }
 }
 
 int main(int argc, char *argv[]) {
-  t3_highlight_t *highlight;
   t3_highlight_error_t error;
-#ifdef DEBUG
-  int i;
-#endif
+  char style_error[ERROR_SIZE];
+  pthread_t *threads;
+  int thread_count, i;
 
 #ifdef USE_GETTEXT
   setlocale(LC_ALL, "");
@@ -595,59 +1889,125 @@ int main(int argc, char *argv[]) {
 
   parse_args(argc, argv);
 
-  styles = load_style(option_style == NULL ? DEFAULT_STYLE : option_style);
+  if (option_serve) {
+    if (inputs_used > 0 || option_files_from != NULL || option_output != NULL) {
+      fatal(_("--serve does not allow input or output files\n"));
+    } else if (option_language != NULL || option_language_file != NULL) {
+      fatal(_("--serve does not allow -l/--language or --language-file\n"));
+    } else if (option_stats || option_profile || option_lint) {
+      fatal(_("--serve does not allow --stats, --profile or --lint\n"));
+    } else if (option_index != NULL || option_first_line != 0 ||
+               option_last_line != (size_t)-1) {
+      fatal(_("--serve does not allow --index or --lines\n"));
+    }
+    if ((default_style = load_style(option_style == NULL ? DEFAULT_STYLE : option_style,
+                                    option_document_type, style_error)) == NULL) {
+      fatal("%s\n", style_error);
+    }
+    set_tag("charset", "UTF-8");
+    /* Closed connections are detected by the failing write instead. */
+    signal(SIGPIPE, SIG_IGN);
+    if (option_socket != NULL) {
+      serve_socket(option_socket);
+    }
+    serve_stream(stdin, stdout);
+    return EXIT_SUCCESS;
+  }
 
-  if (option_input != NULL && strcmp(option_input, "-") == 0) {
-    option_input = NULL;
+  if (option_files_from != NULL) {
+    read_file_list(option_files_from);
+  }
+  if (inputs_used == 0) {
+    add_input(NULL);
   }
 
-  if (option_language == NULL && option_language_file == NULL && option_input == NULL) {
-    fatal(_("-l/--language or --language-file required for reading from standard input\n"));
-  } else if (option_language_file != NULL) {
-    highlight = t3_highlight_load(option_language_file, map_style, styles,
-                                  T3_HIGHLIGHT_VERBOSE_ERROR | T3_HIGHLIGHT_UTF8, &error);
-  } else if (option_language != NULL) {
-    highlight = t3_highlight_load_by_langname(
-        option_language, map_style, styles, T3_HIGHLIGHT_VERBOSE_ERROR | T3_HIGHLIGHT_UTF8, &error);
-  } else {
-    highlight = t3_highlight_load_by_filename(
-        option_input, map_style, styles, T3_HIGHLIGHT_VERBOSE_ERROR | T3_HIGHLIGHT_UTF8, &error);
+  if (inputs_used > 1) {
+    if (option_output == NULL) {
+      fatal(_("-o/--output is required for multiple input files\n"));
+    } else if (strstr(option_output, "%{name}") == NULL) {
+      fatal(_("-o/--output must contain %%{name} for multiple input files\n"));
+    } else if (option_stats || option_profile || option_lint) {
+      fatal(_("--stats, --profile and --lint only allow a single input file\n"));
+    }
+  }
+
+  if ((default_style = load_style(option_style == NULL ? DEFAULT_STYLE : option_style,
+                                  option_document_type, style_error)) == NULL) {
+    fatal("%s\n", style_error);
   }
 
-  if (highlight == NULL) {
-    if (error.file_name == NULL) {
-      fprintf(stderr, _("Error loading highlighting patterns: "));
-      fatal("%s\n", t3_highlight_strerror(error.error));
+  if (option_language == NULL && option_language_file == NULL) {
+    for (i = 0; (size_t)i < inputs_used; i++) {
+      if (inputs[i] == NULL) {
+        fatal(_("-l/--language or --language-file required for reading from standard input\n"));
+      }
+    }
+  } else {
+    if (option_language_file != NULL) {
+      fixed_highlight = t3_highlight_load(option_language_file, map_style, default_style->defs,
+                                          T3_HIGHLIGHT_VERBOSE_ERROR | T3_HIGHLIGHT_UTF8, &error);
+    } else {
+      fixed_highlight = t3_highlight_load_by_langname(
+          option_language, map_style, default_style->defs,
+          T3_HIGHLIGHT_VERBOSE_ERROR | T3_HIGHLIGHT_UTF8, &error);
+    }
+    if (fixed_highlight == NULL) {
+      format_load_error(&error, style_error);
+      fatal("%s\n", style_error);
     }
+  }
 
-    fprintf(stderr, _("Error loading highlighting patterns: "));
-    fprintf(stderr, "%s:%d: %s", error.file_name, error.line_number,
-            t3_highlight_strerror(error.error));
-    if (error.extra != NULL) {
-      fprintf(stderr, ": %s", error.extra);
+  if (option_lint) {
+    t3_highlight_t *highlight = get_highlight(inputs[0], t3_false);
+    if (highlight == NULL) {
+      exit(EXIT_FAILURE);
     }
-    fatal("\n");
+    lint(highlight);
   }
 
-  set_tag("name", option_input);
   set_tag("charset", "UTF-8");
 
-  highlight_file(highlight);
-#ifdef DEBUG
-  for (i = 0; styles[i].tag != NULL; i++) {
-    free(styles[i].tag);
-    free(styles[i].start);
-    free(styles[i].end);
+  /* Without -j, the files are highlighted one at a time. */
+  if (option_jobs <= 0) {
+    thread_count = 1;
+  } else {
+    thread_count = (size_t)option_jobs < inputs_used ? option_jobs : (int)inputs_used;
+  }
+  if (thread_count <= 1) {
+    highlight_worker(NULL);
+  } else {
+    if ((threads = malloc(thread_count * sizeof(pthread_t))) == NULL) {
+      fatal(_("Out of memory\n"));
+    }
+    for (i = 0; i < thread_count; i++) {
+      if ((errno = pthread_create(&threads[i], NULL, highlight_worker, NULL)) != 0) {
+        fatal(_("Can't create thread: %s\n"), strerror(errno));
+      }
+    }
+    for (i = 0; i < thread_count; i++) {
+      pthread_join(threads[i], NULL);
+    }
+    free(threads);
   }
-  free(styles);
 
+#ifdef DEBUG
   tag_t *tag;
   for (tag = tags; tag != NULL;) {
     tag_t *ptr = tag;
     tag = tag->next;
     free(ptr);
   }
-  t3_highlight_free(highlight);
+  t3_highlight_free(fixed_highlight);
+  while (highlight_cache != NULL) {
+    cache_entry_t *entry = highlight_cache;
+    highlight_cache = entry->next;
+    t3_highlight_free(entry->highlight);
+    free(entry->language);
+    free(entry->error);
+    free(entry);
+  }
+  free_style(default_style);
+  free(inputs);
 #endif
-  return EXIT_SUCCESS;
+  return batch_failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
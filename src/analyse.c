@@ -24,174 +24,925 @@
 #include "highlight_errors.h"
 #include "internal.h"
 
-static t3_bool check_empty_start_cycle_from_state(highlight_context_t *context,
-                                                  pattern_idx_t state) {
+/** Determine whether a pattern is a start pattern that can match the empty string. */
+static t3_bool is_empty_start(const pattern_t *pattern) {
   uint32_t min_length;
-  size_t j;
+
+  if (pattern->regex == NULL || pattern->next_state <= NO_CHANGE) {
+    return t3_false;
+  }
+  /* This should be pretty much impossible to happen, so we just continue
+     as if this pattern matches at least one byte. */
+  if (pcre2_pattern_info_8(pattern->regex, PCRE2_INFO_MINLENGTH, &min_length) != 0) {
+    return t3_false;
+  }
+  return min_length == 0;
+}
+
+/** Add the transitions for a single pattern, or count them if @p graph->transitions is @c NULL.
+    @param graph The graph to fill.
+    @param state The state the pattern belongs to.
+    @param pattern The pattern to add transitions for.
+    @param types The types of transitions to include.
+    @param fill The location of the next transition out of @p state.
+
+    A start pattern that can match the empty string and that has on-entry states enters
+    its on-entry states one after the other. These are modeled as a chain of transitions
+    from the state entered by the start pattern. A link in this chain from a state to itself
+    only repeats the state on the stack, and is left out such that it is not reported as a
+    cycle.
+*/
+static void add_pattern_transitions(transition_graph_t *graph, pattern_idx_t state,
+                                    const pattern_t *pattern, int types, size_t *fill) {
+#define ADD_TRANSITION(from, to, transition_type)                  \
+  do {                                                             \
+    if (graph->transitions != NULL) {                              \
+      graph->transitions[fill[from]].target = (to);                \
+      graph->transitions[fill[from]].type = (transition_type);     \
+    }                                                              \
+    fill[from]++;                                                  \
+  } while (0)
+
+  if (pattern->regex == NULL) {
+    if ((types & TRANSITION_USE) && pattern->next_state > NO_CHANGE) {
+      ADD_TRANSITION(state, pattern->next_state, TRANSITION_USE);
+    }
+  } else if ((types & TRANSITION_EMPTY_START) && is_empty_start(pattern)) {
+    ADD_TRANSITION(state, pattern->next_state, TRANSITION_EMPTY_START);
+    if (pattern->extra != NULL && pattern->extra->on_entry_cnt > 0) {
+      pattern_idx_t from = pattern->next_state;
+      int i;
+      for (i = 0; i < pattern->extra->on_entry_cnt; i++) {
+        if (pattern->extra->on_entry[i].state != from) {
+          ADD_TRANSITION(from, pattern->extra->on_entry[i].state, TRANSITION_EMPTY_START);
+        }
+        from = pattern->extra->on_entry[i].state;
+      }
+    }
+  }
+#undef ADD_TRANSITION
+}
+
+/** Build the graph of transitions between states of the given @p types. */
+static t3_bool build_transition_graph(highlight_context_t *context, transition_graph_t *graph,
+                                      int types) {
   states_t *states = &context->highlight->states;
+  size_t *fill = NULL;
+  size_t i, j, total;
 
-  VECTOR(state_stack_t) state_stack;
-  VECTOR_INIT(state_stack);
+  graph->state_count = states->used;
+  graph->transitions = NULL;
+  if ((graph->first = malloc((states->used + 1) * sizeof(size_t))) == NULL ||
+      (fill = calloc(states->used + 1, sizeof(size_t))) == NULL) {
+    goto return_error;
+  }
 
-  if (!VECTOR_RESERVE(state_stack)) {
-    _t3_highlight_set_error_simple(context->error, T3_ERR_OUT_OF_MEMORY, context->flags);
+  /* First count the number of transitions out of each state, ... */
+  for (i = 0; i < states->used; i++) {
+    for (j = 0; j < states->data[i].patterns.used; j++) {
+      add_pattern_transitions(graph, i, &states->data[i].patterns.data[j], types, fill);
+    }
+  }
+  for (total = 0, i = 0; i < states->used; i++) {
+    graph->first[i] = total;
+    total += fill[i];
+    fill[i] = graph->first[i];
+  }
+  graph->first[states->used] = total;
+
+  /* ... then fill in the transitions. */
+  if ((graph->transitions = malloc((total == 0 ? 1 : total) * sizeof(transition_t))) == NULL) {
     goto return_error;
   }
+  for (i = 0; i < states->used; i++) {
+    for (j = 0; j < states->data[i].patterns.used; j++) {
+      add_pattern_transitions(graph, i, &states->data[i].patterns.data[j], types, fill);
+    }
+  }
+  free(fill);
+  return t3_true;
+
+return_error:
+  _t3_highlight_set_error_simple(context->error, T3_ERR_OUT_OF_MEMORY, context->flags);
+  free(fill);
+  free(graph->first);
+  graph->first = NULL;
+  return t3_false;
+}
+
+static void free_transition_graph(transition_graph_t *graph) {
+  free(graph->first);
+  free(graph->transitions);
+}
+
+typedef struct {
+  size_t index, lowlink;
+  t3_bool on_stack;
+} scc_node_t;
+
+typedef struct {
+  pattern_idx_t state;
+  size_t next;
+} scc_frame_t;
+
+#define SCC_UNVISITED ((size_t)-1)
+
+/** Determine whether the transitions of the given @p types in @p graph contain a cycle.
+    @param graph The graph to check.
+    @param types The types of transitions to follow.
+    @param found Location to store the result.
+    @return @c t3_false if memory allocation failed, @c t3_true otherwise.
+
+    This uses Tarjan's strongly connected components algorithm, such that the check takes time
+    linear in the number of states and transitions. A cycle exists if a state has a transition to
+    itself, or if a strongly connected component consists of more than one state.
+*/
+static t3_bool find_cycle(const transition_graph_t *graph, int types, t3_bool *found) {
+  size_t n = graph->state_count;
+  scc_node_t *nodes;
+  scc_frame_t *call_stack;
+  pattern_idx_t *scc_stack;
+  size_t call_used = 0, scc_used = 0, next_index = 0;
+  size_t root;
+
+  *found = t3_false;
+  nodes = malloc(n * sizeof(scc_node_t));
+  call_stack = malloc(n * sizeof(scc_frame_t));
+  scc_stack = malloc(n * sizeof(pattern_idx_t));
+  if (nodes == NULL || call_stack == NULL || scc_stack == NULL) {
+    free(nodes);
+    free(call_stack);
+    free(scc_stack);
+    return t3_false;
+  }
 
-  VECTOR_LAST(state_stack).state = state;
-  VECTOR_LAST(state_stack).i = 0;
+  for (root = 0; root < n; root++) {
+    nodes[root].index = SCC_UNVISITED;
+    nodes[root].on_stack = t3_false;
+  }
 
-  while (state_stack.used) {
-    size_t current_idx = state_stack.used - 1;
-#define CURRENT state_stack.data[current_idx]
+#define VISIT(s)                                       \
+  do {                                                 \
+    nodes[s].index = nodes[s].lowlink = next_index++;  \
+    nodes[s].on_stack = t3_true;                       \
+    scc_stack[scc_used++] = (s);                       \
+    call_stack[call_used].state = (s);                 \
+    call_stack[call_used++].next = graph->first[s];    \
+  } while (0)
 
-    if (CURRENT.i == states->data[CURRENT.state].patterns.used) {
-      state_stack.used--;
+  for (root = 0; root < n && !*found; root++) {
+    if (nodes[root].index != SCC_UNVISITED) {
       continue;
     }
+    VISIT(root);
 
-    for (; CURRENT.i < states->data[CURRENT.state].patterns.used; CURRENT.i++) {
-      pattern_t *highlight = &states->data[CURRENT.state].patterns.data[CURRENT.i];
+    while (call_used > 0 && !*found) {
+      scc_frame_t *frame = &call_stack[call_used - 1];
+      pattern_idx_t state = frame->state;
 
-      if (highlight->next_state <= NO_CHANGE) {
-        continue;
-      }
+      if (frame->next < graph->first[state + 1]) {
+        const transition_t *transition = &graph->transitions[frame->next++];
+        pattern_idx_t target = transition->target;
 
-      if (highlight->regex == NULL) {
-        /* This is a use pattern. For those we can simply push them on the
-           stack, and they will be handled correctly. */
-        if (!VECTOR_RESERVE(state_stack)) {
-          _t3_highlight_set_error_simple(context->error, T3_ERR_OUT_OF_MEMORY, context->flags);
-          goto return_error;
+        if (!(transition->type & types)) {
+          continue;
+        }
+        if (target == state) {
+          *found = t3_true;
+        } else if (nodes[target].index == SCC_UNVISITED) {
+          VISIT(target);
+        } else if (nodes[target].on_stack && nodes[target].index < nodes[state].lowlink) {
+          nodes[state].lowlink = nodes[target].index;
         }
-        VECTOR_LAST(state_stack).state = highlight->next_state;
-        VECTOR_LAST(state_stack).i = 0;
-        continue;
-      }
-
-      /* This should be pretty much impossible to happen, so we just continue
-         as if this pattern matches at least one byte. */
-      if (pcre2_pattern_info_8(highlight->regex, PCRE2_INFO_MINLENGTH, &min_length) != 0) {
-        continue;
-      }
-
-      /* If this pattern can not match the empty string, we don't have to
-         consider it any further. */
-      if (min_length > 0) {
         continue;
       }
 
-      /* If we push a state onto the stack that is already on it, we've
-         found a cycle. */
-      for (j = 0; j < state_stack.used; j++) {
-        if (state_stack.data[j].state == highlight->next_state) {
-          _t3_highlight_set_error_simple(context->error, T3_ERR_EMPTY_START_CYCLE, context->flags);
-          goto return_error;
+      /* All transitions out of state have been handled. If it is the root of a strongly
+         connected component, the component is on top of the SCC stack. */
+      if (nodes[state].lowlink == nodes[state].index) {
+        if (scc_stack[scc_used - 1] != state) {
+          *found = t3_true;
+        } else {
+          nodes[state].on_stack = t3_false;
+          scc_used--;
         }
       }
-      /* Push the next state onto the stack, so we can go from there later on. */
-      if (!VECTOR_RESERVE(state_stack)) {
-        _t3_highlight_set_error_simple(context->error, T3_ERR_OUT_OF_MEMORY, context->flags);
-        goto return_error;
-      }
-      VECTOR_LAST(state_stack).state = highlight->next_state;
-      VECTOR_LAST(state_stack).i = 0;
-
-      /* For on-entry states, we simply push all of them. */
-      if (highlight->extra != NULL && highlight->extra->on_entry_cnt > 0) {
-        for (j = 0; (int)j < highlight->extra->on_entry_cnt; j++) {
-          if (!VECTOR_RESERVE(state_stack)) {
-            _t3_highlight_set_error_simple(context->error, T3_ERR_OUT_OF_MEMORY, context->flags);
-            goto return_error;
-          }
-          VECTOR_LAST(state_stack).state = highlight->extra->on_entry[j].state;
-          VECTOR_LAST(state_stack).i = 0;
+      call_used--;
+      if (call_used > 0) {
+        pattern_idx_t parent = call_stack[call_used - 1].state;
+        if (nodes[state].lowlink < nodes[parent].lowlink) {
+          nodes[parent].lowlink = nodes[state].lowlink;
         }
       }
-      CURRENT.i++;
-      break;
     }
   }
-  VECTOR_FREE(state_stack);
+#undef VISIT
+
+  free(nodes);
+  free(call_stack);
+  free(scc_stack);
+  return t3_true;
+}
+
+t3_bool _t3_check_cycles(highlight_context_t *context) {
+  transition_graph_t graph;
+  t3_bool found;
+  int types = TRANSITION_USE;
+
+  if (context->flags & T3_HIGHLIGHT_ALLOW_EMPTY_START) {
+    types |= TRANSITION_EMPTY_START;
+  }
+  if (!build_transition_graph(context, &graph, types)) {
+    return t3_false;
+  }
+
+  /* Use cycles are checked first, because an empty start cycle may include use transitions. */
+  if (!find_cycle(&graph, TRANSITION_USE, &found)) {
+    goto return_error_memory;
+  }
+  if (found) {
+    _t3_highlight_set_error_simple(context->error, T3_ERR_USE_CYCLE, context->flags);
+    goto return_error;
+  }
+
+  if (types & TRANSITION_EMPTY_START) {
+    if (!find_cycle(&graph, TRANSITION_USE | TRANSITION_EMPTY_START, &found)) {
+      goto return_error_memory;
+    }
+    if (found) {
+      _t3_highlight_set_error_simple(context->error, T3_ERR_EMPTY_START_CYCLE, context->flags);
+      goto return_error;
+    }
+  }
+  free_transition_graph(&graph);
   return t3_true;
 
+return_error_memory:
+  _t3_highlight_set_error_simple(context->error, T3_ERR_OUT_OF_MEMORY, context->flags);
 return_error:
-  VECTOR_FREE(state_stack);
+  free_transition_graph(&graph);
   return t3_false;
 }
 
-t3_bool _t3_check_empty_start_cycle(highlight_context_t *context) {
+/* The possible outcomes of trying the patterns of a state at the end of a line, where only
+   empty matches are possible. */
+typedef enum {
+  LINE_END_NONE,       /* No pattern can match. */
+  LINE_END_MAYBE_EXIT, /* Only patterns that exit the state can match, but they may not. */
+  LINE_END_EXIT,       /* A pattern that exits the state always matches. */
+  LINE_END_UNKNOWN     /* A start pattern may match. */
+} line_end_t;
+
+/** Determine whether @p regex matches the empty string at the end of any line.
+
+    Without look-behind, which includes @c \\b and @c \\B, the only construct that looks at the
+    text before the end of the line is ^. Therefore matching an empty subject, both as the start
+    of a line and otherwise, covers all lines.
+*/
+static t3_bool always_matches_line_end(pcre2_code_8 *regex, pcre2_match_data_8 *match_data) {
+  uint32_t lookbehind;
+
+  if (pcre2_pattern_info_8(regex, PCRE2_INFO_MAXLOOKBEHIND, &lookbehind) != 0 || lookbehind > 0) {
+    return t3_false;
+  }
+  return pcre2_match_8(regex, (PCRE2_SPTR8) "", 0, 0, 0, match_data, NULL) >= 0 &&
+         pcre2_match_8(regex, (PCRE2_SPTR8) "", 0, 0, PCRE2_NOTBOL, match_data, NULL) >= 0;
+}
+
+/** Determine what happens when the patterns of @p state are tried at the end of a line.
+    At the end of a line all matches are empty, so the first pattern that matches is used. */
+static line_end_t get_line_end(const t3_highlight_t *highlight, const state_t *state, int flags,
+                               pcre2_match_data_8 *match_data) {
+  line_end_t result = LINE_END_NONE;
   size_t i;
-  for (i = 0; i < context->highlight->states.used; i++) {
-    if (!check_empty_start_cycle_from_state(context, i)) {
-      return t3_false;
+
+  for (i = 0; i < state->patterns.used; i++) {
+    const pattern_t *pattern = &state->patterns.data[i];
+    line_end_t pattern_result;
+    uint32_t min_length;
+
+    if (pattern->regex == NULL) {
+      if (pattern->next_state >= 0) {
+        /* Links to other states are not cyclic, as checked by _t3_check_cycles. */
+        pattern_result =
+            get_line_end(highlight, &highlight->states.data[pattern->next_state], flags,
+                         match_data);
+      } else if (pattern->extra == NULL) {
+        /* End pattern with a dynamic back reference. */
+        pattern_result = LINE_END_MAYBE_EXIT;
+      } else {
+        pattern_result = pattern->next_state != NO_CHANGE &&
+                                 pattern->extra->keywords->min_length == 0
+                             ? LINE_END_MAYBE_EXIT
+                             : LINE_END_NONE;
+      }
+    } else if (pattern->next_state == NO_CHANGE ||
+               (pattern->next_state > NO_CHANGE && !(flags & T3_HIGHLIGHT_ALLOW_EMPTY_START))) {
+      /* These patterns are matched using PCRE2_NOTEMPTY. */
+      pattern_result = LINE_END_NONE;
+    } else if (pcre2_pattern_info_8(pattern->regex, PCRE2_INFO_MINLENGTH, &min_length) == 0 &&
+               min_length > 0) {
+      pattern_result = LINE_END_NONE;
+    } else if (pattern->next_state > NO_CHANGE) {
+      pattern_result = LINE_END_UNKNOWN;
+    } else {
+      pattern_result = always_matches_line_end(pattern->regex, match_data) ? LINE_END_EXIT
+                                                                           : LINE_END_MAYBE_EXIT;
+    }
+
+    if (pattern_result == LINE_END_EXIT || pattern_result == LINE_END_UNKNOWN) {
+      return pattern_result;
+    } else if (pattern_result == LINE_END_MAYBE_EXIT) {
+      result = LINE_END_MAYBE_EXIT;
     }
   }
-  return t3_true;
+  return result;
 }
 
-t3_bool _t3_check_use_cycle(highlight_context_t *context) {
-  size_t i, j;
+/** Mark the states entered by the start patterns of @p state, including those of the states
+    it uses, and their on-entry states. */
+static void mark_entered_states(const t3_highlight_t *highlight, const state_t *state,
+                                t3_bool *entered) {
+  size_t i;
+  int j;
 
-  VECTOR(state_stack_t) state_stack;
-  VECTOR_INIT(state_stack);
+  for (i = 0; i < state->patterns.used; i++) {
+    const pattern_t *pattern = &state->patterns.data[i];
 
-  for (i = 0; i < context->highlight->states.used; i++) {
-    if (!VECTOR_RESERVE(state_stack)) {
-      _t3_highlight_set_error_simple(context->error, T3_ERR_OUT_OF_MEMORY, context->flags);
-      goto return_error;
+    if (pattern->next_state < 0) {
+      continue;
+    }
+    if (pattern->regex == NULL) {
+      mark_entered_states(highlight, &highlight->states.data[pattern->next_state], entered);
+      continue;
+    }
+    entered[pattern->next_state] = t3_true;
+    if (pattern->extra != NULL) {
+      for (j = 0; j < pattern->extra->on_entry_cnt; j++) {
+        entered[pattern->extra->on_entry[j].state] = t3_true;
+      }
     }
+  }
+}
 
-    VECTOR_LAST(state_stack).state = i;
-    VECTOR_LAST(state_stack).i = 0;
+t3_bool _t3_analyse_line_ends(highlight_context_t *context) {
+  t3_highlight_t *highlight = context->highlight;
+  pcre2_match_data_8 *match_data;
+  t3_bool *entered;
+  size_t i;
 
-    while (state_stack.used) {
-      size_t current_idx = state_stack.used - 1;
-#define CURRENT state_stack.data[current_idx]
+  entered = calloc(highlight->states.used, sizeof(t3_bool));
+  match_data = pcre2_match_data_create_8(1, NULL);
+  if (entered == NULL || match_data == NULL) {
+    free(entered);
+    pcre2_match_data_free_8(match_data);
+    _t3_highlight_set_error_simple(context->error, T3_ERR_OUT_OF_MEMORY, context->flags);
+    return t3_false;
+  }
 
-      if (CURRENT.i == context->highlight->states.data[CURRENT.state].patterns.used) {
-        state_stack.used--;
-        continue;
+  /* States which are only used through use links are never active themselves. */
+  for (i = 0; i < highlight->states.used; i++) {
+    mark_entered_states(highlight, &highlight->states.data[i], entered);
+  }
+
+  /* A state that always exits at the end of a line leaves the next line to its parent. If
+     all states do so, every line ends in the outermost state. The entered flags are turned
+     into the line end flags in place. */
+  highlight->line_end_states = 0;
+  entered[0] = t3_true;
+  for (i = 1; i < highlight->states.used; i++) {
+    if (entered[i] && get_line_end(highlight, &highlight->states.data[i], context->flags,
+                                   match_data) != LINE_END_EXIT) {
+      highlight->line_end_states++;
+    } else {
+      entered[i] = t3_false;
+    }
+  }
+
+  highlight->line_end = entered;
+  pcre2_match_data_free_8(match_data);
+  return t3_true;
+}
+
+t3_bool t3_highlight_is_line_independent(const t3_highlight_t *highlight) {
+  return highlight->line_end_states == 0;
+}
+
+t3_bool t3_highlight_state_can_end_line(const t3_highlight_match_t *match, int state) {
+  return match->highlight->line_end[match->mapping.data[state].highlight_state];
+}
+
+/* A state with more patterns than this is reported by t3_highlight_lint. */
+#define LINT_MANY_PATTERNS 32
+/* Maximum nesting depth of groups that is analysed in a regular expression. */
+#define LINT_MAX_GROUP_DEPTH 64
+
+typedef struct {
+  const char *name;
+  const t3_config_t *definition;
+  t3_bool reachable;
+  t3_bool checked;
+} lint_define_t;
+
+typedef struct {
+  VECTOR(t3_highlight_lint_t) findings;
+  VECTOR(lint_define_t) defines;
+  t3_bool mark_reachable;
+  t3_bool out_of_memory;
+} lint_context_t;
+
+typedef struct {
+  t3_bool has_unbounded;
+  t3_bool has_alternation;
+  t3_bool has_required_literal;
+  t3_bool overlap;
+  t3_bool atomic;
+  t3_bool alternative_start;
+  unsigned char first_chars[32];
+} lint_group_t;
+
+static void add_finding(lint_context_t *context, int type, const t3_config_t *item,
+                        const char *extra) {
+  t3_highlight_lint_t *finding;
+  const char *file_name = t3_config_get_file_name(item);
+
+  if (!VECTOR_RESERVE(context->findings)) {
+    context->out_of_memory = t3_true;
+    return;
+  }
+  finding = &VECTOR_LAST(context->findings);
+  finding->type = type;
+  finding->line_number = t3_config_get_line_number(item);
+  finding->file_name = file_name == NULL ? NULL : _t3_highlight_strdup(file_name);
+  finding->extra = extra == NULL ? NULL : _t3_highlight_strdup(extra);
+  if ((file_name != NULL && finding->file_name == NULL) ||
+      (extra != NULL && finding->extra == NULL)) {
+    context->out_of_memory = t3_true;
+  }
+}
+
+/** Parse a quantifier at @p regex.
+    @return The number of bytes in the quantifier, or 0 if there is none.
+
+    @p unbounded is set if the quantifier allows an unlimited number of repetitions, and
+    @p possessive is set if the quantifier does not backtrack.
+*/
+static size_t parse_quantifier(const char *regex, t3_bool *unbounded, t3_bool *possessive) {
+  size_t length;
+
+  *unbounded = t3_false;
+  *possessive = t3_false;
+  switch (regex[0]) {
+    case '*':
+    case '+':
+      *unbounded = t3_true;
+    /* FALLTHROUGH */
+    case '?':
+      length = 1;
+      break;
+    case '{':
+      length = 1 + strspn(regex + 1, "0123456789");
+      if (length == 1) {
+        return 0;
+      }
+      if (regex[length] == ',') {
+        size_t max_length = strspn(regex + length + 1, "0123456789");
+        *unbounded = max_length == 0;
+        length += 1 + max_length;
       }
+      if (regex[length] != '}') {
+        return 0;
+      }
+      length++;
+      break;
+    default:
+      return 0;
+  }
+  if (regex[length] == '+') {
+    *possessive = t3_true;
+    length++;
+  } else if (regex[length] == '?') {
+    length++;
+  }
+  return length;
+}
+
+/** Register the first character of an alternative, to detect alternatives that overlap. */
+static void add_first_char(lint_group_t *group, int c) {
+  if (!group->alternative_start) {
+    return;
+  }
+  group->alternative_start = t3_false;
+  if (c < 0) {
+    return;
+  }
+  if (group->first_chars[c >> 3] & (1 << (c & 7))) {
+    group->overlap = t3_true;
+  }
+  group->first_chars[c >> 3] |= 1 << (c & 7);
+}
+
+/** Skip a back reference such as @c \\1, @c \\g{-1} or @c \\k<name>, of which the first
+    character after the backslash is at @p i. */
+static size_t skip_back_reference(const char *regex, size_t i) {
+  const char *close;
+
+  if (regex[i] >= '1' && regex[i] <= '9') {
+    return i + strspn(regex + i, "0123456789");
+  }
+  i++;
+  switch (regex[i]) {
+    case '{':
+      close = "}";
+      break;
+    case '<':
+      close = ">";
+      break;
+    case '\'':
+      close = "'";
+      break;
+    default:
+      i += regex[i] == '-' || regex[i] == '+';
+      return i + strspn(regex + i, "0123456789");
+  }
+  i += strcspn(regex + i, close);
+  return regex[i] == 0 ? i : i + 1;
+}
+
+/** Heuristically check a regular expression for constructs prone to catastrophic backtracking.
+
+    This looks for repeated groups which themselves contain an unbounded repetition (e.g.
+    @c (a+)*), and for repeated groups with alternatives that start with the same character (e.g.
+    @c (ab|ac)*). Atomic groups and possessive quantifiers are not considered, because they
+    do not backtrack.
+*/
+static void check_regex(lint_context_t *context, const t3_config_t *item) {
+  const char *regex = t3_config_get_string(item);
+  lint_group_t groups[LINT_MAX_GROUP_DEPTH];
+  int depth = 0;
+  size_t i = 0;
 
-      for (; CURRENT.i < context->highlight->states.data[CURRENT.state].patterns.used;
-           CURRENT.i++) {
-        pattern_t *highlight =
-            &context->highlight->states.data[CURRENT.state].patterns.data[CURRENT.i];
+  if (regex == NULL) {
+    return;
+  }
+
+  memset(&groups[0], 0, sizeof(lint_group_t));
+  groups[0].alternative_start = t3_true;
 
-        if (highlight->regex != NULL) {
+  while (regex[i] != 0) {
+    t3_bool atom = t3_true, literal = t3_false, unbounded, possessive;
+    size_t quantifier_length;
+
+    switch (regex[i]) {
+      case '\\':
+        if (regex[i + 1] == 'Q') {
+          const char *end = strstr(regex + i + 2, "\\E");
+          add_first_char(&groups[depth], (unsigned char)regex[i + 2]);
+          i = end == NULL ? strlen(regex) : (size_t)(end - regex) + 2;
           continue;
         }
-        if (highlight->next_state <= NO_CHANGE) {
-          continue;
+        if (regex[i + 1] == 0) {
+          return;
+        }
+        if ((regex[i + 1] >= '1' && regex[i + 1] <= '9') || regex[i + 1] == 'g' ||
+            regex[i + 1] == 'k') {
+          /* A back reference must match the text captured earlier, so for the purpose of
+             separating repetitions it counts as a literal. */
+          literal = t3_true;
+          add_first_char(&groups[depth], -1);
+          i = skip_back_reference(regex, i + 1);
+          break;
+        }
+        literal = strchr("\\.^$|?*+()[]{}/-", regex[i + 1]) != NULL;
+        add_first_char(&groups[depth], literal ? (unsigned char)regex[i + 1] : -1);
+        i += 2;
+        break;
+      case '[':
+        add_first_char(&groups[depth], -1);
+        i++;
+        if (regex[i] == '^') {
+          i++;
+        }
+        if (regex[i] == ']') {
+          i++;
         }
+        while (regex[i] != 0 && regex[i] != ']') {
+          if (regex[i] == '\\' && regex[i + 1] != 0) {
+            i++;
+          } else if (regex[i] == '[' && regex[i + 1] == ':') {
+            const char *end = strstr(regex + i, ":]");
+            if (end != NULL) {
+              i = end - regex + 1;
+            }
+          }
+          i++;
+        }
+        if (regex[i] == 0) {
+          return;
+        }
+        i++;
+        break;
+      case '(': {
+        const char *close = strchr(regex + i, ')');
+        size_t options;
 
-        /* If we push a state onto the stack that is already on it, we've
-           found a cycle. */
-        for (j = 0; j < state_stack.used; j++) {
-          if (state_stack.data[j].state == highlight->next_state) {
-            _t3_highlight_set_error_simple(context->error, T3_ERR_USE_CYCLE, context->flags);
-            goto return_error;
+        add_first_char(&groups[depth], -1);
+        if (close == NULL) {
+          return;
+        }
+        i++;
+        if (regex[i] == '*' || (regex[i] == '?' && regex[i + 1] == '#')) {
+          /* Verbs and comments. */
+          i = close - regex + 1;
+          continue;
+        } else if (regex[i] == '?') {
+          switch (regex[i + 1]) {
+            case ':':
+            case '>':
+            case '|':
+            case '=':
+            case '!':
+              i += 2;
+              break;
+            case '(':
+              /* Conditional group. The condition is handled as a group of its own. */
+              i++;
+              break;
+            case '<':
+              if (regex[i + 2] == '=' || regex[i + 2] == '!') {
+                i += 3;
+                break;
+              }
+            /* FALLTHROUGH */
+            case '\'':
+              i = strcspn(regex + i + 2, regex[i + 1] == '<' ? ">" : "'") + i + 2;
+              if (regex[i] != 0) {
+                i++;
+              }
+              break;
+            case 'P':
+              if (regex[i + 2] == '<') {
+                i = strcspn(regex + i, ">") + i;
+                if (regex[i] != 0) {
+                  i++;
+                }
+                break;
+              }
+              /* Named back reference or recursion. */
+              i = close - regex + 1;
+              goto atom_done;
+            default:
+              options = strspn(regex + i + 1, "imnsxJU^-");
+              if (regex[i + 1 + options] == ':') {
+                i += options + 2;
+                break;
+              }
+              /* Option setting, recursion or subroutine call. */
+              atom = regex[i + 1 + options] != ')';
+              i = close - regex + 1;
+              goto atom_done;
           }
         }
+        if (depth + 1 == LINT_MAX_GROUP_DEPTH) {
+          return;
+        }
+        depth++;
+        memset(&groups[depth], 0, sizeof(lint_group_t));
+        groups[depth].alternative_start = t3_true;
+        groups[depth].atomic = i >= 2 && regex[i - 2] == '?' && regex[i - 1] == '>';
+        continue;
+      }
+      case ')':
+        if (depth == 0) {
+          return;
+        }
+        i++;
+        quantifier_length = parse_quantifier(regex + i, &unbounded, &possessive);
+        if (unbounded && !possessive && !groups[depth].atomic) {
+          /* A literal that must occur in each repetition separates the repetitions, which
+             limits the amount of backtracking. */
+          if (groups[depth].has_unbounded &&
+              (groups[depth].has_alternation || !groups[depth].has_required_literal)) {
+            add_finding(context, T3_HIGHLIGHT_LINT_NESTED_QUANTIFIER, item, regex);
+            return;
+          } else if (groups[depth].overlap) {
+            add_finding(context, T3_HIGHLIGHT_LINT_OVERLAPPING_ALTERNATION, item, regex);
+            return;
+          }
+        }
+        if (!groups[depth].atomic && !possessive &&
+            (groups[depth].has_unbounded || unbounded)) {
+          groups[depth - 1].has_unbounded = t3_true;
+        }
+        depth--;
+        i += quantifier_length;
+        continue;
+      case '|':
+        groups[depth].alternative_start = t3_true;
+        groups[depth].has_alternation = t3_true;
+        i++;
+        continue;
+      case '^':
+      case '$':
+        i++;
+        continue;
+      default:
+        add_first_char(&groups[depth], (unsigned char)regex[i]);
+        literal = t3_true;
+        i++;
+        break;
+    }
 
-        /* Push the next state onto the stack, so we can go from there later on. */
-        if (!VECTOR_RESERVE(state_stack)) {
-          _t3_highlight_set_error_simple(context->error, T3_ERR_OUT_OF_MEMORY, context->flags);
-          goto return_error;
+  atom_done:
+    if (atom) {
+      quantifier_length = parse_quantifier(regex + i, &unbounded, &possessive);
+      if (unbounded && !possessive) {
+        groups[depth].has_unbounded = t3_true;
+      }
+      if (literal && (quantifier_length == 0 ||
+                      (regex[i] == '{' && regex[i + 1] != '0' && !unbounded))) {
+        groups[depth].has_required_literal = t3_true;
+      }
+      i += quantifier_length;
+    }
+  }
+}
+
+static void mark_use(lint_context_t *context, const t3_config_t *use) {
+  const char *name = t3_config_get_string(use);
+  size_t i;
+
+  if (!context->mark_reachable || name == NULL) {
+    return;
+  }
+  for (i = 0; i < context->defines.used; i++) {
+    if (strcmp(context->defines.data[i].name, name) == 0) {
+      context->defines.data[i].reachable = t3_true;
+      return;
+    }
+  }
+}
+
+static void lint_highlights(lint_context_t *context, const t3_config_t *highlights) {
+  const t3_config_t *item, *earlier, *regex, *on_entry;
+  int count = 0;
+
+  for (item = t3_config_get(highlights, NULL); item != NULL; item = t3_config_get_next(item)) {
+    count++;
+    if ((regex = t3_config_get(item, "regex")) != NULL ||
+        (regex = t3_config_get(item, "start")) != NULL) {
+      check_regex(context, regex);
+
+      /* An earlier pattern with the same regular expression always wins the tie. */
+      for (earlier = t3_config_get(highlights, NULL); earlier != item;
+           earlier = t3_config_get_next(earlier)) {
+        const char *earlier_regex = t3_config_get_string(t3_config_get(earlier, "regex"));
+        if (earlier_regex == NULL) {
+          earlier_regex = t3_config_get_string(t3_config_get(earlier, "start"));
         }
-        VECTOR_LAST(state_stack).state = highlight->next_state;
-        VECTOR_LAST(state_stack).i = 0;
+        if (earlier_regex != NULL && t3_config_get_string(regex) != NULL &&
+            strcmp(earlier_regex, t3_config_get_string(regex)) == 0) {
+          add_finding(context, T3_HIGHLIGHT_LINT_SHADOWED_PATTERN, regex,
+                      t3_config_get_string(regex));
+          break;
+        }
+      }
+    }
+    if ((regex = t3_config_get(item, "end")) != NULL) {
+      check_regex(context, regex);
+    }
+    if ((regex = t3_config_get(item, "use")) != NULL) {
+      mark_use(context, regex);
+    }
+    lint_highlights(context, t3_config_get(item, "highlight"));
 
-        CURRENT.i++;
-        break;
+    for (on_entry = t3_config_get(t3_config_get(item, "on-entry"), NULL); on_entry != NULL;
+         on_entry = t3_config_get_next(on_entry)) {
+      if ((regex = t3_config_get(on_entry, "end")) != NULL) {
+        check_regex(context, regex);
+      }
+      if ((regex = t3_config_get(on_entry, "use")) != NULL) {
+        mark_use(context, regex);
       }
+      lint_highlights(context, t3_config_get(on_entry, "highlight"));
     }
   }
-  VECTOR_FREE(state_stack);
-  return t3_true;
+
+  if (count > LINT_MANY_PATTERNS) {
+    char count_str[32];
+    sprintf(count_str, "%d", count);
+    add_finding(context, T3_HIGHLIGHT_LINT_MANY_PATTERNS, highlights, count_str);
+  }
+}
+
+static int lint_map_style(void *data, const char *style) {
+  (void)data;
+  (void)style;
+  return 0;
+}
+
+t3_highlight_lint_t *t3_highlight_lint(t3_config_t *syntax, int flags,
+                                       t3_highlight_error_t *error) {
+  lint_context_t context;
+  t3_highlight_t *highlight;
+  const t3_config_t *define, *definition;
+  t3_bool changed;
+  size_t i, j;
+
+  VECTOR_INIT(context.findings);
+  VECTOR_INIT(context.defines);
+  context.out_of_memory = t3_false;
+  context.mark_reachable = t3_true;
+
+  for (define = t3_config_get(t3_config_get(syntax, "define"), NULL); define != NULL;
+       define = t3_config_get_next(define)) {
+    for (definition = t3_config_get(define, NULL); definition != NULL;
+         definition = t3_config_get_next(definition)) {
+      if (t3_config_get_type(definition) != T3_CONFIG_SECTION) {
+        continue;
+      }
+      /* As in t3_highlight_new, the first definition with a name is the one used. Later
+         ones, for example from a file that is included more than once, are ignored. */
+      for (j = 0; j < context.defines.used &&
+                  strcmp(context.defines.data[j].name, t3_config_get_name(definition)) != 0;
+           j++) {
+      }
+      if (j < context.defines.used) {
+        continue;
+      }
+      if (!VECTOR_RESERVE(context.defines)) {
+        goto return_error;
+      }
+      VECTOR_LAST(context.defines).name = t3_config_get_name(definition);
+      VECTOR_LAST(context.defines).definition = definition;
+      VECTOR_LAST(context.defines).reachable = t3_false;
+      VECTOR_LAST(context.defines).checked = t3_false;
+    }
+  }
+
+  /* The configuration is checked before it is validated by t3_highlight_new below, because
+     t3_highlight_new takes some of the strings out of it. Check everything reachable from the
+     main highlight list, ... */
+  lint_highlights(&context, t3_config_get(syntax, "highlight"));
+  do {
+    changed = t3_false;
+    for (i = 0; i < context.defines.used; i++) {
+      if (context.defines.data[i].reachable && !context.defines.data[i].checked) {
+        context.defines.data[i].checked = t3_true;
+        lint_highlights(&context, t3_config_get(context.defines.data[i].definition, "highlight"));
+        changed = t3_true;
+      }
+    }
+  } while (changed);
+
+  /* ... and then the definitions which are not reachable. */
+  context.mark_reachable = t3_false;
+  for (i = 0; i < context.defines.used; i++) {
+    if (!context.defines.data[i].checked) {
+      add_finding(&context, T3_HIGHLIGHT_LINT_UNUSED_DEFINE, context.defines.data[i].definition,
+                  context.defines.data[i].name);
+      lint_highlights(&context, t3_config_get(context.defines.data[i].definition, "highlight"));
+    }
+  }
+
+  if (context.out_of_memory || !VECTOR_RESERVE(context.findings)) {
+    goto return_error;
+  }
+  VECTOR_LAST(context.findings).type = T3_HIGHLIGHT_LINT_END;
+  VECTOR_LAST(context.findings).line_number = 0;
+  VECTOR_LAST(context.findings).file_name = NULL;
+  VECTOR_LAST(context.findings).extra = NULL;
+  VECTOR_FREE(context.defines);
+
+  /* Let t3_highlight_new do all the validation. */
+  if ((highlight = t3_highlight_new(syntax, lint_map_style, NULL, flags, error)) == NULL) {
+    t3_highlight_free_lint(context.findings.data);
+    return NULL;
+  }
+  t3_highlight_free(highlight);
+  return context.findings.data;
 
 return_error:
-  VECTOR_FREE(state_stack);
-  return t3_false;
+  _t3_highlight_set_error_simple(error, T3_ERR_OUT_OF_MEMORY, flags);
+  for (i = 0; i < context.findings.used; i++) {
+    free(context.findings.data[i].file_name);
+    free(context.findings.data[i].extra);
+  }
+  VECTOR_FREE(context.findings);
+  VECTOR_FREE(context.defines);
+  return NULL;
+}
+
+void t3_highlight_free_lint(t3_highlight_lint_t *list) {
+  int i;
+
+  if (list == NULL) {
+    return;
+  }
+
+  for (i = 0; list[i].type != T3_HIGHLIGHT_LINT_END; i++) {
+    free(list[i].file_name);
+    free(list[i].extra);
+  }
+  free(list);
 }
@@ -0,0 +1,193 @@
+/* Copyright (C) 2026 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "highlight.h"
+#include "internal.h"
+
+/* The number of bytes by which the part of a line passed to the matcher grows, when the
+   slice may run out in the middle of a line. */
+#define RUN_WINDOW 4096
+
+struct t3_highlight_cursor_t {
+  t3_highlight_match_t *match;
+  const t3_highlight_cursor_callbacks_t *callbacks;
+  void *data;
+  size_t line;
+  /* The part of the current line passed to the matcher by the last call, and whether the
+     matcher asked for more data. */
+  size_t window;
+  t3_bool more;
+  volatile sig_atomic_t cancelled;
+};
+
+t3_highlight_cursor_t *t3_highlight_new_cursor(t3_highlight_match_t *match,
+                                               const t3_highlight_cursor_callbacks_t *callbacks,
+                                               void *data) {
+  t3_highlight_cursor_t *result = malloc(sizeof(t3_highlight_cursor_t));
+  if (result == NULL) {
+    return NULL;
+  }
+
+  result->match = match;
+  result->callbacks = callbacks;
+  result->data = data;
+  /* The cursor can always provide the rest of the line, so the result never depends on
+     where a slice ended. */
+  match->chunk_wait = t3_true;
+  t3_highlight_cursor_seek(result, 0, 0);
+  return result;
+}
+
+void t3_highlight_free_cursor(t3_highlight_cursor_t *cursor) {
+  if (cursor == NULL) {
+    return;
+  }
+  cursor->match->chunk_wait = t3_false;
+  free(cursor);
+}
+
+void t3_highlight_cursor_seek(t3_highlight_cursor_t *cursor, size_t line, int state) {
+  t3_highlight_reset(cursor->match, state);
+  cursor->line = line;
+  cursor->window = 0;
+  cursor->more = t3_false;
+  cursor->cancelled = 0;
+}
+
+/** Check whether the work done so far uses up @p slice. */
+static t3_bool slice_used(const t3_highlight_slice_t *slice, size_t bytes, size_t sections,
+                          const struct timespec *start) {
+  struct timespec now;
+
+  if (slice == NULL) {
+    return t3_false;
+  }
+  if ((slice->max_bytes != 0 && bytes >= slice->max_bytes) ||
+      (slice->max_sections != 0 && sections >= slice->max_sections)) {
+    return t3_true;
+  }
+  if (slice->max_nsec == 0) {
+    return t3_false;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned long long)(now.tv_sec - start->tv_sec) * 1000000000 + now.tv_nsec -
+             start->tv_nsec >=
+         slice->max_nsec;
+}
+
+/** Report a section, if it is not empty. Returns the number of sections reported. */
+static size_t report(t3_highlight_cursor_t *cursor, size_t start, size_t end, int attribute) {
+  if (start == end) {
+    return 0;
+  }
+  cursor->callbacks->section(cursor->data, cursor->line, start, end, attribute);
+  return 1;
+}
+
+/** Report the end of the current line, and move to the next line. */
+static void finish_line(t3_highlight_cursor_t *cursor) {
+  int state = t3_highlight_next_line(cursor->match);
+  if (cursor->callbacks->end_line != NULL) {
+    cursor->callbacks->end_line(cursor->data, cursor->line, state);
+  }
+  cursor->line++;
+  cursor->window = 0;
+  cursor->more = t3_false;
+}
+
+int t3_highlight_cursor_run(t3_highlight_cursor_t *cursor, const t3_highlight_slice_t *slice) {
+  t3_highlight_match_t *match = cursor->match;
+  size_t bytes = 0, sections = 0, step = SIZE_MAX, size = 0;
+  const char *line = NULL;
+  struct timespec start;
+  t3_bool progress = t3_false;
+
+  /* Only pass part of the line to the matcher if the slice may run out in the middle of it. */
+  if (slice != NULL && slice->max_nsec != 0) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    step = RUN_WINDOW;
+  }
+
+  for (;;) {
+    size_t window;
+    int result;
+
+    if (cursor->cancelled) {
+      return T3_HIGHLIGHT_RUN_CANCELLED;
+    }
+    if (progress && slice_used(slice, bytes, sections, &start)) {
+      return T3_HIGHLIGHT_RUN_PAUSED;
+    }
+    if (line == NULL &&
+        (line = cursor->callbacks->get_line(cursor->data, cursor->line, &size)) == NULL) {
+      return T3_HIGHLIGHT_RUN_DONE;
+    }
+    /* Check the whole line at once, such that nothing is reported for an invalid line. */
+    if ((match->highlight->flags & (T3_HIGHLIGHT_UTF8 | T3_HIGHLIGHT_UTF8_NOCHECK)) ==
+            T3_HIGHLIGHT_UTF8 &&
+        match->utf8_checked < size) {
+      if (!t3_highlight_utf8check(line, size)) {
+        /* Like t3_highlight_match, continue in the initial state after an invalid line. */
+        t3_highlight_reset(match, 0);
+        finish_line(cursor);
+        return T3_HIGHLIGHT_RUN_ERROR;
+      }
+      match->utf8_checked = size;
+    }
+
+    /* Only pass more of the line if the matcher asked for it, or if the previous match ended
+       at the end of the part passed. */
+    window = cursor->window;
+    if (cursor->more || window <= match->end) {
+      size_t window_step = step;
+
+      if (slice != NULL && slice->max_bytes != 0) {
+        size_t bytes_left = slice->max_bytes - bytes;
+        if (bytes_left < window_step) {
+          window_step = bytes_left < RUN_WINDOW ? bytes_left : RUN_WINDOW;
+        }
+      }
+      if (window < match->end) {
+        window = match->end;
+      }
+      window = size - window > window_step ? window + window_step : size;
+    }
+
+    result = t3_highlight_match_chunk(match, line, window, 0, window == size);
+    cursor->window = window;
+    cursor->more = result == T3_HIGHLIGHT_CHUNK_MORE;
+    progress = t3_true;
+
+    sections += report(cursor, match->start, match->match_start, match->begin_attribute);
+    sections += report(cursor, match->match_start, match->end, match->match_attribute);
+    bytes += match->end - match->start;
+
+    if (result == T3_HIGHLIGHT_CHUNK_END) {
+      finish_line(cursor);
+      line = NULL;
+    }
+  }
+}
+
+void t3_highlight_cursor_cancel(t3_highlight_cursor_t *cursor) { cursor->cancelled = 1; }
+
+size_t t3_highlight_cursor_get_line(const t3_highlight_cursor_t *cursor) { return cursor->line; }
+
+size_t t3_highlight_cursor_get_pos(const t3_highlight_cursor_t *cursor) {
+  return cursor->match->end;
+}
@@ -0,0 +1,37 @@
+#!/bin/sh
+# Copyright (C) 2026 G.P. Halkes
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 3, as
+# published by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Generate the builtin_data.h header, which contains the files from the data
+# directory such that they can be built into the library.
+# Usage: gen_builtin_data.sh <data directory> <file>...
+
+DIR="$1"
+shift
+
+i=0
+for FILE in "$@" ; do
+	echo "static const unsigned char builtin_data_$i[] = {"
+	od -An -v -tx1 "$DIR/$FILE" | sed -e 's/ *\([0-9a-f][0-9a-f]\)/0x\1,/g'
+	echo "};"
+	i=`expr $i + 1`
+done
+
+echo "static const builtin_file_t builtin_files[] = {"
+i=0
+for FILE in "$@" ; do
+	echo "  {\"$FILE\", (const char *)builtin_data_$i, sizeof(builtin_data_$i)},"
+	i=`expr $i + 1`
+done
+echo "  {NULL, NULL, 0}"
+echo "};"
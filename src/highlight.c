@@ -31,6 +31,9 @@
 #define _(x) (x)
 #endif
 
+/* The look-back distance for t3_highlight_sync if the sync section does not specify one. */
+#define DEFAULT_SYNC_MAX_LINES 1000
+
 static const state_t null_state = {{NULL, 0, 0}, 0};
 
 static const char syntax_schema[] = {
@@ -44,31 +47,118 @@ static const char syntax_v3_schema[] = {
 static t3_bool init_state(highlight_context_t *context, const t3_config_t *highlights,
                           pattern_idx_t idx);
 static void free_state(state_t *state);
+static void free_sources(t3_highlight_t *highlight);
+static void free_sync_patterns(t3_highlight_t *highlight);
+static t3_bool init_sync(highlight_context_t *context, const t3_config_t *sync);
+static void compact_highlight(t3_highlight_t *highlight);
+static uint32_t get_max_lookbehind(const t3_highlight_t *highlight);
 
-static int do_map_style(highlight_context_t *context, const char *style) {
-  size_t style_at_scope_len;
-  char *style_at_scope;
-  int style_at_scope_result;
+static unsigned int hash_style(const char *style, const char *scope) {
+  unsigned int hash = 5381;
 
-  if ((context->flags & T3_HIGHLIGHT_USE_SCOPE) && context->scope != NULL) {
+  for (; *style != 0; style++) {
+    hash = hash * 33 + (unsigned char)*style;
+  }
+  if (scope != NULL) {
+    hash = hash * 33 + '@';
+    for (; *scope != 0; scope++) {
+      hash = hash * 33 + (unsigned char)*scope;
+    }
+  }
+  return hash;
+}
+
+static unsigned long hash_text(unsigned long hash, const char *text) {
+  do {
+    hash = hash * 33 + (unsigned char)*text;
+  } while (*text++ != 0);
+  return hash;
+}
+
+/** Compute a hash of the names and values in @p config and the items following it, which
+    include the text of all regular expressions and keywords. */
+static unsigned long hash_syntax(const t3_config_t *config, unsigned long hash) {
+  for (; config != NULL; config = t3_config_get_next(config)) {
+    t3_config_type_t type = t3_config_get_type(config);
+
+    hash = hash * 33 + (unsigned long)type;
+    if (t3_config_get_name(config) != NULL) {
+      hash = hash_text(hash, t3_config_get_name(config));
+    }
+    switch (type) {
+      case T3_CONFIG_BOOL:
+        hash = hash * 33 + (unsigned long)t3_config_get_bool(config);
+        break;
+      case T3_CONFIG_INT:
+        hash = hash * 33 + (unsigned long)t3_config_get_int(config);
+        break;
+      case T3_CONFIG_STRING:
+        hash = hash_text(hash, t3_config_get_string(config));
+        break;
+      case T3_CONFIG_LIST:
+      case T3_CONFIG_SECTION:
+      case T3_CONFIG_PLIST:
+        hash = hash_syntax(t3_config_get(config, NULL), hash) * 33 + '}';
+        break;
+      default:
+        break;
+    }
+  }
+  return hash;
+}
+
+/** Call the map_style callback, or retrieve the result of an earlier call for the same
+    @p style and @p scope. */
+static int lookup_style(highlight_context_t *context, const char *style, const char *scope) {
+  unsigned int hash = hash_style(style, scope);
+  int result;
+  size_t i;
+
+  for (i = 0; i < context->style_map.used; i++) {
+    style_mapping_t *mapping = &context->style_map.data[i];
+    if (mapping->hash == hash && strcmp(mapping->style, style) == 0 &&
+        (mapping->scope == scope ||
+         (mapping->scope != NULL && scope != NULL && strcmp(mapping->scope, scope) == 0))) {
+      return mapping->attribute_idx;
+    }
+  }
+
+  if (scope != NULL) {
     size_t style_len = strlen(style);
-    size_t scope_len = strlen(context->scope);
-    style_at_scope_len = style_len + 1 + scope_len + 1;
-    style_at_scope = malloc(style_at_scope_len);
-    if (style_at_scope != NULL) {
-      memcpy(style_at_scope, style, style_len);
-      memcpy(style_at_scope + style_len, "@", 1);
-      memcpy(style_at_scope + style_len + 1, context->scope, scope_len);
-      style_at_scope[style_at_scope_len - 1] = 0;
-
-      style_at_scope_result = context->map_style(context->map_style_data, style_at_scope);
-      free(style_at_scope);
-      if (style_at_scope_result != 0) {
-        return style_at_scope_result;
-      }
+    size_t scope_len = strlen(scope);
+    size_t style_at_scope_len = style_len + 1 + scope_len + 1;
+    char *style_at_scope = malloc(style_at_scope_len);
+    if (style_at_scope == NULL) {
+      return lookup_style(context, style, NULL);
     }
+    memcpy(style_at_scope, style, style_len);
+    memcpy(style_at_scope + style_len, "@", 1);
+    memcpy(style_at_scope + style_len + 1, scope, scope_len);
+    style_at_scope[style_at_scope_len - 1] = 0;
+
+    result = context->map_style(context->map_style_data, style_at_scope);
+    free(style_at_scope);
+    if (result == 0) {
+      result = lookup_style(context, style, NULL);
+    }
+  } else {
+    result = context->map_style(context->map_style_data, style);
+  }
+
+  /* Failing to cache the result is not an error, it only means the callback will be called
+     again for the next occurence. */
+  if (VECTOR_RESERVE(context->style_map)) {
+    VECTOR_LAST(context->style_map).style = style;
+    VECTOR_LAST(context->style_map).scope = scope;
+    VECTOR_LAST(context->style_map).hash = hash;
+    VECTOR_LAST(context->style_map).attribute_idx = result;
   }
-  return context->map_style(context->map_style_data, style);
+  return result;
+}
+
+static int do_map_style(highlight_context_t *context, const char *style) {
+  return lookup_style(context, style,
+                      (context->flags & T3_HIGHLIGHT_USE_SCOPE) ? context->scope : NULL);
 }
 
 t3_highlight_t *t3_highlight_new(t3_config_t *syntax, int (*map_style)(void *, const char *),
@@ -141,6 +231,14 @@ t3_highlight_t *t3_highlight_new(t3_config_t *syntax, int (*map_style)(void *, c
     goto return_error;
   }
   VECTOR_INIT(result->states);
+  VECTOR_INIT(result->sources);
+  VECTOR_INIT(result->file_names);
+  VECTOR_INIT(result->sync_patterns);
+  result->sync_max_lines = 0;
+  result->line_end_states = 0;
+  result->line_end = NULL;
+  /* Compiling the patterns takes the strings out of the syntax, so hash it first. */
+  result->syntax_hash = hash_syntax(t3_config_get(syntax, NULL), 5381) & 0xffffffffUL;
 
   if (!VECTOR_RESERVE(result->states)) {
     _t3_highlight_set_error_simple(error, T3_ERR_OUT_OF_MEMORY, flags);
@@ -159,24 +257,31 @@ t3_highlight_t *t3_highlight_new(t3_config_t *syntax, int (*map_style)(void *, c
   context.scope = NULL;
 
   VECTOR_INIT(context.use_map);
+  VECTOR_INIT(context.style_map);
+  VECTOR_INIT(context.state_names);
   if (!init_state(&context, highlights, 0)) {
-    free(context.use_map.data);
+    VECTOR_FREE(context.use_map);
+    VECTOR_FREE(context.style_map);
+    VECTOR_FREE(context.state_names);
     goto return_error;
   }
-  free(context.use_map.data);
-
-  if (!_t3_check_use_cycle(&context)) {
-    goto return_error;
-  }
-
-  /* If we allow empty start patterns, we need to analyze whether they don't result
-     in infinite loops. */
-  if ((flags & T3_HIGHLIGHT_ALLOW_EMPTY_START) && !_t3_check_empty_start_cycle(&context)) {
+  VECTOR_FREE(context.use_map);
+  VECTOR_FREE(context.style_map);
+
+  /* Check for use cycles and, if we allow empty start patterns, whether they don't result
+     in infinite loops. The check for use cycles must be done before init_sync and
+     _t3_analyse_line_ends, which follow the use links. */
+  if (!_t3_check_cycles(&context) || !init_sync(&context, t3_config_get(syntax, "sync")) ||
+      !_t3_analyse_line_ends(&context)) {
+    VECTOR_FREE(context.state_names);
     goto return_error;
   }
+  VECTOR_FREE(context.state_names);
 
   result->flags = flags;
   result->lang_file = NULL;
+  result->max_lookbehind = get_max_lookbehind(result);
+  compact_highlight(result);
   return result;
 
 return_error:
@@ -184,6 +289,9 @@ return_error:
   if (result != NULL) {
     VECTOR_ITERATE(result->states, free_state);
     free(result->states.data);
+    free_sync_patterns(result);
+    free_sources(result);
+    free(result->line_end);
     free(result);
   }
   return NULL;
@@ -212,6 +320,46 @@ t3_bool _t3_compile_highlight(const char *highlight, pcre2_code_8 **regex,
   return t3_true;
 }
 
+/** Record the location of @p node as the source of @p pattern. */
+static t3_bool add_source(highlight_context_t *context, pattern_t *pattern,
+                          const t3_config_t *node) {
+  t3_highlight_t *highlight = context->highlight;
+  const char *file_name = t3_config_get_file_name(node);
+  size_t i;
+
+  if (!VECTOR_RESERVE(highlight->sources)) {
+    _t3_highlight_set_error_simple(context->error, T3_ERR_OUT_OF_MEMORY, context->flags);
+    return t3_false;
+  }
+  pattern->source_idx = highlight->sources.used - 1;
+  VECTOR_LAST(highlight->sources).line_number = t3_config_get_line_number(node);
+  VECTOR_LAST(highlight->sources).file_name = NULL;
+
+  if (file_name == NULL) {
+    return t3_true;
+  }
+
+  /* Most patterns come from the same few files, so only store each name once. */
+  for (i = highlight->file_names.used; i > 0; i--) {
+    if (strcmp(highlight->file_names.data[i - 1], file_name) == 0) {
+      VECTOR_LAST(highlight->sources).file_name = highlight->file_names.data[i - 1];
+      return t3_true;
+    }
+  }
+
+  if (!VECTOR_RESERVE(highlight->file_names)) {
+    _t3_highlight_set_error_simple(context->error, T3_ERR_OUT_OF_MEMORY, context->flags);
+    return t3_false;
+  }
+  if ((VECTOR_LAST(highlight->file_names) = _t3_highlight_strdup(file_name)) == NULL) {
+    highlight->file_names.used--;
+    _t3_highlight_set_error_simple(context->error, T3_ERR_OUT_OF_MEMORY, context->flags);
+    return t3_false;
+  }
+  VECTOR_LAST(highlight->sources).file_name = VECTOR_LAST(highlight->file_names);
+  return t3_true;
+}
+
 static t3_bool add_delim_highlight(highlight_context_t *context, t3_config_t *regex,
                                    pattern_idx_t next_state, pattern_t *pattern) {
   pattern_t new_pattern;
@@ -260,6 +408,10 @@ static t3_bool add_delim_highlight(highlight_context_t *context, t3_config_t *re
   }
 
   new_pattern.attribute_idx = pattern->attribute_idx;
+  if (!add_source(context, &new_pattern, regex)) {
+    pcre2_code_free_8(new_pattern.regex);
+    goto return_error;
+  }
   if (!VECTOR_RESERVE(*patterns)) {
     _t3_highlight_set_error_simple(context->error, T3_ERR_OUT_OF_MEMORY, context->flags);
     goto return_error;
@@ -305,6 +457,7 @@ static t3_bool set_extra(highlight_context_t *context, pattern_t *pattern,
   pattern->extra->dynamic_pattern = NULL;
   pattern->extra->on_entry = NULL;
   pattern->extra->on_entry_cnt = 0;
+  pattern->extra->keywords = NULL;
 
   if (on_entry != NULL) {
     int i;
@@ -336,6 +489,21 @@ return_error:
   return t3_false;
 }
 
+/** Set up the @c extra member of the ::pattern_t for a keywords list. */
+static t3_bool set_keywords(highlight_context_t *context, pattern_t *pattern,
+                            const t3_config_t *highlights) {
+  if ((pattern->extra = malloc(sizeof(pattern_extra_t))) == NULL) {
+    _t3_highlight_set_error_simple(context->error, T3_ERR_OUT_OF_MEMORY, context->flags);
+    return t3_false;
+  }
+  pattern->extra->dynamic_name = NULL;
+  pattern->extra->dynamic_pattern = NULL;
+  pattern->extra->on_entry = NULL;
+  pattern->extra->on_entry_cnt = 0;
+  pattern->extra->keywords = _t3_new_keywords(highlights, context->flags, context->error);
+  return pattern->extra->keywords != NULL;
+}
+
 /** Fill the @c on_entry list. */
 static t3_bool set_on_entry(highlight_context_t *context, pattern_t *pattern,
                             const t3_config_t *highlights) {
@@ -472,7 +640,7 @@ return_error:
 
 static t3_bool init_state(highlight_context_t *context, const t3_config_t *highlights,
                           pattern_idx_t idx) {
-  t3_config_t *regex, *style, *use;
+  t3_config_t *regex, *style, *use, *name;
   pattern_t pattern;
   int style_attr_idx;
 
@@ -486,7 +654,16 @@ static t3_bool init_state(highlight_context_t *context, const t3_config_t *highl
     pattern.extra = NULL;
     if ((regex = t3_config_get(highlights, "regex")) != NULL) {
       if (!_t3_compile_highlight(t3_config_get_string(regex), &pattern.regex, regex, context->flags,
-                                 context->error)) {
+                                 context->error) ||
+          !add_source(context, &pattern, regex)) {
+        goto return_error;
+      }
+
+      pattern.attribute_idx = style_attr_idx;
+      pattern.next_state = NO_CHANGE - t3_config_get_int(t3_config_get(highlights, "exit"));
+    } else if ((regex = t3_config_get(highlights, "keywords")) != NULL) {
+      /* regex = NULL (set above) and extra->keywords != NULL signifies a keywords list. */
+      if (!set_keywords(context, &pattern, highlights) || !add_source(context, &pattern, regex)) {
         goto return_error;
       }
 
@@ -500,7 +677,8 @@ static t3_bool init_state(highlight_context_t *context, const t3_config_t *highl
                                   : do_map_style(context, t3_config_get_string(style));
 
       if (!_t3_compile_highlight(t3_config_get_string(regex), &pattern.regex, regex, context->flags,
-                                 context->error)) {
+                                 context->error) ||
+          !add_source(context, &pattern, regex)) {
         goto return_error;
       }
 
@@ -517,6 +695,15 @@ static t3_bool init_state(highlight_context_t *context, const t3_config_t *highl
       VECTOR_LAST(context->highlight->states) = null_state;
       VECTOR_LAST(context->highlight->states).attribute_idx = style_attr_idx;
 
+      if ((name = t3_config_get(highlights, "name")) != NULL) {
+        if (!VECTOR_RESERVE(context->state_names)) {
+          _t3_highlight_set_error_simple(context->error, T3_ERR_OUT_OF_MEMORY, context->flags);
+          goto return_error;
+        }
+        VECTOR_LAST(context->state_names).name = t3_config_get_string(name);
+        VECTOR_LAST(context->state_names).state = pattern.next_state;
+      }
+
       /* Add sub-highlights to the new state, if they are specified. */
       if ((sub_highlights = t3_config_get(highlights, "highlight")) != NULL) {
         if (!init_state(context, sub_highlights, pattern.next_state)) {
@@ -552,7 +739,7 @@ static t3_bool init_state(highlight_context_t *context, const t3_config_t *highl
       }
     } else if ((use = t3_config_get(highlights, "use")) != NULL) {
       /* regex = NULL (set above) signifies that this is a link to another state. */
-      if (!map_use(context, use, &pattern.next_state)) {
+      if (!map_use(context, use, &pattern.next_state) || !add_source(context, &pattern, use)) {
         goto return_error;
       }
     } else {
@@ -578,12 +765,216 @@ return_error:
       }
       free(pattern.extra->on_entry);
     }
+    free(pattern.extra->keywords);
     free(pattern.extra);
   }
   pcre2_code_free_8(pattern.regex);
   return t3_false;
 }
 
+/** Check whether a start pattern in state @p idx, or in a state it uses, switches to
+    @p state. */
+static t3_bool enters_state(const t3_highlight_t *highlight, pattern_idx_t idx,
+                            pattern_idx_t state) {
+  const patterns_t *patterns = &highlight->states.data[idx].patterns;
+  size_t i;
+
+  for (i = 0; i < patterns->used; i++) {
+    const pattern_t *pattern = &patterns->data[i];
+    if (pattern->regex == NULL && pattern->extra == NULL) {
+      /* Links to other states are not cyclic, as checked by _t3_check_cycles. */
+      if (enters_state(highlight, pattern->next_state, state)) {
+        return t3_true;
+      }
+    } else if (pattern->regex != NULL && pattern->next_state == state) {
+      return t3_true;
+    }
+  }
+  return t3_false;
+}
+
+/** Find the state for the name given in a sync pattern. Only states that are entered from
+    the outermost state are allowed, as the states around other states are not known. */
+static t3_bool map_sync_state(highlight_context_t *context, const t3_config_t *name,
+                              pattern_idx_t *state) {
+  const char *name_str = t3_config_get_string(name);
+  size_t i;
+
+  for (i = 0; i < context->state_names.used; i++) {
+    if (strcmp(name_str, context->state_names.data[i].name) == 0 &&
+        enters_state(context->highlight, 0, context->state_names.data[i].state)) {
+      *state = context->state_names.data[i].state;
+      return t3_true;
+    }
+  }
+  _t3_highlight_set_error(context->error, T3_ERR_UNDEFINED_STATE, t3_config_get_line_number(name),
+                          t3_config_get_file_name(name), name_str, context->flags);
+  return t3_false;
+}
+
+/** Compile the patterns from the sync section. */
+static t3_bool init_sync(highlight_context_t *context, const t3_config_t *sync) {
+  t3_highlight_t *highlight = context->highlight;
+  t3_config_t *patterns, *regex, *name;
+  sync_pattern_t sync_pattern;
+
+  if (sync == NULL) {
+    return t3_true;
+  }
+  highlight->sync_max_lines = t3_config_get(sync, "max-lines") == NULL
+                                  ? DEFAULT_SYNC_MAX_LINES
+                                  : t3_config_get_int(t3_config_get(sync, "max-lines"));
+
+  for (patterns = t3_config_get(t3_config_get(sync, "pattern"), NULL); patterns != NULL;
+       patterns = t3_config_get_next(patterns)) {
+    sync_pattern.state = 0;
+    if ((name = t3_config_get(patterns, "state")) != NULL &&
+        !map_sync_state(context, name, &sync_pattern.state)) {
+      return t3_false;
+    }
+    regex = t3_config_get(patterns, "regex");
+    if (!_t3_compile_highlight(t3_config_get_string(regex), &sync_pattern.regex, regex,
+                               context->flags, context->error)) {
+      return t3_false;
+    }
+    if (!VECTOR_RESERVE(highlight->sync_patterns)) {
+      pcre2_code_free_8(sync_pattern.regex);
+      _t3_highlight_set_error_simple(context->error, T3_ERR_OUT_OF_MEMORY, context->flags);
+      return t3_false;
+    }
+    VECTOR_LAST(highlight->sync_patterns) = sync_pattern;
+  }
+  return t3_true;
+}
+
+static size_t align_size(size_t size) {
+  return (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+}
+
+static size_t string_size(const char *str) { return str == NULL ? 0 : strlen(str) + 1; }
+
+static char *copy_string(char **arena_ptr, char *str) {
+  char *result;
+  size_t size;
+
+  if (str == NULL) {
+    return NULL;
+  }
+  size = strlen(str) + 1;
+  result = *arena_ptr;
+  memcpy(result, str, size);
+  *arena_ptr += size;
+  free(str);
+  return result;
+}
+
+/** Determine how far any regular expression can look behind its start position, in characters.
+    The result is at least one, because keywords lists check the character before the start. */
+static uint32_t get_max_lookbehind(const t3_highlight_t *highlight) {
+  uint32_t result = 1, lookbehind;
+  size_t i, j;
+
+  for (i = 0; i < highlight->states.used; i++) {
+    const patterns_t *patterns = &highlight->states.data[i].patterns;
+    for (j = 0; j < patterns->used; j++) {
+      if (patterns->data[j].regex != NULL &&
+          pcre2_pattern_info_8(patterns->data[j].regex, PCRE2_INFO_MAXLOOKBEHIND, &lookbehind) ==
+              0 &&
+          lookbehind > result) {
+        result = lookbehind;
+      }
+    }
+  }
+  return result;
+}
+
+/** Move all states, patterns and their extra data into a single right-sized allocation.
+
+    During construction the states and patterns are stored in growing vectors, and the extra
+    data for each pattern is allocated separately. Once the highlight is complete, it is no
+    longer modified, so we can lay out everything contiguously. This removes the slack from
+    the vectors and keeps the data used by the matcher close together. If the allocation
+    fails, the highlight is simply left as is.
+*/
+static void compact_highlight(t3_highlight_t *highlight) {
+  size_t states_size, patterns_size = 0, extras_size = 0, on_entry_size = 0, strings_size = 0;
+  char *arena, *arena_ptr;
+  state_t *states;
+  pattern_t *patterns;
+  pattern_extra_t *extras;
+  on_entry_info_t *on_entry;
+  size_t i, j;
+  int k;
+
+  states_size = align_size(highlight->states.used * sizeof(state_t));
+  for (i = 0; i < highlight->states.used; i++) {
+    patterns_t *state_patterns = &highlight->states.data[i].patterns;
+    patterns_size += state_patterns->used * sizeof(pattern_t);
+    for (j = 0; j < state_patterns->used; j++) {
+      pattern_extra_t *extra = state_patterns->data[j].extra;
+      if (extra == NULL) {
+        continue;
+      }
+      extras_size += sizeof(pattern_extra_t);
+      on_entry_size += extra->on_entry_cnt * sizeof(on_entry_info_t);
+      strings_size += string_size(extra->dynamic_name) + string_size(extra->dynamic_pattern);
+      for (k = 0; k < extra->on_entry_cnt; k++) {
+        strings_size += string_size(extra->on_entry[k].end_pattern);
+      }
+    }
+  }
+  patterns_size = align_size(patterns_size);
+  extras_size = align_size(extras_size);
+  on_entry_size = align_size(on_entry_size);
+
+  if ((arena = malloc(states_size + patterns_size + extras_size + on_entry_size + strings_size)) ==
+      NULL) {
+    return;
+  }
+
+  states = (state_t *)arena;
+  patterns = (pattern_t *)(arena + states_size);
+  extras = (pattern_extra_t *)(arena + states_size + patterns_size);
+  on_entry = (on_entry_info_t *)(arena + states_size + patterns_size + extras_size);
+  arena_ptr = arena + states_size + patterns_size + extras_size + on_entry_size;
+
+  for (i = 0; i < highlight->states.used; i++) {
+    state_t *state = &highlight->states.data[i];
+
+    states[i].attribute_idx = state->attribute_idx;
+    states[i].patterns.data = patterns;
+    states[i].patterns.used = states[i].patterns.allocated = state->patterns.used;
+
+    for (j = 0; j < state->patterns.used; j++) {
+      pattern_extra_t *extra = state->patterns.data[j].extra;
+
+      *patterns = state->patterns.data[j];
+      if (extra != NULL) {
+        extras->dynamic_name = copy_string(&arena_ptr, extra->dynamic_name);
+        extras->dynamic_pattern = copy_string(&arena_ptr, extra->dynamic_pattern);
+        extras->on_entry_cnt = extra->on_entry_cnt;
+        extras->on_entry = extra->on_entry == NULL ? NULL : on_entry;
+        extras->keywords = extra->keywords;
+        for (k = 0; k < extra->on_entry_cnt; k++) {
+          on_entry->state = extra->on_entry[k].state;
+          on_entry->end_pattern = copy_string(&arena_ptr, extra->on_entry[k].end_pattern);
+          on_entry++;
+        }
+        free(extra->on_entry);
+        free(extra);
+        patterns->extra = extras++;
+      }
+      patterns++;
+    }
+    VECTOR_FREE(state->patterns);
+  }
+  VECTOR_FREE(highlight->states);
+
+  highlight->states.data = states;
+  highlight->states.used = highlight->states.allocated = i;
+  highlight->flags |= T3_HIGHLIGHT_COMPACTED;
+}
+
 static void free_highlight(pattern_t *highlight) {
   pcre2_code_free_8(highlight->regex);
   if (highlight->extra != NULL) {
@@ -596,6 +987,7 @@ static void free_highlight(pattern_t *highlight) {
       }
       free(highlight->extra->on_entry);
     }
+    free(highlight->extra->keywords);
     free(highlight->extra);
   }
 }
@@ -605,16 +997,63 @@ static void free_state(state_t *state) {
   VECTOR_FREE(state->patterns);
 }
 
+static void free_sync_patterns(t3_highlight_t *highlight) {
+  size_t i;
+
+  for (i = 0; i < highlight->sync_patterns.used; i++) {
+    pcre2_code_free_8(highlight->sync_patterns.data[i].regex);
+  }
+  VECTOR_FREE(highlight->sync_patterns);
+}
+
+static void free_sources(t3_highlight_t *highlight) {
+  size_t i;
+
+  for (i = 0; i < highlight->file_names.used; i++) {
+    free(highlight->file_names.data[i]);
+  }
+  VECTOR_FREE(highlight->file_names);
+  VECTOR_FREE(highlight->sources);
+}
+
 void t3_highlight_free(t3_highlight_t *highlight) {
   if (highlight == NULL) {
     return;
   }
-  VECTOR_ITERATE(highlight->states, free_state);
+  if (highlight->flags & T3_HIGHLIGHT_COMPACTED) {
+    size_t i, j;
+    /* Only the regular expressions and keyword tables are allocated outside the single
+       block. */
+    for (i = 0; i < highlight->states.used; i++) {
+      for (j = 0; j < highlight->states.data[i].patterns.used; j++) {
+        pattern_t *pattern = &highlight->states.data[i].patterns.data[j];
+        pcre2_code_free_8(pattern->regex);
+        if (pattern->extra != NULL) {
+          free(pattern->extra->keywords);
+        }
+      }
+    }
+  } else {
+    VECTOR_ITERATE(highlight->states, free_state);
+  }
   VECTOR_FREE(highlight->states);
+  free_sync_patterns(highlight);
+  free_sources(highlight);
+  free(highlight->line_end);
   free(highlight->lang_file);
   free(highlight);
 }
 
+t3_bool t3_highlight_get_pattern_source(const t3_highlight_t *highlight, int pattern,
+                                        const char **file_name, int *line_number) {
+  if (pattern < 0 || (size_t)pattern >= highlight->sources.used) {
+    return t3_false;
+  }
+  *file_name = highlight->sources.data[pattern].file_name;
+  *line_number = highlight->sources.data[pattern].line_number;
+  return t3_true;
+}
+
 void _t3_highlight_set_error(t3_highlight_error_t *error, int code, int line_number,
                              const char *file_name, const char *extra, int flags) {
   if (error != NULL) {
@@ -652,6 +1091,27 @@ const char *t3_highlight_strerror(int error) {
       return _("empty start-pattern cycle");
     case T3_ERR_USE_CYCLE:
       return _("use-pattern cycle");
+    case T3_ERR_INVALID_KEYWORD:
+      return _("invalid keyword");
+    case T3_ERR_UNDEFINED_STATE:
+      return _("'state' specifies undefined or nested state");
+  }
+}
+
+const char *t3_highlight_lint_description(int type) {
+  switch (type) {
+    default:
+      return _("unknown finding");
+    case T3_HIGHLIGHT_LINT_NESTED_QUANTIFIER:
+      return _("nested unbounded repetition may cause excessive backtracking");
+    case T3_HIGHLIGHT_LINT_OVERLAPPING_ALTERNATION:
+      return _("repeated overlapping alternatives may cause excessive backtracking");
+    case T3_HIGHLIGHT_LINT_SHADOWED_PATTERN:
+      return _("pattern is shadowed by an identical earlier pattern");
+    case T3_HIGHLIGHT_LINT_UNUSED_DEFINE:
+      return _("definition is not reachable");
+    case T3_HIGHLIGHT_LINT_MANY_PATTERNS:
+      return _("state has many patterns");
   }
 }
 
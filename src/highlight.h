@@ -56,6 +56,11 @@ extern "C" {
 #define T3_ERR_EMPTY_START_CYCLE (-91)
 /** Error code: a cycle of empty start states was detected. */
 #define T3_ERR_USE_CYCLE (-90)
+/** Error code: a 'keywords' list contains an empty word, or a word with non-word characters. */
+#define T3_ERR_INVALID_KEYWORD (-89)
+/** Error code: a 'sync' pattern references a state name that is not defined, or that is not
+    entered from the outermost state. */
+#define T3_ERR_UNDEFINED_STATE (-88)
 /*@}*/
 
 /** @name Flags for ::t3_highlight_load. */
@@ -73,7 +78,11 @@ extern "C" {
     a performance benefit.
 */
 #define T3_HIGHLIGHT_UTF8_NOCHECK (1 << 1)
-/** Use the default include path to lookup the file. */
+/** Use the default include path to lookup the file.
+
+    If the library was built with the highlighting patterns built in, only the user's data
+    directory is searched, and the built-in copy is used if the file is not found there.
+*/
 #define T3_HIGHLIGHT_USE_PATH (1 << 2)
 /** Use verbose error reporting. */
 #define T3_HIGHLIGHT_VERBOSE_ERROR (1 << 3)
@@ -86,6 +95,59 @@ extern "C" {
 #define T3_HIGHLIGHT_USE_SCOPE (1 << 4)
 /*@}*/
 
+/** @name Finding types for ::t3_highlight_lint. */
+/*@{*/
+/** Marks the end of the list returned by ::t3_highlight_lint. */
+#define T3_HIGHLIGHT_LINT_END 0
+/** A repeated group contains a repeated item, which may cause exponential backtracking. */
+#define T3_HIGHLIGHT_LINT_NESTED_QUANTIFIER 1
+/** A repeated group contains alternatives starting with the same character, which may cause
+    exponential backtracking. */
+#define T3_HIGHLIGHT_LINT_OVERLAPPING_ALTERNATION 2
+/** A pattern is equal to an earlier pattern in the same state, and can never be the longest match.
+ */
+#define T3_HIGHLIGHT_LINT_SHADOWED_PATTERN 3
+/** A definition is not reachable from the main highlight list. */
+#define T3_HIGHLIGHT_LINT_UNUSED_DEFINE 4
+/** A state contains many patterns, each of which must be tried at every position. */
+#define T3_HIGHLIGHT_LINT_MANY_PATTERNS 5
+/*@}*/
+
+/** @name Results of ::t3_highlight_match_chunk. */
+/*@{*/
+/** The data is not valid UTF-8. */
+#define T3_HIGHLIGHT_CHUNK_ERROR (-1)
+/** The end of the line was reached. The result only contains a pre-match section. */
+#define T3_HIGHLIGHT_CHUNK_END 0
+/** A match was found. */
+#define T3_HIGHLIGHT_CHUNK_MATCH 1
+/** More data is needed. The result only contains a pre-match section. */
+#define T3_HIGHLIGHT_CHUNK_MORE 2
+/*@}*/
+
+/** @name Results of ::t3_highlight_cursor_run. */
+/*@{*/
+/** A line is not valid UTF-8. No sections are reported for it, and the cursor is left at
+    the start of the next line, in the initial state, as for ::t3_highlight_match. */
+#define T3_HIGHLIGHT_RUN_ERROR (-1)
+/** All lines have been highlighted. */
+#define T3_HIGHLIGHT_RUN_DONE 0
+/** The slice ran out. Highlighting continues where it stopped on the next call. */
+#define T3_HIGHLIGHT_RUN_PAUSED 1
+/** ::t3_highlight_cursor_cancel was called. */
+#define T3_HIGHLIGHT_RUN_CANCELLED 2
+/*@}*/
+
+/** @name Results of ::t3_highlight_sync. */
+/*@{*/
+/** Out of memory. */
+#define T3_HIGHLIGHT_SYNC_ERROR (-1)
+/** No line within the look-back distance is known to start in a particular state. */
+#define T3_HIGHLIGHT_SYNC_GUESS 0
+/** The state at the start of the returned line is known. */
+#define T3_HIGHLIGHT_SYNC_FOUND 1
+/*@}*/
+
 /** @struct t3_highlight_t
     An opaque struct representing a highlighting pattern.
 */
@@ -95,6 +157,21 @@ typedef struct t3_highlight_t t3_highlight_t;
 */
 typedef struct t3_highlight_match_t t3_highlight_match_t;
 
+/** @struct t3_highlight_cursor_t
+    An opaque struct representing a position in a text that is highlighted incrementally.
+*/
+typedef struct t3_highlight_cursor_t t3_highlight_cursor_t;
+
+/** @struct t3_highlight_worker_t
+    An opaque struct representing a thread which highlights a document in the background.
+*/
+typedef struct t3_highlight_worker_t t3_highlight_worker_t;
+
+/** @struct t3_highlight_index_t
+    An opaque struct holding the state at the start of selected lines of a text.
+*/
+typedef struct t3_highlight_index_t t3_highlight_index_t;
+
 /** @struct t3_highlight_lang_t
     A struct representing a display name/language file name tuple.
 */
@@ -119,6 +196,133 @@ typedef struct {
                         Must be Free'd. */
 } t3_highlight_error_t;
 
+/** @struct t3_highlight_stats_t
+    A struct with size information about a ::t3_highlight_t or ::t3_highlight_match_t.
+    Filled in by ::t3_highlight_get_stats and ::t3_highlight_get_match_stats.
+*/
+typedef struct {
+  size_t states;           /**< Number of states in the highlighting pattern. */
+  size_t patterns;         /**< Number of patterns in the highlighting pattern. */
+  size_t dynamic_mappings; /**< Number of dynamic states created by a ::t3_highlight_match_t.
+                                Always 0 for a ::t3_highlight_t. */
+  size_t regex_bytes;      /**< Bytes used by compiled regular expressions. */
+  size_t jit_bytes;        /**< Bytes used by JIT compiled code for the regular expressions. */
+  size_t table_bytes;      /**< Bytes used by the internal tables. */
+  size_t line_end_states;  /**< Number of states other than the initial state that can be active
+                                at the end of a line. See ::t3_highlight_is_line_independent. */
+} t3_highlight_stats_t;
+
+/** @struct t3_highlight_profile_t
+    A struct with profiling counters for a single pattern. Returned by ::t3_highlight_get_profile.
+*/
+typedef struct {
+  const char *file_name;        /**< File name the pattern was defined in, or @c NULL. */
+  int line_number;              /**< Line number the pattern was defined on. */
+  unsigned long attempts;       /**< Number of times the pattern was tried. */
+  unsigned long successes;      /**< Number of times the pattern matched. */
+  unsigned long wins;           /**< Number of times the match was used as the result. */
+  unsigned long long bytes;     /**< Total number of bytes covered by the used matches. */
+  unsigned long long time_nsec; /**< Total time spent trying the pattern, in nanoseconds. */
+} t3_highlight_profile_t;
+
+/** @struct t3_highlight_trace_t
+    A table of callbacks to trace the decisions made by ::t3_highlight_match. Installed
+    using ::t3_highlight_set_trace. Any of the members may be @c NULL.
+
+    All callbacks receive the @c data pointer passed to ::t3_highlight_set_trace as their
+    first argument. States are identified by the same values as returned by
+    ::t3_highlight_get_state, and patterns by their index as used by
+    ::t3_highlight_get_pattern_source and ::t3_highlight_get_profile.
+*/
+typedef struct {
+  /** Called when a state is entered. For nested states, the outer state is entered first. */
+  void (*enter_state)(void *data, int state);
+  /** Called when a state is left. For nested states, the inner state is left first. */
+  void (*leave_state)(void *data, int state);
+  /** Called before a pattern is tried at byte offset @p offset. */
+  void (*try_pattern)(void *data, int pattern, size_t offset);
+  /** Called when the match of a pattern, from @p start up to @p end, is used as the result. */
+  void (*match_pattern)(void *data, int pattern, size_t start, size_t end);
+  /** Called when a new state is created as a child of state @p parent. */
+  void (*create_state)(void *data, int state, int parent);
+} t3_highlight_trace_t;
+
+/** @struct t3_highlight_budget_t
+    Limits on the work done to highlight a single line. Installed using
+    ::t3_highlight_set_budget. For all members, 0 means no limit.
+*/
+typedef struct {
+  /** Match limit for each regular expression match, see pcre2_set_match_limit. */
+  unsigned long match_limit;
+  /** Depth limit for each regular expression match, see pcre2_set_depth_limit. Not used for
+      JIT compiled regular expressions. */
+  unsigned long depth_limit;
+  /** Heap limit in kibibytes for each regular expression match, see pcre2_set_heap_limit.
+      Not used for JIT compiled regular expressions. */
+  unsigned long heap_limit;
+  /** Maximum number of patterns tried for a single line. */
+  unsigned long step_limit;
+  /** Maximum time spent in ::t3_highlight_match for a single line, in microseconds. */
+  unsigned long time_limit_usec;
+} t3_highlight_budget_t;
+
+/** @struct t3_highlight_cursor_callbacks_t
+    Callbacks used by ::t3_highlight_cursor_run to retrieve the text and report the result.
+    Lines are numbered from 0.
+*/
+typedef struct {
+  /** Return line @p line, and store its size in @p size, or return @c NULL if there is no
+      such line. The data must remain valid and unchanged until ::t3_highlight_cursor_run
+      returns, and the line must not change until the cursor has moved past it. */
+  const char *(*get_line)(void *data, size_t line, size_t *size);
+  /** Called for each non-empty section of a line. Consecutive sections may have the same
+      attribute, because sections are split where a slice ends. */
+  void (*section)(void *data, size_t line, size_t start, size_t end, int attribute);
+  /** Called after the last section of a line, with the state at the start of the next line.
+      May be @c NULL. */
+  void (*end_line)(void *data, size_t line, int state);
+} t3_highlight_cursor_callbacks_t;
+
+/** @struct t3_highlight_slice_t
+    The amount of work a single call to ::t3_highlight_cursor_run may do. For all members, 0
+    means no limit.
+*/
+typedef struct {
+  /** Maximum number of bytes of text to highlight. */
+  size_t max_bytes;
+  /** Maximum number of sections to report. */
+  size_t max_sections;
+  /** Maximum time to spend, in nanoseconds. */
+  unsigned long max_nsec;
+} t3_highlight_slice_t;
+
+/** @struct t3_highlight_worker_callbacks_t
+    Callbacks used by a ::t3_highlight_worker_t. All callbacks are called from the worker
+    thread, while the worker is locked (see ::t3_highlight_worker_lock).
+*/
+typedef struct {
+  /** Return line @p line, and store its size in @p size, or return @c NULL if there is no
+      such line. The data must remain valid until the worker is unlocked. */
+  const char *(*get_line)(void *data, size_t line, size_t *size);
+  /** Called for each non-empty section of a line, as for ::t3_highlight_cursor_run. The
+      sections of a line are reported again when the line needs to be highlighted again
+      after an edit. */
+  void (*section)(void *data, size_t line, size_t start, size_t end, int attribute);
+  /** Called when lines @p first up to @p last have been highlighted. Lines which are not
+      reported again after an edit keep the result reported earlier. May be @c NULL. */
+  void (*lines_done)(void *data, size_t first, size_t last);
+} t3_highlight_worker_callbacks_t;
+
+/** @struct t3_highlight_lint_t
+    A struct describing a single finding of ::t3_highlight_lint.
+*/
+typedef struct {
+  int type;        /**< The type of finding, one of the T3_HIGHLIGHT_LINT_* constants. */
+  int line_number; /**< Line number of the item the finding refers to. */
+  char *file_name; /**< File name of the item the finding refers to, or @c NULL. */
+  char *extra;     /**< The regular expression or name the finding refers to, or @c NULL. */
+} t3_highlight_lint_t;
+
 /** List the known languages.
     @return A list of display name/language file name pairs.
 
@@ -143,7 +347,9 @@ T3_HIGHLIGHT_API void t3_highlight_free_list(t3_highlight_lang_t *list);
     and a string describing a style as its second argument. The return value
     must be an integer, which will be used in the result from
     ::t3_highlight_match. Typically any unknown styles should be mapped to the
-    same value as the 'normal' style.
+    same value as the 'normal' style. The result of @p map_style is cached while
+    the highlighting pattern is constructed, so it is called only once for
+    each distinct style name.
 */
 T3_HIGHLIGHT_API t3_highlight_t *t3_highlight_load(const char *name,
                                                    int (*map_style)(void *, const char *),
@@ -207,7 +413,8 @@ T3_HIGHLIGHT_API t3_highlight_t *t3_highlight_load_by_detect(const char *line, s
     Other parameters and return value are equal to ::t3_highlight_load. The
     highlighting pattern are stored in the format of @c libt3config. Any
     configuration which conforms to the schema of a syntax highlighting pattern
-    can be used to create a highlighting pattern.
+    can be used to create a highlighting pattern. Some of the strings are taken
+    out of @p syntax, so it can not be used to create another highlighting pattern.
 */
 T3_HIGHLIGHT_API t3_highlight_t *t3_highlight_new(t3_config_t *syntax,
                                                   int (*map_style)(void *, const char *),
@@ -219,8 +426,52 @@ T3_HIGHLIGHT_API t3_highlight_t *t3_highlight_new(t3_config_t *syntax,
 */
 T3_HIGHLIGHT_API void t3_highlight_free(t3_highlight_t *highlight);
 
+/** Check a highlighting pattern for constructs that may result in slow highlighting.
+    @param syntax The @c t3_config_t to check.
+    @param flags See ::t3_highlight_load.
+    @param error See ::t3_highlight_load.
+    @return A list of findings, or @c NULL on error.
+
+    The configuration is first checked in the same way as ::t3_highlight_new does,
+    and any error that would prevent loading is reported through @p error. The
+    returned list is terminated by an entry with type ::T3_HIGHLIGHT_LINT_END, and
+    must be freed using ::t3_highlight_free_lint. Like ::t3_highlight_new, this takes
+    some of the strings out of @p syntax.
+
+    The checks for regular expressions are heuristic: a finding indicates that
+    the regular expression should be reviewed, not that it is necessarily slow.
+*/
+T3_HIGHLIGHT_API t3_highlight_lint_t *t3_highlight_lint(t3_config_t *syntax, int flags,
+                                                        t3_highlight_error_t *error);
+/** Check a highlighting pattern file for constructs that may result in slow highlighting.
+    @param name The file name to load, as for ::t3_highlight_load.
+    @param flags See ::t3_highlight_load.
+    @param error See ::t3_highlight_load.
+
+    See ::t3_highlight_lint for details. Findings for items in the file itself, rather than
+    in a file it includes, have @p name as their file name.
+*/
+T3_HIGHLIGHT_API t3_highlight_lint_t *t3_highlight_lint_file(const char *name, int flags,
+                                                             t3_highlight_error_t *error);
+/** Free a list returned by ::t3_highlight_lint.
+    It is acceptable to pass a @c NULL pointer.
+*/
+T3_HIGHLIGHT_API void t3_highlight_free_lint(t3_highlight_lint_t *list);
+/** Get a string description for a finding type of ::t3_highlight_lint. */
+T3_HIGHLIGHT_API const char *t3_highlight_lint_description(int type);
+
 /** Get the language file associated with this highlighting pattern. */
 T3_HIGHLIGHT_API const char *t3_highlight_get_langfile(const t3_highlight_t *highlight);
+/** Get the location where a pattern was defined.
+    @param highlight The ::t3_highlight_t the pattern is part of.
+    @param pattern The index of the pattern, as passed to the ::t3_highlight_trace_t callbacks.
+    @param file_name The location to store the file name, which may be @c NULL.
+    @param line_number The location to store the line number.
+    @return ::t3_false if @p pattern is not a valid pattern index.
+*/
+T3_HIGHLIGHT_API t3_bool t3_highlight_get_pattern_source(const t3_highlight_t *highlight,
+                                                         int pattern, const char **file_name,
+                                                         int *line_number);
 
 /** Find the next highlighting match in a subject string.
     @param match The ::t3_highlight_match_t structure to store the result.
@@ -264,6 +515,34 @@ T3_HIGHLIGHT_API const char *t3_highlight_get_langfile(const t3_highlight_t *hig
 */
 T3_HIGHLIGHT_API t3_bool t3_highlight_match(t3_highlight_match_t *match, const char *str,
                                             size_t size);
+/** Match part of a line, for lines which are too long to keep in memory as a whole.
+    @param match The ::t3_highlight_match_t structure to use.
+    @param data The part of the line that is available.
+    @param size The size of @p data in bytes.
+    @param offset The position in the line of the first byte of @p data.
+    @param last Boolean indicating whether @p data contains the end of the line.
+    @return One of ::T3_HIGHLIGHT_CHUNK_ERROR, ::T3_HIGHLIGHT_CHUNK_END,
+        ::T3_HIGHLIGHT_CHUNK_MATCH or ::T3_HIGHLIGHT_CHUNK_MORE.
+
+    This function works like ::t3_highlight_match, except that the line is
+    passed in parts. All positions returned through @p match, such as the
+    result of ::t3_highlight_get_end, are positions in the whole line rather
+    than in @p data. When a match can not be determined without seeing more
+    of the line, ::T3_HIGHLIGHT_CHUNK_MORE is returned. The section from
+    ::t3_highlight_get_start up to ::t3_highlight_get_match_start is final at
+    that point. The next call must then pass the data starting at position
+    ::t3_highlight_get_chunk_keep, followed by more data from the line.
+    Regular expressions which can not be completed within a fixed amount of
+    data are matched against the data available, such that the amount of data
+    that needs to be kept is bounded.
+
+    Calling this function with @p offset @c 0 and @p last set is equivalent to
+    calling ::t3_highlight_match. If @p data is not valid UTF-8,
+    ::T3_HIGHLIGHT_CHUNK_ERROR is returned and @p match is reset in the same way
+    as for ::t3_highlight_match.
+*/
+T3_HIGHLIGHT_API int t3_highlight_match_chunk(t3_highlight_match_t *match, const char *data,
+                                              size_t size, size_t offset, t3_bool last);
 
 /** Allocate and initialize a new ::t3_highlight_match_t structure.
     @param highlight The ::t3_highlight_t structure this ::t3_highlight_match_t
@@ -297,11 +576,321 @@ T3_HIGHLIGHT_API size_t t3_highlight_get_end(t3_highlight_match_t *match);
 T3_HIGHLIGHT_API int t3_highlight_get_begin_attr(t3_highlight_match_t *match);
 /** Get the attribute for the match section of the result. */
 T3_HIGHLIGHT_API int t3_highlight_get_match_attr(t3_highlight_match_t *match);
+/** Get the position from which the data must be passed in the next call to
+    ::t3_highlight_match_chunk, after it returned ::T3_HIGHLIGHT_CHUNK_MORE.
+*/
+T3_HIGHLIGHT_API size_t t3_highlight_get_chunk_keep(t3_highlight_match_t *match);
 /** Get the state represented by @p match. */
 T3_HIGHLIGHT_API int t3_highlight_get_state(t3_highlight_match_t *match);
 /** Set up @p match for highlighting the next line of input. */
 T3_HIGHLIGHT_API int t3_highlight_next_line(t3_highlight_match_t *match);
 
+/** Retrieve size information about a highlighting pattern.
+    @param highlight The ::t3_highlight_t to report on.
+    @param stats The location to store the result.
+
+    The @c regex_bytes and @c jit_bytes members are determined by asking PCRE for
+    the size of each compiled regular expression. The @c table_bytes member includes
+    all other memory allocated for @p highlight by libt3highlight.
+*/
+T3_HIGHLIGHT_API void t3_highlight_get_stats(const t3_highlight_t *highlight,
+                                             t3_highlight_stats_t *stats);
+/** Retrieve size information about a ::t3_highlight_match_t structure.
+    @param match The ::t3_highlight_match_t to report on.
+    @param stats The location to store the result.
+
+    The @c states, @c patterns and @c line_end_states members are taken from the
+    ::t3_highlight_t @p match was created for. All size information covers only the memory
+    owned by @p match, which grows when dynamic states are created during highlighting.
+*/
+T3_HIGHLIGHT_API void t3_highlight_get_match_stats(const t3_highlight_match_t *match,
+                                                   t3_highlight_stats_t *stats);
+
+/** Enable or disable collection of profiling counters for each pattern.
+    @param match The ::t3_highlight_match_t to collect the counters for.
+    @param enable Boolean indicating whether to collect the counters.
+    @return ::t3_false if the memory for the counters could not be allocated.
+
+    Enabling profiling resets all counters to zero. Disabling profiling discards
+    the counters. When profiling is disabled, which is the default, no time is
+    spent on profiling while highlighting.
+*/
+T3_HIGHLIGHT_API t3_bool t3_highlight_set_profile(t3_highlight_match_t *match, t3_bool enable);
+/** Retrieve the profiling counters collected by @p match.
+    @param match The ::t3_highlight_match_t to retrieve the counters for.
+    @param count The location to store the number of entries in the returned array.
+    @return An array with one entry per pattern, or @c NULL if profiling is not enabled.
+
+    The returned array is owned by @p match and remains valid until profiling is
+    disabled or @p match is freed. The strings in the array remain valid as long as
+    the ::t3_highlight_t @p match was created for. Patterns that refer to another
+    definition through a @c use directive are never tried themselves, so they
+    always have zero counts.
+*/
+T3_HIGHLIGHT_API const t3_highlight_profile_t *t3_highlight_get_profile(
+    const t3_highlight_match_t *match, size_t *count);
+/** Install a table of tracing callbacks.
+    @param match The ::t3_highlight_match_t to trace.
+    @param trace The table of callbacks, or @c NULL to remove a previously installed table.
+    @param data Data passed as the first argument to each of the callbacks.
+
+    The table is not copied, and must remain valid while it is installed. When no table
+    is installed, which is the default, the cost of tracing is a single test per tried
+    pattern.
+*/
+T3_HIGHLIGHT_API void t3_highlight_set_trace(t3_highlight_match_t *match,
+                                             const t3_highlight_trace_t *trace, void *data);
+/** Limit the work done to highlight a single line.
+    @param match The ::t3_highlight_match_t to limit.
+    @param budget The limits to use, or @c NULL to remove all limits. The struct is copied.
+    @return ::t3_false if the memory for the limits could not be allocated.
+
+    When the budget for a line runs out, or a regular expression match runs into any
+    of the PCRE2 limits (including the default limits when no budget is set), the
+    rest of the line is returned as a single section with the attribute of the
+    current state, and ::t3_highlight_budget_exceeded returns ::t3_true until the
+    next line. The state is left as it was where highlighting stopped, so the next
+    line is highlighted as if the rest of this line did not match anything.
+*/
+T3_HIGHLIGHT_API t3_bool t3_highlight_set_budget(t3_highlight_match_t *match,
+                                                 const t3_highlight_budget_t *budget);
+/** Check whether highlighting of the current line was cut short.
+    @param match The ::t3_highlight_match_t to check.
+    @return ::t3_true if the budget set with ::t3_highlight_set_budget, or a PCRE2
+        limit, was exceeded since the last call to ::t3_highlight_next_line or
+        ::t3_highlight_reset.
+*/
+T3_HIGHLIGHT_API t3_bool t3_highlight_budget_exceeded(const t3_highlight_match_t *match);
+
+/** Create a cursor to highlight a text in slices, for example from a user interface thread.
+    @param match The ::t3_highlight_match_t used for highlighting. It remains owned by the
+        caller, but must not be used for anything else while the cursor exists, except for
+        installing a budget, profiling or tracing.
+    @param callbacks The callbacks to retrieve the text and report the result. The struct is
+        not copied, and must remain valid while the cursor exists.
+    @param data The pointer passed to the callbacks.
+    @return A new cursor positioned at the start of line 0 in state 0, or @c NULL if out of
+        memory.
+*/
+T3_HIGHLIGHT_API t3_highlight_cursor_t *t3_highlight_new_cursor(
+    t3_highlight_match_t *match, const t3_highlight_cursor_callbacks_t *callbacks, void *data);
+/** Free a ::t3_highlight_cursor_t. It is acceptable to pass a @c NULL pointer. */
+T3_HIGHLIGHT_API void t3_highlight_free_cursor(t3_highlight_cursor_t *cursor);
+/** Move a cursor to the start of a line.
+    @param cursor The ::t3_highlight_cursor_t to move.
+    @param line The line to continue from.
+    @param state The state at the start of @p line, as reported through the @c end_line
+        callback for the previous line, or @c 0 for the first line.
+
+    This also clears a cancellation. It must be used when a line at or after the position of
+    the cursor has changed.
+*/
+T3_HIGHLIGHT_API void t3_highlight_cursor_seek(t3_highlight_cursor_t *cursor, size_t line,
+                                               int state);
+/** Highlight text until the end of the text, or until the slice runs out.
+    @param cursor The ::t3_highlight_cursor_t to continue from.
+    @param slice The amount of work to do, or @c NULL to highlight all remaining lines.
+    @return One of ::T3_HIGHLIGHT_RUN_ERROR, ::T3_HIGHLIGHT_RUN_DONE,
+        ::T3_HIGHLIGHT_RUN_PAUSED or ::T3_HIGHLIGHT_RUN_CANCELLED.
+
+    Highlighting may stop anywhere in a line, also in the middle of what becomes a single
+    match, and resumes there on the next call without highlighting the line again. Each
+    call makes some progress, even if that exceeds the slice. The result is the same as
+    highlighting each line using ::t3_highlight_match.
+*/
+T3_HIGHLIGHT_API int t3_highlight_cursor_run(t3_highlight_cursor_t *cursor,
+                                             const t3_highlight_slice_t *slice);
+/** Stop ::t3_highlight_cursor_run.
+    This may be called from the callbacks or from a signal handler. Until the next call to
+    ::t3_highlight_cursor_seek, ::t3_highlight_cursor_run returns
+    ::T3_HIGHLIGHT_RUN_CANCELLED without doing any work.
+*/
+T3_HIGHLIGHT_API void t3_highlight_cursor_cancel(t3_highlight_cursor_t *cursor);
+/** Get the line at which a cursor will continue. */
+T3_HIGHLIGHT_API size_t t3_highlight_cursor_get_line(const t3_highlight_cursor_t *cursor);
+/** Get the position in the line up to which the sections have been reported. */
+T3_HIGHLIGHT_API size_t t3_highlight_cursor_get_pos(const t3_highlight_cursor_t *cursor);
+
+/** Start a thread to highlight a document in the background.
+    @param highlight The ::t3_highlight_t to use.
+    @param callbacks The callbacks to retrieve the text and report the result. The struct is
+        not copied, and must remain valid while the worker exists.
+    @param data The pointer passed to the callbacks.
+    @return A new worker, or @c NULL if the thread could not be started or if out of memory.
+
+    The worker highlights the document from the start, and keeps the state at the start of
+    each line. After an edit, highlighting restarts at the first changed line, and stops as
+    soon as the state at the start of a line is the same as before the edit. Work up to the
+    end of the visible range (see ::t3_highlight_worker_set_viewport) is reported as soon as
+    it is done. Once it is done, the worker pauses for about a millisecond between slices
+    for the rest of the document, leaving the processor to other threads until the visible
+    range changes or the document is edited.
+
+    Except for ::t3_highlight_free_worker and ::t3_highlight_worker_lock, the functions
+    operating on a worker must be called while the worker is locked. The callbacks run with
+    the worker locked, so they may call these functions as well.
+*/
+T3_HIGHLIGHT_API t3_highlight_worker_t *t3_highlight_new_worker(
+    const t3_highlight_t *highlight, const t3_highlight_worker_callbacks_t *callbacks,
+    void *data);
+/** Stop the thread and free a ::t3_highlight_worker_t.
+    It is acceptable to pass a @c NULL pointer. The worker must not be locked.
+*/
+T3_HIGHLIGHT_API void t3_highlight_free_worker(t3_highlight_worker_t *worker);
+/** Lock a worker, to change the document or call the other functions operating on it.
+    The worker holds the lock while highlighting, but releases it after every slice of
+    about a millisecond, and does not start the next slice while a thread is waiting in this
+    function.
+*/
+T3_HIGHLIGHT_API void t3_highlight_worker_lock(t3_highlight_worker_t *worker);
+/** Unlock a worker, allowing it to continue highlighting. */
+T3_HIGHLIGHT_API void t3_highlight_worker_unlock(t3_highlight_worker_t *worker);
+/** Inform a worker of a change in the document.
+    @param worker The ::t3_highlight_worker_t to inform.
+    @param line The first line that changed.
+    @param removed The number of lines, starting at @p line, that were replaced.
+    @param inserted The number of lines that replaced them.
+
+    For example, a change within a single line is reported with @p removed and @p inserted
+    set to @c 1, and splitting a line in two with @p removed set to @c 1 and @p inserted set
+    to @c 2. This must be called before unlocking the worker after changing the document.
+*/
+T3_HIGHLIGHT_API void t3_highlight_worker_edit(t3_highlight_worker_t *worker, size_t line,
+                                               size_t removed, size_t inserted);
+/** Set the lines that are visible, and should therefore be highlighted and reported first.
+    @param worker The ::t3_highlight_worker_t to inform.
+    @param first The first visible line.
+    @param last The line after the last visible line.
+*/
+T3_HIGHLIGHT_API void t3_highlight_worker_set_viewport(t3_highlight_worker_t *worker,
+                                                       size_t first, size_t last);
+/** Get the number of lines at the start of the document for which the reported result
+    is up to date. */
+T3_HIGHLIGHT_API size_t t3_highlight_worker_get_done(const t3_highlight_worker_t *worker);
+
+/** Create an index of checkpoints, to start highlighting in the middle of a large text.
+    @param line_interval The number of lines between checkpoints, or @c 0 to only use
+        @p byte_interval.
+    @param byte_interval The number of bytes between checkpoints, or @c 0 to only use
+        @p line_interval.
+    @param max_checkpoints The maximum number of checkpoints, or @c 0 for no limit. When the
+        limit is reached, every other checkpoint is dropped and the intervals are doubled.
+    @return A new index holding only a checkpoint for the start of the text, or @c NULL if both
+        intervals are @c 0, if @p max_checkpoints is @c 1, or if out of memory.
+
+    A checkpoint records the line number, the offset of the line in the text and the state at
+    the start of the line, including any text extracted for dynamic back references. The
+    index can therefore be used with any ::t3_highlight_match_t for the same
+    ::t3_highlight_t as the one used to fill it.
+*/
+T3_HIGHLIGHT_API t3_highlight_index_t *t3_highlight_new_index(size_t line_interval,
+                                                              size_t byte_interval,
+                                                              size_t max_checkpoints);
+/** Free a ::t3_highlight_index_t. It is acceptable to pass a @c NULL pointer. */
+T3_HIGHLIGHT_API void t3_highlight_free_index(t3_highlight_index_t *index);
+/** Add a checkpoint for a line if it is due.
+    @param index The ::t3_highlight_index_t to add the checkpoint to.
+    @param match The ::t3_highlight_match_t at the start of @p line, i.e. after calling
+        ::t3_highlight_next_line for the previous line.
+    @param line The number of the line.
+    @param offset The offset of the start of the line in the text.
+    @return @c t3_false if out of memory, @c t3_true otherwise.
+
+    This is meant to be called for every line while highlighting the text, either in a
+    separate pass or while displaying it. Lines at or before the last checkpoint are ignored.
+*/
+T3_HIGHLIGHT_API t3_bool t3_highlight_index_update(t3_highlight_index_t *index,
+                                                   const t3_highlight_match_t *match,
+                                                   size_t line, size_t offset);
+/** Prepare to highlight from the last checkpoint at or before a line.
+    @param index The ::t3_highlight_index_t to use.
+    @param match The ::t3_highlight_match_t to reset to the state of the checkpoint.
+    @param line The line to highlight.
+    @param checkpoint_line Location to store the line of the checkpoint.
+    @param checkpoint_offset Location to store the offset of the line of the checkpoint.
+    @return @c t3_false if out of memory, in which case @p match is reset to state 0.
+
+    Highlighting from the start of line @p checkpoint_line up to @p line gives the same result
+    as highlighting from the start of the text.
+*/
+T3_HIGHLIGHT_API t3_bool t3_highlight_index_seek(const t3_highlight_index_t *index,
+                                                 t3_highlight_match_t *match, size_t line,
+                                                 size_t *checkpoint_line,
+                                                 size_t *checkpoint_offset);
+/** Get the line of the last checkpoint in an index.
+    Lines up to this line need not be highlighted again to fill the index.
+*/
+T3_HIGHLIGHT_API size_t t3_highlight_index_get_last(const t3_highlight_index_t *index);
+/** Convert an index to a compact text, to store it with the text it belongs to.
+    @param index The ::t3_highlight_index_t to convert.
+    @param highlight The ::t3_highlight_t used to fill the index.
+    @param size Location to store the size of the result.
+    @return The text, which must be freed using @c free, or @c NULL if out of memory.
+
+    The result is only valid for the same highlighting patterns, and is rejected by
+    ::t3_highlight_read_index otherwise. It does not contain anything to identify the
+    text itself, which is left to the caller.
+*/
+T3_HIGHLIGHT_API char *t3_highlight_write_index(const t3_highlight_index_t *index,
+                                                const t3_highlight_t *highlight, size_t *size);
+/** Recreate an index from the result of ::t3_highlight_write_index.
+    @param highlight The ::t3_highlight_t the index will be used with.
+    @param data The result of ::t3_highlight_write_index.
+    @param size The size of @p data.
+    @return A new index, or @c NULL if @p data is not valid for @p highlight, or if out of
+        memory.
+*/
+T3_HIGHLIGHT_API t3_highlight_index_t *t3_highlight_read_index(const t3_highlight_t *highlight,
+                                                               const char *data, size_t size);
+
+/** Check whether every line ends in the initial state.
+    @param highlight The ::t3_highlight_t to check.
+    @return ::t3_true if highlighting any line starting in the initial state always ends in the
+        initial state.
+
+    This is determined from the highlighting pattern, by checking that every state is exited
+    by a pattern that always matches at the end of a line, like <tt>end = '$'</tt>. If so,
+    every line can be highlighted independently of the lines before it, for example to divide
+    a text over multiple threads. This does not hold for lines on which highlighting stopped
+    because the budget set with ::t3_highlight_set_budget was exceeded.
+*/
+T3_HIGHLIGHT_API t3_bool t3_highlight_is_line_independent(const t3_highlight_t *highlight);
+
+/** Check whether a state can be active at the end of a line.
+    @param match The ::t3_highlight_match_t for which @p state is valid.
+    @param state A valid state index, as for ::t3_highlight_reset.
+    @return ::t3_false if @p state is always exited at the end of a line, such that
+        ::t3_highlight_next_line never returns it.
+
+    The initial state can always be active at the end of a line. This is determined in the same
+    way as for ::t3_highlight_is_line_independent, which returns ::t3_true if this function
+    returns ::t3_false for all states other than the initial state.
+*/
+T3_HIGHLIGHT_API t3_bool t3_highlight_state_can_end_line(const t3_highlight_match_t *match,
+                                                         int state);
+
+/** Find a line before a line in the middle of a text, from which highlighting can start.
+    @param match The ::t3_highlight_match_t to reset to the state at the start of the line.
+    @param line The line that will be highlighted.
+    @param get_line Callback to retrieve a line, as for ::t3_highlight_cursor_callbacks_t.
+        Lines for which it returns @c NULL are skipped.
+    @param data The pointer passed to @p get_line.
+    @param sync_line Location to store the line from which to start highlighting.
+    @return ::T3_HIGHLIGHT_SYNC_FOUND, ::T3_HIGHLIGHT_SYNC_GUESS or ::T3_HIGHLIGHT_SYNC_ERROR.
+
+    Starting at @p line, the lines are checked against the patterns in the @c sync section of
+    the highlighting patterns, until one matches at the start of the line, the start of the
+    text is reached, or the maximum look-back distance given in the @c sync section is
+    exhausted. In the last case, @p sync_line is set to the last line checked, and @p match is
+    reset to the outermost state. Highlighting patterns without a @c sync section do not
+    look back at all. For highlighting patterns for which ::t3_highlight_is_line_independent
+    returns ::t3_true, @p line itself is returned without looking at any lines.
+*/
+T3_HIGHLIGHT_API int t3_highlight_sync(t3_highlight_match_t *match, size_t line,
+                                       const char *(*get_line)(void *data, size_t line,
+                                                               size_t *size),
+                                       void *data, size_t *sync_line);
+
 /** Get a string description for an error code.
     @param error The error code returned by a function in libt3highlight.
     @return An internationalized string description for the error code.
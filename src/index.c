@@ -0,0 +1,468 @@
+/* Copyright (C) 2026 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "highlight.h"
+#include "internal.h"
+
+/* Version of the format written by t3_highlight_write_index. */
+#define INDEX_FORMAT "T3HI2"
+
+typedef struct {
+  size_t line, offset;
+  /* The state at the start of the line. */
+  state_snapshot_t *states;
+  int depth;
+} checkpoint_t;
+
+typedef VECTOR(char) text_t;
+
+/* Position in the data passed to t3_highlight_read_index. */
+typedef struct {
+  const char *ptr, *end;
+} reader_t;
+
+struct t3_highlight_index_t {
+  size_t line_interval, byte_interval, max_checkpoints;
+  /* Sorted by line. The first checkpoint is always at the start of the text. */
+  VECTOR(checkpoint_t) checkpoints;
+};
+
+static void free_checkpoint(checkpoint_t *checkpoint) {
+  _t3_highlight_free_snapshot(checkpoint->states, checkpoint->depth);
+  free(checkpoint->states);
+}
+
+/** Drop every other checkpoint, and double the intervals to match. */
+static void thin_checkpoints(t3_highlight_index_t *index) {
+  size_t i;
+
+  for (i = 1; i < index->checkpoints.used; i++) {
+    if (i & 1) {
+      free_checkpoint(&index->checkpoints.data[i]);
+    } else {
+      index->checkpoints.data[i / 2] = index->checkpoints.data[i];
+    }
+  }
+  index->checkpoints.used = (index->checkpoints.used + 1) / 2;
+  index->line_interval *= 2;
+  index->byte_interval *= 2;
+}
+
+t3_highlight_index_t *t3_highlight_new_index(size_t line_interval, size_t byte_interval,
+                                             size_t max_checkpoints) {
+  t3_highlight_index_t *result;
+
+  if ((line_interval == 0 && byte_interval == 0) || max_checkpoints == 1) {
+    return NULL;
+  }
+
+  if ((result = malloc(sizeof(t3_highlight_index_t))) == NULL) {
+    return NULL;
+  }
+  result->line_interval = line_interval;
+  result->byte_interval = byte_interval;
+  result->max_checkpoints = max_checkpoints;
+  VECTOR_INIT(result->checkpoints);
+  if (!VECTOR_RESERVE(result->checkpoints)) {
+    free(result);
+    return NULL;
+  }
+  VECTOR_LAST(result->checkpoints).line = 0;
+  VECTOR_LAST(result->checkpoints).offset = 0;
+  VECTOR_LAST(result->checkpoints).states = NULL;
+  VECTOR_LAST(result->checkpoints).depth = 0;
+  return result;
+}
+
+void t3_highlight_free_index(t3_highlight_index_t *index) {
+  if (index == NULL) {
+    return;
+  }
+  VECTOR_ITERATE(index->checkpoints, free_checkpoint);
+  VECTOR_FREE(index->checkpoints);
+  free(index);
+}
+
+t3_bool t3_highlight_index_update(t3_highlight_index_t *index, const t3_highlight_match_t *match,
+                                  size_t line, size_t offset) {
+  const checkpoint_t *last = &VECTOR_LAST(index->checkpoints);
+  state_snapshot_t *states;
+  int depth;
+
+  if (line <= last->line || offset < last->offset) {
+    return t3_true;
+  }
+  if ((index->line_interval == 0 || line - last->line < index->line_interval) &&
+      (index->byte_interval == 0 || offset - last->offset < index->byte_interval)) {
+    return t3_true;
+  }
+
+  if (index->max_checkpoints != 0 && index->checkpoints.used >= index->max_checkpoints) {
+    thin_checkpoints(index);
+    /* With the intervals doubled, this line may no longer need a checkpoint. */
+    return t3_highlight_index_update(index, match, line, offset);
+  }
+
+  if (!_t3_highlight_snapshot_state(match, &states, &depth)) {
+    return t3_false;
+  }
+  if (!VECTOR_RESERVE(index->checkpoints)) {
+    _t3_highlight_free_snapshot(states, depth);
+    free(states);
+    return t3_false;
+  }
+  VECTOR_LAST(index->checkpoints).line = line;
+  VECTOR_LAST(index->checkpoints).offset = offset;
+  VECTOR_LAST(index->checkpoints).states = states;
+  VECTOR_LAST(index->checkpoints).depth = depth;
+  return t3_true;
+}
+
+t3_bool t3_highlight_index_seek(const t3_highlight_index_t *index, t3_highlight_match_t *match,
+                                size_t line, size_t *checkpoint_line, size_t *checkpoint_offset) {
+  size_t low = 0, high = index->checkpoints.used;
+  const checkpoint_t *checkpoint;
+
+  /* Find the last checkpoint at or before line. The first checkpoint is at line 0. */
+  while (high - low > 1) {
+    size_t mid = low + (high - low) / 2;
+    if (index->checkpoints.data[mid].line <= line) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+  checkpoint = &index->checkpoints.data[low];
+
+  *checkpoint_line = checkpoint->line;
+  *checkpoint_offset = checkpoint->offset;
+  return _t3_highlight_restore_state(match, checkpoint->states, checkpoint->depth);
+}
+
+size_t t3_highlight_index_get_last(const t3_highlight_index_t *index) {
+  return VECTOR_LAST(index->checkpoints).line;
+}
+
+/** Compute a hash of the structure of the states of @p highlight. The state numbers stored in
+    an index are only meaningful for highlighting patterns with the same structure. The
+    attributes are not included, as they depend on the style. */
+static unsigned long hash_structure(const t3_highlight_t *highlight) {
+  unsigned long hash = 5381;
+  size_t i, j;
+
+#define HASH(x) hash = hash * 33 + (unsigned long)(x)
+  HASH(highlight->states.used);
+  for (i = 0; i < highlight->states.used; i++) {
+    const patterns_t *patterns = &highlight->states.data[i].patterns;
+
+    HASH(patterns->used);
+    for (j = 0; j < patterns->used; j++) {
+      const pattern_extra_t *extra = patterns->data[j].extra;
+
+      HASH(patterns->data[j].next_state);
+      HASH(extra == NULL ? 0 : 1 + (extra->dynamic_name != NULL));
+      HASH(extra == NULL ? 0 : extra->on_entry_cnt);
+    }
+  }
+#undef HASH
+  return hash & 0xffffffffUL;
+}
+
+static t3_bool append_text(text_t *text, const char *data, size_t size) {
+  size_t i;
+  for (i = 0; i < size; i++) {
+    if (!VECTOR_RESERVE(*text)) {
+      return t3_false;
+    }
+    VECTOR_LAST(*text) = data[i];
+  }
+  return t3_true;
+}
+
+/** Append @p value, preceded by @p separator unless it is 0. */
+static t3_bool append_number(text_t *text, char separator, size_t value) {
+  char buffer[32];
+  size_t length = 0;
+
+  if (separator != 0) {
+    buffer[length++] = separator;
+  }
+  sprintf(buffer + length, "%lu", (unsigned long)value);
+  return append_text(text, buffer, strlen(buffer));
+}
+
+/** Find the pattern in @p highlight that created a dynamic state, and append a reference to
+    it and the extracted text to @p text. */
+static t3_bool append_dynamic(text_t *text, const t3_highlight_t *highlight,
+                              const state_snapshot_t *state) {
+  static const char hex[] = "0123456789abcdef";
+  size_t i, j;
+  int k;
+
+  for (i = 0; i < highlight->states.used; i++) {
+    const patterns_t *patterns = &highlight->states.data[i].patterns;
+    for (j = 0; j < patterns->used; j++) {
+      const pattern_extra_t *extra = patterns->data[j].extra;
+      if (extra != state->extra) {
+        continue;
+      }
+      /* 0 refers to the pattern's own dynamic pattern, higher numbers to the on-entry list. */
+      for (k = 0; k < extra->on_entry_cnt && state->dynamic_pattern != extra->dynamic_pattern &&
+                  state->dynamic_pattern != extra->on_entry[k].end_pattern;
+           k++) {
+      }
+      if (!append_number(text, ':', i) || !append_number(text, ':', j) ||
+          !append_number(text, ':',
+                         state->dynamic_pattern == extra->dynamic_pattern ? 0 : (size_t)k + 1) ||
+          !append_text(text, ":", 1)) {
+        return t3_false;
+      }
+      for (k = 0; k < state->extracted_length; k++) {
+        char digits[2];
+        digits[0] = hex[(unsigned char)state->extracted[k] >> 4];
+        digits[1] = hex[(unsigned char)state->extracted[k] & 15];
+        if (!append_text(text, digits, 2)) {
+          return t3_false;
+        }
+      }
+      return t3_true;
+    }
+  }
+  return t3_false;
+}
+
+char *t3_highlight_write_index(const t3_highlight_index_t *index,
+                               const t3_highlight_t *highlight, size_t *size) {
+  text_t text;
+  size_t i;
+  int j;
+
+  VECTOR_INIT(text);
+  if (!append_text(&text, INDEX_FORMAT, strlen(INDEX_FORMAT)) ||
+      !append_number(&text, ' ', hash_structure(highlight)) ||
+      !append_number(&text, ' ', highlight->syntax_hash) ||
+      !append_number(&text, ' ', index->line_interval) ||
+      !append_number(&text, ' ', index->byte_interval) ||
+      !append_number(&text, ' ', index->max_checkpoints) ||
+      !append_number(&text, ' ', index->checkpoints.used) || !append_text(&text, "\n", 1)) {
+    goto return_error;
+  }
+  for (i = 0; i < index->checkpoints.used; i++) {
+    const checkpoint_t *checkpoint = &index->checkpoints.data[i];
+
+    if (!append_number(&text, 0, checkpoint->line) ||
+        !append_number(&text, ' ', checkpoint->offset) ||
+        !append_number(&text, ' ', checkpoint->depth)) {
+      goto return_error;
+    }
+    for (j = 0; j < checkpoint->depth; j++) {
+      const state_snapshot_t *state = &checkpoint->states[j];
+      if (!append_number(&text, ' ', state->highlight_state) ||
+          (state->extra != NULL && !append_dynamic(&text, highlight, state))) {
+        goto return_error;
+      }
+    }
+    if (!append_text(&text, "\n", 1)) {
+      goto return_error;
+    }
+  }
+  *size = text.used;
+  return text.data;
+
+return_error:
+  VECTOR_FREE(text);
+  return NULL;
+}
+
+static t3_bool read_char(reader_t *reader, char c) {
+  if (reader->ptr == reader->end || *reader->ptr != c) {
+    return t3_false;
+  }
+  reader->ptr++;
+  return t3_true;
+}
+
+/** Read a number, preceded by @p separator unless it is 0. */
+static t3_bool read_number(reader_t *reader, char separator, size_t *value) {
+  const char *start;
+
+  if (separator != 0 && !read_char(reader, separator)) {
+    return t3_false;
+  }
+  *value = 0;
+  for (start = reader->ptr; reader->ptr < reader->end && *reader->ptr >= '0' &&
+                            *reader->ptr <= '9';
+       reader->ptr++) {
+    size_t digit = *reader->ptr - '0';
+    if (*value > ((size_t)-1 - digit) / 10) {
+      return t3_false;
+    }
+    *value = *value * 10 + digit;
+  }
+  return reader->ptr != start;
+}
+
+static int hex_value(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  } else if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
+/** Read the reference written by append_dynamic, and check that it is valid for
+    @p highlight. */
+static t3_bool read_dynamic(reader_t *reader, const t3_highlight_t *highlight,
+                            state_snapshot_t *state) {
+  size_t state_idx, pattern_idx, entry, length;
+  const pattern_extra_t *extra;
+  const char *hex;
+
+  if (!read_number(reader, ':', &state_idx) || state_idx >= highlight->states.used ||
+      !read_number(reader, ':', &pattern_idx) ||
+      pattern_idx >= highlight->states.data[state_idx].patterns.used ||
+      !read_number(reader, ':', &entry) || !read_char(reader, ':')) {
+    return t3_false;
+  }
+  extra = highlight->states.data[state_idx].patterns.data[pattern_idx].extra;
+  if (extra == NULL || extra->dynamic_name == NULL || entry > (size_t)extra->on_entry_cnt) {
+    return t3_false;
+  }
+  state->extra = extra;
+  state->dynamic_pattern =
+      entry == 0 ? extra->dynamic_pattern : extra->on_entry[entry - 1].end_pattern;
+
+  for (hex = reader->ptr; reader->ptr < reader->end && hex_value(*reader->ptr) >= 0;
+       reader->ptr++) {
+  }
+  length = reader->ptr - hex;
+  if (length % 2 != 0 || length / 2 > INT_MAX) {
+    return t3_false;
+  }
+  /* Allocate at least one byte, such that NULL only signals an error. */
+  if ((state->extracted = malloc(length / 2 + 1)) == NULL) {
+    return t3_false;
+  }
+  state->extracted_length = (int)(length / 2);
+  for (length = 0; length < (size_t)state->extracted_length; length++) {
+    state->extracted[length] =
+        (char)(hex_value(hex[2 * length]) * 16 + hex_value(hex[2 * length + 1]));
+  }
+  return t3_true;
+}
+
+/** Read a checkpoint line written by t3_highlight_write_index into @p checkpoint. On failure,
+    the states that were read are freed. */
+static t3_bool read_checkpoint(reader_t *reader, const t3_highlight_t *highlight,
+                               checkpoint_t *checkpoint) {
+  size_t line, offset, depth, highlight_state, i;
+
+  checkpoint->states = NULL;
+  checkpoint->depth = 0;
+  /* Every state takes at least two bytes, which limits the allocation for corrupt data. */
+  if (!read_number(reader, 0, &line) || !read_number(reader, ' ', &offset) ||
+      !read_number(reader, ' ', &depth) || depth > (size_t)(reader->end - reader->ptr) / 2) {
+    return t3_false;
+  }
+  checkpoint->line = line;
+  checkpoint->offset = offset;
+  if (depth > 0 && (checkpoint->states = malloc(depth * sizeof(state_snapshot_t))) == NULL) {
+    return t3_false;
+  }
+  for (i = 0; i < depth; i++) {
+    state_snapshot_t *state = &checkpoint->states[i];
+
+    state->extra = NULL;
+    state->dynamic_pattern = NULL;
+    state->extracted = NULL;
+    state->extracted_length = 0;
+    checkpoint->depth++;
+    if (!read_number(reader, ' ', &highlight_state) ||
+        highlight_state >= highlight->states.used) {
+      goto return_error;
+    }
+    state->highlight_state = (pattern_idx_t)highlight_state;
+    if (reader->ptr < reader->end && *reader->ptr == ':' &&
+        !read_dynamic(reader, highlight, state)) {
+      goto return_error;
+    }
+  }
+  if (read_char(reader, '\n')) {
+    return t3_true;
+  }
+
+return_error:
+  free_checkpoint(checkpoint);
+  return t3_false;
+}
+
+t3_highlight_index_t *t3_highlight_read_index(const t3_highlight_t *highlight, const char *data,
+                                              size_t size) {
+  reader_t reader;
+  size_t hash, syntax_hash, line_interval, byte_interval, max_checkpoints, count, i;
+  t3_highlight_index_t *result;
+
+  reader.ptr = data;
+  reader.end = data + size;
+  if (size < strlen(INDEX_FORMAT) || memcmp(data, INDEX_FORMAT, strlen(INDEX_FORMAT)) != 0) {
+    return NULL;
+  }
+  reader.ptr += strlen(INDEX_FORMAT);
+  if (!read_number(&reader, ' ', &hash) || hash != hash_structure(highlight) ||
+      !read_number(&reader, ' ', &syntax_hash) || syntax_hash != highlight->syntax_hash ||
+      !read_number(&reader, ' ', &line_interval) || !read_number(&reader, ' ', &byte_interval) ||
+      !read_number(&reader, ' ', &max_checkpoints) || !read_number(&reader, ' ', &count) ||
+      !read_char(&reader, '\n') || count == 0 ||
+      (max_checkpoints != 0 && count > max_checkpoints)) {
+    return NULL;
+  }
+
+  if ((result = t3_highlight_new_index(line_interval, byte_interval, max_checkpoints)) == NULL) {
+    return NULL;
+  }
+  /* Replace the checkpoint at the start of the text created by t3_highlight_new_index. */
+  result->checkpoints.used = 0;
+  for (i = 0; i < count; i++) {
+    const checkpoint_t *checkpoint;
+
+    if (!VECTOR_RESERVE(result->checkpoints)) {
+      goto return_error;
+    }
+    if (!read_checkpoint(&reader, highlight, &VECTOR_LAST(result->checkpoints))) {
+      result->checkpoints.used--;
+      goto return_error;
+    }
+    /* The checkpoints must be in the order t3_highlight_index_update adds them. */
+    checkpoint = &VECTOR_LAST(result->checkpoints);
+    if (i == 0 && (checkpoint->line != 0 || checkpoint->offset != 0 || checkpoint->depth != 0)) {
+      goto return_error;
+    }
+    if (i > 0 && (checkpoint->line <= checkpoint[-1].line ||
+                  checkpoint->offset < checkpoint[-1].offset)) {
+      goto return_error;
+    }
+  }
+  if (reader.ptr == reader.end) {
+    return result;
+  }
+
+return_error:
+  t3_highlight_free_index(result);
+  return NULL;
+}
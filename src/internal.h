@@ -19,6 +19,7 @@
 #else
 #include <pcre2.h>
 #endif
+#include <time.h>
 
 #include "highlight_api.h"
 #include "vector.h"
@@ -45,24 +46,47 @@ INDEX_TYPE(dst_idx_t);
 /* WARNING: make sure any flags defined here don't clash with the ones in
    highlight.h */
 #define T3_HIGHLIGHT_ALLOW_EMPTY_START (1 << 15)
+/* Set when the states, patterns and their extra data have been moved into a single
+   allocation, which is owned by states.data. */
+#define T3_HIGHLIGHT_COMPACTED (1 << 14)
 
 typedef struct {
   char *end_pattern;
   pattern_idx_t state;
 } on_entry_info_t;
 
+typedef struct {
+  const unsigned char *word; /* Case folded if ignore_case is set. NULL for empty slots. */
+  size_t length;
+  unsigned int hash;
+} keyword_slot_t;
+
+/* Hash table for a keywords list. The slots and the words are stored in the same
+   allocation as the keywords_t itself. */
+typedef struct {
+  keyword_slot_t *slots;
+  size_t mask; /* The number of slots minus one. */
+  size_t min_length, max_length;
+  size_t size;
+  t3_bool ignore_case, word_boundary;
+  unsigned char fold[256];
+  unsigned char word_chars[256];
+} keywords_t;
+
 typedef struct {
   char *dynamic_name;
   char *dynamic_pattern;
   on_entry_info_t *on_entry;
   int on_entry_cnt;
+  keywords_t *keywords; /* Only set for keywords patterns, which have no regex. */
 } pattern_extra_t;
 
 typedef struct {
   pcre2_code_8 *regex;
-  pattern_extra_t *extra;   /* Only set for start patterns. */
+  pattern_extra_t *extra;   /* Only set for start and keywords patterns. */
   pattern_idx_t next_state; /* Values: NO_CHANGE, EXIT_STATE or smaller,  or a value >= 0. */
   int attribute_idx;
+  int source_idx; /* Index in the sources member of the t3_highlight_t. */
 } pattern_t;
 
 typedef VECTOR(pattern_t) patterns_t;
@@ -74,16 +98,50 @@ typedef struct {
 
 typedef VECTOR(state_t) states_t;
 
+/* Location in the syntax files from which a pattern was created. The file_name
+   points to an entry in the file_names member of the t3_highlight_t. */
+typedef struct {
+  const char *file_name;
+  int line_number;
+} pattern_source_t;
+
+/* A pattern from the sync section. A line on which the regex matches starts in the state
+   entered from the outermost state by the start pattern with the name given in the sync
+   section, or in the outermost state if none was given. */
+typedef struct {
+  pcre2_code_8 *regex;
+  pattern_idx_t state;
+} sync_pattern_t;
+
 struct t3_highlight_t {
   states_t states;
   char *lang_file;
   int flags;
+  /* The sources are only needed for reporting, and are therefore not part of the
+     single allocation created by compact_highlight. */
+  VECTOR(pattern_source_t) sources;
+  VECTOR(char *) file_names;
+  /* The maximum number of characters any regular expression looks behind its start. */
+  uint32_t max_lookbehind;
+  VECTOR(sync_pattern_t) sync_patterns;
+  /* The maximum number of lines t3_highlight_sync looks back. */
+  size_t sync_max_lines;
+  /* The number of states, other than the outermost state, which can be active at the end of
+     a line, and for each state whether it can be. */
+  size_t line_end_states;
+  t3_bool *line_end;
+  /* Hash of the syntax description, to recognise results made with other patterns. */
+  unsigned long syntax_hash;
 };
 
 typedef struct {
   pcre2_code_8 *regex;
   char *extracted;
   int extracted_length;
+  /* The pattern extra and the regular expression from which the regex was built. These are
+     needed to create the same state in another t3_highlight_match_t. */
+  const pattern_extra_t *extra;
+  const char *dynamic_pattern;
 } dynamic_state_t;
 
 typedef struct {
@@ -92,14 +150,50 @@ typedef struct {
   dynamic_state_t *dynamic;
 } state_mapping_t;
 
+/* Copy of a single state_mapping_t, independent of the t3_highlight_match_t it was taken
+   from. A state is described by the list of these for the states from the outermost
+   state up to the state itself. */
+typedef struct {
+  pattern_idx_t highlight_state;
+  /* Only set for states with a dynamic back reference. */
+  const pattern_extra_t *extra;
+  const char *dynamic_pattern;
+  char *extracted;
+  int extracted_length;
+} state_snapshot_t;
+
 struct t3_highlight_match_t {
   const t3_highlight_t *highlight;
   VECTOR(state_mapping_t) mapping;
   PCRE2_SIZE start, match_start, end, last_progress;
   dst_idx_t state;
   int begin_attribute, match_attribute, last_progress_state;
-  t3_bool utf8_checked;
+  /* Number of states entered since the last progress. */
+  size_t last_progress_entries;
+  /* Position up to which the line has been checked for UTF-8 validity. */
+  PCRE2_SIZE utf8_checked;
+  /* State for t3_highlight_match_chunk: the first position of the line that is still
+     needed, whether the last call stopped to wait for more data, and the maximum look
+     behind including dynamically created regular expressions. */
+  PCRE2_SIZE chunk_keep;
+  t3_bool chunk_resume;
+  /* Set to wait for the end of partial matches of any length, when the caller can always
+     provide the rest of the line. */
+  t3_bool chunk_wait;
+  uint32_t max_lookbehind;
   pcre2_match_data_8 *match_data;
+  /* Indexed by pattern_t.source_idx. NULL unless profiling was enabled. */
+  t3_highlight_profile_t *profile;
+  const t3_highlight_trace_t *trace;
+  void *trace_data;
+  /* Budget for a single line. The match context is NULL unless any of the PCRE2 limits is
+     set. The time limit is in nanoseconds, and the time and steps used so far cover all
+     calls for the current line. */
+  pcre2_match_context_8 *match_context;
+  unsigned long step_limit, steps;
+  long long time_limit, time_used;
+  struct timespec call_start;
+  t3_bool budget_exceeded;
 };
 
 typedef struct {
@@ -107,6 +201,16 @@ typedef struct {
   pattern_idx_t state;
 } use_mapping_t;
 
+/* Cache entry for the result of the map_style callback. Both strings point into
+   the t3_config_t that is being compiled, so they are only valid during
+   t3_highlight_new. */
+typedef struct {
+  const char *style;
+  const char *scope;
+  unsigned int hash;
+  int attribute_idx;
+} style_mapping_t;
+
 /* Structs to make passing a large number of arguments easier. */
 typedef struct {
   int (*map_style)(void *, const char *);
@@ -115,6 +219,9 @@ typedef struct {
   t3_config_t *syntax;
   int flags;
   VECTOR(use_mapping_t) use_map;
+  VECTOR(style_mapping_t) style_map;
+  /* The states entered by start patterns with a name key. */
+  VECTOR(use_mapping_t) state_names;
   t3_highlight_error_t *error;
   const char *scope;
 } highlight_context_t;
@@ -123,26 +230,54 @@ typedef struct {
   t3_highlight_match_t *match;
   const char *line;
   size_t size;
+  size_t offset; /* Position in the line of the first byte of the line member. */
+  int options;   /* Extra options for pcre2_match. */
+  t3_bool partial;
   state_t *state;
   pcre2_match_data_8 *match_data;
   PCRE2_SIZE best_end, extract_start, extract_end;
+  size_t keywords_end;
   pattern_t *best;
 } match_context_t;
 
+/* Transition types in the transition graph used for analysis. A use transition links a state
+   to the state it includes through a 'use' directive. An empty-start transition is made by a
+   start pattern that can match the empty string, and from there through its on-entry states. */
+#define TRANSITION_USE (1 << 0)
+#define TRANSITION_EMPTY_START (1 << 1)
+
 typedef struct {
-  size_t i;
-  pattern_idx_t state;
-} state_stack_t;
+  pattern_idx_t target;
+  int type;
+} transition_t;
+
+/* The transitions out of state i are transitions[first[i]] up to transitions[first[i + 1]]. */
+typedef struct {
+  size_t *first;
+  transition_t *transitions;
+  size_t state_count;
+} transition_graph_t;
 
 T3_HIGHLIGHT_LOCAL char *_t3_highlight_strdup(const char *str);
 T3_HIGHLIGHT_LOCAL t3_bool _t3_compile_highlight(const char *highlight, pcre2_code_8 **regex,
                                                  const t3_config_t *error_context, int flags,
                                                  t3_highlight_error_t *error);
-T3_HIGHLIGHT_LOCAL t3_bool _t3_check_empty_start_cycle(highlight_context_t *context);
-T3_HIGHLIGHT_LOCAL t3_bool _t3_check_use_cycle(highlight_context_t *context);
+T3_HIGHLIGHT_LOCAL t3_bool _t3_check_cycles(highlight_context_t *context);
+T3_HIGHLIGHT_LOCAL t3_bool _t3_analyse_line_ends(highlight_context_t *context);
+T3_HIGHLIGHT_LOCAL keywords_t *_t3_new_keywords(const t3_config_t *highlight, int flags,
+                                                t3_highlight_error_t *error);
+T3_HIGHLIGHT_LOCAL t3_bool _t3_match_keywords(const keywords_t *keywords, const char *line,
+                                              size_t size, size_t start, size_t *end,
+                                              t3_bool *partial);
 T3_HIGHLIGHT_LOCAL void _t3_highlight_set_error(t3_highlight_error_t *error, int code,
                                                 int line_number, const char *file_name,
                                                 const char *extra, int flags);
 T3_HIGHLIGHT_LOCAL void _t3_highlight_set_error_simple(t3_highlight_error_t *error, int code,
                                                        int flags);
+T3_HIGHLIGHT_LOCAL t3_bool _t3_highlight_snapshot_state(const t3_highlight_match_t *match,
+                                                        state_snapshot_t **snapshot, int *depth);
+T3_HIGHLIGHT_LOCAL void _t3_highlight_free_snapshot(state_snapshot_t *snapshot, int depth);
+T3_HIGHLIGHT_LOCAL t3_bool _t3_highlight_restore_state(t3_highlight_match_t *match,
+                                                       const state_snapshot_t *snapshot,
+                                                       int depth);
 #endif
@@ -42,15 +42,58 @@ static const char map_schema[] = {
 #include "map.bytes"
 };
 
+#ifdef USE_BUILTIN_DATA
+typedef struct {
+  const char *name;
+  const char *data;
+  size_t size;
+} builtin_file_t;
+
+/* Defines builtin_files, the list of files from the data directory, terminated by an
+   entry with a NULL name. */
+#include "builtin_data.h"
+
+/** Open a copy of a data file that is built into the library. */
+static FILE *open_builtin(const char *name) {
+  const builtin_file_t *file;
+
+  for (file = builtin_files; file->name != NULL; file++) {
+    if (strcmp(file->name, name) == 0) {
+      return fmemopen((void *)file->data, file->size, "r");
+    }
+  }
+  errno = ENOENT;
+  return NULL;
+}
+
+/** Include callback which prefers files in the search path over the built-in files. */
+static FILE *open_include(const char *name, size_t name_length, void *data) {
+  char *name_copy;
+  FILE *file;
+
+  if ((name_copy = malloc(name_length + 1)) == NULL) {
+    return NULL;
+  }
+  memcpy(name_copy, name, name_length);
+  name_copy[name_length] = 0;
+
+  if ((file = t3_config_open_from_path(data, name_copy, 0)) == NULL) {
+    file = open_builtin(name_copy);
+  }
+  free(name_copy);
+  return file;
+}
+#endif
+
 /** Load a single language map. */
-static t3_config_t *load_single_map(const char *name, int flags, t3_highlight_error_t *error) {
+static t3_config_t *load_single_map(FILE *file, const char *name, int flags,
+                                    t3_highlight_error_t *error) {
   t3_config_schema_t *schema = NULL;
   t3_config_error_t local_error;
   t3_config_t *map;
   t3_config_opts_t opts;
-  FILE *file;
 
-  if ((file = fopen(name, "r")) == NULL) {
+  if (file == NULL) {
     _t3_highlight_set_error(error, T3_ERR_ERRNO, 0, name, NULL, flags);
     goto return_error;
   }
@@ -125,17 +168,21 @@ static t3_config_t *load_map(int flags, t3_highlight_error_t *error) {
   xdg_map = t3_config_xdg_get_path(T3_CONFIG_XDG_DATA_HOME, "libt3highlight", strlen("lang.map"));
   if (xdg_map != NULL) {
     strcat(xdg_map, "/lang.map");
-    map = load_single_map(xdg_map, 0, NULL);
+    map = load_single_map(fopen(xdg_map, "r"), xdg_map, 0, NULL);
     free(xdg_map);
     if (map != NULL) {
       merge(full_map, map);
     }
   }
 
-  if ((map = load_single_map(DATADIR "/"
-                                     "lang.map",
-                             0, error)) == NULL)
+#ifdef USE_BUILTIN_DATA
+  map = load_single_map(open_builtin("lang.map"), "lang.map", 0, error);
+#else
+  map = load_single_map(fopen(DATADIR "/lang.map", "r"), DATADIR "/lang.map", 0, error);
+#endif
+  if (map == NULL) {
     goto return_error;
+  }
 
   merge(full_map, map);
   return full_map;
@@ -294,22 +341,29 @@ t3_highlight_t *t3_highlight_load_by_langname(const char *name,
   return load_by_xname("name-regex", name, map_style, map_style_data, flags, error);
 }
 
-t3_highlight_t *t3_highlight_load(const char *lang_file, int (*map_style)(void *, const char *),
-                                  void *map_style_data, int flags, t3_highlight_error_t *error) {
+/** Read a highlighting pattern file, using the search path if requested through @p flags. */
+static t3_config_t *load_syntax(const char *lang_file, int flags, t3_highlight_error_t *error) {
   t3_config_opts_t opts;
   const char *path[] = {NULL, NULL, NULL};
   char *xdg_path = NULL;
   t3_config_t *config = NULL;
   t3_config_error_t config_error;
-  t3_highlight_t *result;
   FILE *file = NULL;
 
-  /* Setup path. */
+  /* Setup path. When the data files are built into the library, only the user's directory
+     is searched, and the built-in files are used if the file is not found there. */
   path[0] = xdg_path = t3_config_xdg_get_path(T3_CONFIG_XDG_DATA_HOME, "libt3highlight", 0);
+#ifndef USE_BUILTIN_DATA
   path[path[0] == NULL ? 0 : 1] = DATADIR;
+#endif
 
   if (flags & T3_HIGHLIGHT_USE_PATH) {
     if ((file = t3_config_open_from_path(path, lang_file, 0)) == NULL) {
+#ifdef USE_BUILTIN_DATA
+      file = open_builtin(lang_file);
+#endif
+    }
+    if (file == NULL) {
       _t3_highlight_set_error(error, T3_ERR_ERRNO, 0, lang_file, NULL, flags);
       goto return_error;
     }
@@ -320,12 +374,18 @@ t3_highlight_t *t3_highlight_load(const char *lang_file, int (*map_style)(void *
     }
   }
 
+#ifdef USE_BUILTIN_DATA
+  opts.flags = T3_CONFIG_INCLUDE_USER | T3_CONFIG_ERROR_FILE_NAME;
+  opts.include_callback.user.open = open_include;
+  opts.include_callback.user.data = path;
+#else
   opts.flags = T3_CONFIG_INCLUDE_DFLT | T3_CONFIG_ERROR_FILE_NAME;
+  opts.include_callback.dflt.path = path;
+  opts.include_callback.dflt.flags = 0;
+#endif
   if (flags & T3_HIGHLIGHT_VERBOSE_ERROR) {
     opts.flags |= T3_CONFIG_VERBOSE_ERROR;
   }
-  opts.include_callback.dflt.path = path;
-  opts.include_callback.dflt.flags = 0;
 
   if ((config = t3_config_read_file(file, &config_error, &opts)) == NULL) {
     _t3_highlight_set_error(error, config_error.error, config_error.line_number,
@@ -336,9 +396,27 @@ t3_highlight_t *t3_highlight_load(const char *lang_file, int (*map_style)(void *
   }
 
   free(xdg_path);
-  xdg_path = NULL;
   fclose(file);
-  file = NULL;
+  return config;
+
+return_error:
+  free(xdg_path);
+  if (file != NULL) {
+    int save_errno = errno;
+    fclose(file);
+    errno = save_errno;
+  }
+  return NULL;
+}
+
+t3_highlight_t *t3_highlight_load(const char *lang_file, int (*map_style)(void *, const char *),
+                                  void *map_style_data, int flags, t3_highlight_error_t *error) {
+  t3_config_t *config;
+  t3_highlight_t *result;
+
+  if ((config = load_syntax(lang_file, flags, error)) == NULL) {
+    return NULL;
+  }
 
   if ((result = t3_highlight_new(config, map_style, map_style_data, flags, error)) == NULL) {
     if ((flags & T3_HIGHLIGHT_VERBOSE_ERROR) && error->file_name == NULL) {
@@ -349,6 +427,7 @@ t3_highlight_t *t3_highlight_load(const char *lang_file, int (*map_style)(void *
 
   if ((result->lang_file = _t3_highlight_strdup(lang_file)) == NULL) {
     _t3_highlight_set_error_simple(error, T3_ERR_OUT_OF_MEMORY, flags);
+    t3_highlight_free(result);
     goto return_error;
   }
 
@@ -358,15 +437,39 @@ t3_highlight_t *t3_highlight_load(const char *lang_file, int (*map_style)(void *
 
 return_error:
   t3_config_delete(config);
-  free(xdg_path);
-  if (file != NULL) {
-    int save_errno = errno;
-    fclose(file);
-    errno = save_errno;
-  }
   return NULL;
 }
 
+t3_highlight_lint_t *t3_highlight_lint_file(const char *lang_file, int flags,
+                                            t3_highlight_error_t *error) {
+  t3_config_t *config;
+  t3_highlight_lint_t *result;
+  int i;
+
+  if ((config = load_syntax(lang_file, flags, error)) == NULL) {
+    return NULL;
+  }
+
+  if ((result = t3_highlight_lint(config, flags, error)) == NULL) {
+    if ((flags & T3_HIGHLIGHT_VERBOSE_ERROR) && error->file_name == NULL) {
+      error->file_name = _t3_highlight_strdup(lang_file);
+    }
+  } else {
+    /* Only items from included files have a file name. */
+    for (i = 0; result[i].type != T3_HIGHLIGHT_LINT_END; i++) {
+      if (result[i].file_name == NULL &&
+          (result[i].file_name = _t3_highlight_strdup(lang_file)) == NULL) {
+        _t3_highlight_set_error_simple(error, T3_ERR_OUT_OF_MEMORY, flags);
+        t3_highlight_free_lint(result);
+        result = NULL;
+        break;
+      }
+    }
+  }
+  t3_config_delete(config);
+  return result;
+}
+
 const char *t3_highlight_get_langfile(const t3_highlight_t *highlight) {
   return highlight == NULL ? NULL : highlight->lang_file;
 }
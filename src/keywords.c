@@ -0,0 +1,198 @@
+/* Copyright (C) 2026 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdlib.h>
+#include <string.h>
+
+#include "highlight.h"
+#include "internal.h"
+
+#define HASH_INIT 5381
+#define HASH_NEXT(hash, c) ((hash) * 33 + (c))
+
+/** Check whether @p word, which must already be case folded, is in the table. */
+static t3_bool lookup_folded(const keywords_t *keywords, const unsigned char *word, size_t length,
+                             unsigned int hash) {
+  size_t i;
+
+  for (i = hash & keywords->mask; keywords->slots[i].word != NULL; i = (i + 1) & keywords->mask) {
+    if (keywords->slots[i].hash == hash && keywords->slots[i].length == length &&
+        memcmp(keywords->slots[i].word, word, length) == 0) {
+      return t3_true;
+    }
+  }
+  return t3_false;
+}
+
+/** Check whether @p word from the input is in the table. */
+static t3_bool lookup(const keywords_t *keywords, const char *word, size_t length,
+                      unsigned int hash) {
+  size_t i, j;
+
+  for (i = hash & keywords->mask; keywords->slots[i].word != NULL; i = (i + 1) & keywords->mask) {
+    const keyword_slot_t *slot = &keywords->slots[i];
+    if (slot->hash != hash || slot->length != length) {
+      continue;
+    }
+    for (j = 0; j < length && keywords->fold[(unsigned char)word[j]] == slot->word[j]; j++) {
+    }
+    if (j == length) {
+      return t3_true;
+    }
+  }
+  return t3_false;
+}
+
+keywords_t *_t3_new_keywords(const t3_config_t *highlight, int flags,
+                             t3_highlight_error_t *error) {
+  const t3_config_t *list = t3_config_get(highlight, "keywords");
+  const t3_config_t *option;
+  const t3_config_t *keyword;
+  const char *word_chars;
+  size_t count = 0, strings_size = 0, slot_count, i;
+  keywords_t *result = NULL;
+  unsigned char *strings;
+
+  for (keyword = t3_config_get(list, NULL); keyword != NULL;
+       keyword = t3_config_get_next(keyword)) {
+    count++;
+    strings_size += strlen(t3_config_get_string(keyword));
+  }
+
+  /* Keep the load factor at or below one half, such that failed lookups end quickly. */
+  for (slot_count = 1; slot_count < count * 2; slot_count <<= 1) {
+  }
+
+  if ((result = malloc(sizeof(keywords_t) + slot_count * sizeof(keyword_slot_t) + strings_size)) ==
+      NULL) {
+    _t3_highlight_set_error_simple(error, T3_ERR_OUT_OF_MEMORY, flags);
+    return NULL;
+  }
+  result->slots = (keyword_slot_t *)(result + 1);
+  result->mask = slot_count - 1;
+  result->min_length = (size_t)-1;
+  result->max_length = 0;
+  result->size = sizeof(keywords_t) + slot_count * sizeof(keyword_slot_t) + strings_size;
+  strings = (unsigned char *)(result->slots + slot_count);
+  for (i = 0; i < slot_count; i++) {
+    result->slots[i].word = NULL;
+  }
+
+  option = t3_config_get(highlight, "ignore-case");
+  result->ignore_case = option != NULL && t3_config_get_bool(option);
+  option = t3_config_get(highlight, "word-boundary");
+  result->word_boundary = option == NULL || t3_config_get_bool(option);
+
+  for (i = 0; i < 256; i++) {
+    result->fold[i] = result->ignore_case && i >= 'A' && i <= 'Z' ? i - 'A' + 'a' : i;
+    result->word_chars[i] = (i >= 'a' && i <= 'z') || (i >= 'A' && i <= 'Z') ||
+                            (i >= '0' && i <= '9') || i == '_';
+  }
+  if ((word_chars = t3_config_get_string(t3_config_get(highlight, "word-chars"))) != NULL) {
+    for (; *word_chars != 0; word_chars++) {
+      result->word_chars[(unsigned char)*word_chars] = t3_true;
+    }
+  }
+
+  for (keyword = t3_config_get(list, NULL); keyword != NULL;
+       keyword = t3_config_get_next(keyword)) {
+    const char *word = t3_config_get_string(keyword);
+    size_t length = strlen(word);
+    unsigned int hash = HASH_INIT;
+
+    /* With word boundaries, the input is split into words before looking them up. Thus
+       keywords containing other characters would never match. */
+    for (i = 0; i < length; i++) {
+      if (result->word_boundary && !result->word_chars[(unsigned char)word[i]]) {
+        break;
+      }
+      strings[i] = result->fold[(unsigned char)word[i]];
+      hash = HASH_NEXT(hash, strings[i]);
+    }
+    if (length == 0 || i < length) {
+      _t3_highlight_set_error(error, T3_ERR_INVALID_KEYWORD, t3_config_get_line_number(keyword),
+                              t3_config_get_file_name(keyword), word, flags);
+      free(result);
+      return NULL;
+    }
+
+    if (lookup_folded(result, strings, length, hash)) {
+      continue;
+    }
+    for (i = hash & result->mask; result->slots[i].word != NULL; i = (i + 1) & result->mask) {
+    }
+    result->slots[i].word = strings;
+    result->slots[i].length = length;
+    result->slots[i].hash = hash;
+    strings += length;
+
+    if (length < result->min_length) {
+      result->min_length = length;
+    }
+    if (length > result->max_length) {
+      result->max_length = length;
+    }
+  }
+  return result;
+}
+
+t3_bool _t3_match_keywords(const keywords_t *keywords, const char *line, size_t size, size_t start,
+                           size_t *end, t3_bool *partial) {
+  unsigned int hash = HASH_INIT;
+  size_t i;
+
+  /* If more data may follow, a word that runs up to the end of the data may still become
+     a (different) keyword. */
+  if (partial != NULL) {
+    *partial = t3_false;
+  }
+
+  if (keywords->word_boundary) {
+    if (start > 0 && keywords->word_chars[(unsigned char)line[start - 1]]) {
+      return t3_false;
+    }
+    for (i = start; i < size && keywords->word_chars[(unsigned char)line[i]]; i++) {
+      if (i - start == keywords->max_length) {
+        return t3_false;
+      }
+      hash = HASH_NEXT(hash, keywords->fold[(unsigned char)line[i]]);
+    }
+    if (i == size && partial != NULL) {
+      *partial = t3_true;
+      return t3_false;
+    }
+    if (i - start < keywords->min_length || !lookup(keywords, line + start, i - start, hash)) {
+      return t3_false;
+    }
+    *end = i;
+    return t3_true;
+  } else {
+    /* The hash of each prefix follows from the hash of the previous one, so all keywords
+       starting at start are found in a single pass. The longest one is the result. */
+    t3_bool found = t3_false;
+
+    for (i = start; i < size && i - start < keywords->max_length; i++) {
+      hash = HASH_NEXT(hash, keywords->fold[(unsigned char)line[i]]);
+      if (i + 1 - start >= keywords->min_length &&
+          lookup(keywords, line + start, i + 1 - start, hash)) {
+        *end = i + 1;
+        found = t3_true;
+      }
+    }
+    if (i == size && i - start < keywords->max_length && partial != NULL) {
+      *partial = t3_true;
+      return t3_false;
+    }
+    return found;
+  }
+}
@@ -19,13 +19,18 @@
 #endif
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "highlight.h"
 #include "highlight_errors.h"
 #include "internal.h"
 
+/* The number of bytes a partial match in t3_highlight_match_chunk may cover before it is
+   matched against the available data only. This bounds the data that needs to be kept. */
+#define CHUNK_PARTIAL_LIMIT (1024 * 1024)
+
 static dst_idx_t find_state(t3_highlight_match_t *match, pattern_idx_t highlight_state,
-                            pattern_extra_t *extra, const char *dynamic_line, int dynamic_length,
+                            const pattern_extra_t *extra, const char *dynamic_line, int dynamic_length,
                             const char *dynamic_pattern) {
   size_t i;
 
@@ -105,6 +110,8 @@ static dst_idx_t find_state(t3_highlight_match_t *match, pattern_idx_t highlight
     }
     new_dynamic->extracted_length = dynamic_length;
     memcpy(new_dynamic->extracted, dynamic_line, dynamic_length);
+    new_dynamic->extra = extra;
+    new_dynamic->dynamic_pattern = dynamic_pattern;
 
     sprintf(pattern, "(?(DEFINE)(?<%s>\\Q", extra->dynamic_name);
     patptr = pattern + strlen(pattern);
@@ -134,20 +141,106 @@ static dst_idx_t find_state(t3_highlight_match_t *match, pattern_idx_t highlight
     }
     VECTOR_LAST(match->mapping).dynamic = new_dynamic;
     free(pattern);
+    {
+      uint32_t lookbehind;
+      if (pcre2_pattern_info_8(new_dynamic->regex, PCRE2_INFO_MAXLOOKBEHIND, &lookbehind) == 0 &&
+          lookbehind > match->max_lookbehind) {
+        match->max_lookbehind = lookbehind;
+      }
+    }
+  }
+  if (match->trace != NULL && match->trace->create_state != NULL) {
+    match->trace->create_state(match->trace_data, match->mapping.used - 1, match->state);
   }
   return match->mapping.used - 1;
 }
 
+/** Try to match @p pattern at the current position.
+    For keywords lists, @p regex is @c NULL, and the end of the match is stored in the
+    @c keywords_end member of @p context. The return value is that of pcre2_match. */
+static int try_pattern(match_context_t *context, const pattern_t *pattern, pcre2_code_8 *regex,
+                       int options) {
+  if (regex == NULL) {
+    t3_bool partial;
+    if (_t3_match_keywords(pattern->extra->keywords, context->line, context->size,
+                           context->match->match_start - context->offset, &context->keywords_end,
+                           (context->options & PCRE2_PARTIAL_HARD) ? &partial : NULL)) {
+      return 0;
+    }
+    return (context->options & PCRE2_PARTIAL_HARD) && partial ? PCRE2_ERROR_PARTIAL
+                                                               : PCRE2_ERROR_NOMATCH;
+  }
+  return pcre2_match_8(regex, (PCRE2_SPTR8)context->line, context->size,
+                       context->match->match_start - context->offset, options | context->options,
+                       context->match_data, context->match->match_context);
+}
+
+/** Return the number of nanoseconds since @p start. */
+static long long elapsed_nsec(const struct timespec *start) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long)(now.tv_sec - start->tv_sec) * 1000000000 + (now.tv_nsec - start->tv_nsec);
+}
+
+/** Account for trying another pattern, and check whether the budget for the line allows it. */
+static t3_bool budget_left(t3_highlight_match_t *match) {
+  if ((match->step_limit != 0 && ++match->steps > match->step_limit) ||
+      (match->time_limit != 0 &&
+       match->time_used + elapsed_nsec(&match->call_start) > match->time_limit)) {
+    match->budget_exceeded = t3_true;
+    return t3_false;
+  }
+  return t3_true;
+}
+
+/** Call try_pattern for @p pattern, while reporting to the tracing callbacks and updating
+    the profiling counters. */
+static int instrumented_match(match_context_t *context, const pattern_t *pattern,
+                              pcre2_code_8 *regex, int options) {
+  t3_highlight_match_t *match = context->match;
+  t3_highlight_profile_t *profile;
+  struct timespec start, end;
+  int result;
+
+  if (match->trace != NULL && match->trace->try_pattern != NULL) {
+    match->trace->try_pattern(match->trace_data, pattern->source_idx, match->match_start);
+  }
+  if (match->profile == NULL) {
+    return try_pattern(context, pattern, regex, options);
+  }
+
+  profile = &match->profile[pattern->source_idx];
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  result = try_pattern(context, pattern, regex, options);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  profile->attempts++;
+  if (result >= 0) {
+    profile->successes++;
+  }
+  profile->time_nsec += (long long)(end.tv_sec - start.tv_sec) * 1000000000 +
+                        (end.tv_nsec - start.tv_nsec);
+  return result;
+}
+
 static void match_internal(match_context_t *context) {
   size_t j;
 
   for (j = 0; j < context->state->patterns.used; j++) {
     pcre2_code_8 *regex;
     int options = PCRE2_NO_UTF_CHECK;
+    int result;
+    PCRE2_SIZE match_end;
+
+    /* This also stops the search in the states that included this one through use. */
+    if (context->match->budget_exceeded) {
+      return;
+    }
 
     /* If the regex member == NULL, this highlight is either a pointer to
-       another state which we should search here ("use"), or it is an end
-       pattern with a dynamic back reference. */
+       another state which we should search here ("use"), a keywords list, or
+       it is an end pattern with a dynamic back reference. */
     if (context->state->patterns.data[j].regex == NULL) {
       if (context->state->patterns.data[j].next_state >= 0) {
         state_t *save_state;
@@ -158,7 +251,10 @@ static void match_internal(match_context_t *context) {
         context->state = save_state;
         continue;
       }
-      regex = context->match->mapping.data[context->match->state].dynamic->regex;
+      /* End patterns with a dynamic back reference do not have an extra member. */
+      regex = context->state->patterns.data[j].extra != NULL
+                  ? NULL
+                  : context->match->mapping.data[context->match->state].dynamic->regex;
     } else {
       regex = context->state->patterns.data[j].regex;
       /* For items that do not change state, we do not want an empty match
@@ -173,13 +269,34 @@ static void match_internal(match_context_t *context) {
       }
     }
 
-    if (pcre2_match_8(regex, (PCRE2_SPTR8)context->line, context->size, context->match->match_start,
-                      options, context->match_data, NULL) >= 0 &&
-        (context->best == NULL ||
-         pcre2_get_ovector_pointer_8(context->match_data)[1] > context->best_end)) {
+    if ((context->match->step_limit != 0 || context->match->time_limit != 0) &&
+        !budget_left(context->match)) {
+      return;
+    }
+
+    if (context->match->profile == NULL && context->match->trace == NULL) {
+      result = try_pattern(context, &context->state->patterns.data[j], regex, options);
+    } else {
+      result = instrumented_match(context, &context->state->patterns.data[j], regex, options);
+    }
+    if (result < 0) {
+      if (result == PCRE2_ERROR_PARTIAL) {
+        context->partial = t3_true;
+      } else if (result == PCRE2_ERROR_MATCHLIMIT || result == PCRE2_ERROR_DEPTHLIMIT ||
+                 result == PCRE2_ERROR_HEAPLIMIT) {
+        /* Trying the next positions would most likely run into the limit again. */
+        context->match->budget_exceeded = t3_true;
+        return;
+      }
+      continue;
+    }
+
+    match_end = regex == NULL ? context->keywords_end
+                              : pcre2_get_ovector_pointer_8(context->match_data)[1];
+    if (context->best == NULL || match_end > context->best_end) {
       const PCRE2_SIZE *ovector = pcre2_get_ovector_pointer_8(context->match_data);
       context->best = &context->state->patterns.data[j];
-      context->best_end = ovector[1];
+      context->best_end = match_end;
       if (context->best->extra != NULL && context->best->extra->dynamic_name != NULL) {
         int string_number = pcre2_substring_number_from_name_8(
             context->best->regex, (PCRE2_SPTR8)context->best->extra->dynamic_name);
@@ -210,79 +327,246 @@ static int step_utf8(char first) {
   }
 }
 
+static void trace_enter_states(t3_highlight_match_t *match, dst_idx_t ancestor, dst_idx_t state) {
+  if (state == ancestor) {
+    return;
+  }
+  trace_enter_states(match, ancestor, match->mapping.data[state].parent);
+  match->trace->enter_state(match->trace_data, state);
+}
+
+/** Report the states left and entered when moving from state @p from to state @p to. */
+static void trace_state_change(t3_highlight_match_t *match, dst_idx_t from, dst_idx_t to) {
+  dst_idx_t ancestor_from = from, ancestor_to = to;
+
+  /* States are always created after their parent, so the parent has the lower index. */
+  while (ancestor_from != ancestor_to) {
+    if (ancestor_from > ancestor_to) {
+      ancestor_from = match->mapping.data[ancestor_from].parent;
+    } else {
+      ancestor_to = match->mapping.data[ancestor_to].parent;
+    }
+  }
+
+  if (match->trace->leave_state != NULL) {
+    for (; from != ancestor_from; from = match->mapping.data[from].parent) {
+      match->trace->leave_state(match->trace_data, from);
+    }
+  }
+  if (match->trace->enter_state != NULL) {
+    trace_enter_states(match, ancestor_from, to);
+  }
+}
+
+/** Determine the size of the part of @p data that does not end in an incomplete UTF-8 sequence. */
+static size_t complete_utf8_size(const char *data, size_t size) {
+  size_t i;
+
+  for (i = size; i > 0 && size - i < 4; i--) {
+    unsigned char c = data[i - 1];
+    if (c >= 0xc0) {
+      return i - 1 + step_utf8(c) > size ? i - 1 : size;
+    } else if (c < 0x80) {
+      return size;
+    }
+  }
+  return size;
+}
+
+/** Return the rest of the line as a single section with the attribute of the current state,
+    after the budget for the line ran out. */
+static int skip_rest(t3_highlight_match_t *match, PCRE2_SIZE data_end, t3_bool last) {
+  match->match_start = data_end;
+  match->end = data_end;
+  if (!last) {
+    match->chunk_resume = t3_true;
+    match->chunk_keep = data_end;
+    return T3_HIGHLIGHT_CHUNK_MORE;
+  }
+  return T3_HIGHLIGHT_CHUNK_END;
+}
+
 t3_bool t3_highlight_match(t3_highlight_match_t *match, const char *line, size_t size) {
+  return t3_highlight_match_chunk(match, line, size, 0, t3_true) == T3_HIGHLIGHT_CHUNK_MATCH;
+}
+
+static int match_chunk(t3_highlight_match_t *match, const char *data, size_t size, size_t offset,
+                       t3_bool last) {
   match_context_t context;
+  PCRE2_SIZE data_end;
+
+  /* Don't pass a UTF-8 sequence of which the end is not yet available, as PCRE would read
+     beyond the end of the data. */
+  if (!last && (match->highlight->flags & T3_HIGHLIGHT_UTF8)) {
+    size = complete_utf8_size(data, size);
+  }
+  data_end = offset + size;
 
   if ((match->highlight->flags & (T3_HIGHLIGHT_UTF8 | T3_HIGHLIGHT_UTF8_NOCHECK)) ==
           T3_HIGHLIGHT_UTF8 &&
-      !match->utf8_checked) {
-    if (!t3_highlight_utf8check(line, size)) {
+      match->utf8_checked < data_end) {
+    PCRE2_SIZE check_start = match->utf8_checked > offset ? match->utf8_checked - offset : 0;
+    if (!t3_highlight_utf8check(data + check_start, size - check_start)) {
       match->state = 0;
       match->begin_attribute = 0;
       match->match_attribute = 0;
       match->start = match->match_start = match->end = -1;
-      pcre2_match_data_free_8(context.match_data);
-      return t3_false;
+      return T3_HIGHLIGHT_CHUNK_ERROR;
     }
-    match->utf8_checked = t3_true;
+    match->utf8_checked = data_end;
   }
 
   context.match = match;
-  context.line = line;
+  context.line = data;
   context.size = size;
+  context.offset = offset;
+  /* When not starting at the start of the line, the first byte is not the start of the
+     subject for the purpose of ^. */
+  context.options = (last ? 0 : PCRE2_PARTIAL_HARD) | (offset > 0 ? PCRE2_NOTBOL : 0);
+  context.partial = t3_false;
   context.state = &match->highlight->states.data[match->mapping.data[match->state].highlight_state];
   context.best = NULL;
   context.best_end = 0;
+  context.extract_start = 0;
+  context.extract_end = 0;
   context.match_data = match->match_data;
 
   match->start = match->end;
   match->begin_attribute = context.state->attribute_idx;
 
-  if (match->last_progress != match->end) {
+  /* When resuming after waiting for more data, no progress has been made. */
+  if (match->chunk_resume) {
+    match->chunk_resume = t3_false;
+  } else if (match->last_progress != match->end) {
     match->last_progress = match->end;
     match->last_progress_state = match->state;
+    match->last_progress_entries = 0;
   } else if (match->last_progress_state < match->state) {
     match->last_progress_state = match->state;
   }
 
-  for (match->match_start = match->end; match->match_start <= (PCRE2_SIZE)size;
-       match->match_start +=
-       (match->highlight->flags & T3_HIGHLIGHT_UTF8) ? step_utf8(line[match->match_start]) : 1) {
+  if (match->budget_exceeded) {
+    return skip_rest(match, data_end, last);
+  }
+
+  for (match->match_start = match->end; match->match_start <= data_end;
+       match->match_start += (match->highlight->flags & T3_HIGHLIGHT_UTF8)
+                                 ? step_utf8(data[match->match_start - offset])
+                                 : 1) {
+    if (!last && match->match_start == data_end) {
+      break;
+    }
     match_internal(&context);
+    if (match->budget_exceeded) {
+      return skip_rest(match, data_end, last);
+    }
+
+    if (context.partial) {
+      if (match->chunk_wait || data_end - match->match_start <= CHUNK_PARTIAL_LIMIT) {
+        break;
+      }
+      /* The partial match is too long to wait for its end. Use the data available. */
+      context.options &= ~PCRE2_PARTIAL_HARD;
+      context.partial = t3_false;
+      context.best = NULL;
+      match_internal(&context);
+      context.options |= PCRE2_PARTIAL_HARD;
+      if (match->budget_exceeded) {
+        return skip_rest(match, data_end, last);
+      }
+    }
 
     if (context.best != NULL) {
+      dst_idx_t previous_state = match->state;
       dst_idx_t next_state =
           find_state(match, context.best->next_state, context.best->extra,
-                     line + context.extract_start, context.extract_end - context.extract_start,
+                     data + context.extract_start, context.extract_end - context.extract_start,
                      context.best->extra != NULL ? context.best->extra->dynamic_pattern : NULL);
 
-      /* Check if we have come full circle. If so, continue to the next byte and start over. */
-      if (context.best != NULL && match->last_progress == context.best_end &&
-          ((context.best->next_state > NO_CHANGE && match->last_progress_state == next_state) ||
+      /* Check if we have come full circle. If so, continue to the next byte and start over.
+         The check on last_progress_state does not catch cycles through lower numbered
+         states, or endless nesting of a state in itself. However, entering more states
+         without progress than there are highlight states means one of them is repeated. */
+      if (context.best != NULL && match->last_progress == offset + context.best_end &&
+          ((context.best->next_state > NO_CHANGE &&
+            (match->last_progress_state == next_state ||
+             match->last_progress_entries >= match->highlight->states.used)) ||
            match->state == next_state)) {
         context.best = NULL;
         continue;
       }
 
-      match->end = context.best_end;
+      if (match->profile != NULL) {
+        match->profile[context.best->source_idx].wins++;
+        match->profile[context.best->source_idx].bytes +=
+            offset + context.best_end - match->match_start;
+      }
+
+      if (context.best->next_state > NO_CHANGE &&
+          match->last_progress == offset + context.best_end) {
+        match->last_progress_entries++;
+      }
+      match->end = offset + context.best_end;
       match->state = next_state;
       if (context.best->extra != NULL && context.best->extra->on_entry != NULL) {
         int i;
         for (i = 0; i < context.best->extra->on_entry_cnt; i++) {
           match->state =
               find_state(match, context.best->extra->on_entry[i].state, context.best->extra,
-                         line + context.extract_start, context.extract_end - context.extract_start,
+                         data + context.extract_start, context.extract_end - context.extract_start,
                          context.best->extra->on_entry[i].end_pattern);
         }
       }
       match->match_attribute = context.best->attribute_idx;
-      return t3_true;
+
+      if (match->trace != NULL) {
+        if (match->trace->match_pattern != NULL) {
+          match->trace->match_pattern(match->trace_data, context.best->source_idx,
+                                      match->match_start, match->end);
+        }
+        trace_state_change(match, previous_state, match->state);
+      }
+      return T3_HIGHLIGHT_CHUNK_MATCH;
+    }
+  }
+
+  if (!last) {
+    uint32_t lookbehind;
+
+    /* Everything before the current position is final. Keep the data that regular
+       expressions tried at the current position may look at. */
+    match->end = match->match_start;
+    match->chunk_resume = t3_true;
+    match->chunk_keep = match->match_start;
+    for (lookbehind = match->max_lookbehind; lookbehind > 0 && match->chunk_keep > offset;
+         lookbehind--) {
+      match->chunk_keep--;
+      if (match->highlight->flags & T3_HIGHLIGHT_UTF8) {
+        while (match->chunk_keep > offset &&
+               (data[match->chunk_keep - offset] & 0xc0) == 0x80) {
+          match->chunk_keep--;
+        }
+      }
     }
+    return T3_HIGHLIGHT_CHUNK_MORE;
   }
 
-  match->match_start = size;
-  match->end = size;
-  return t3_false;
+  match->match_start = data_end;
+  match->end = data_end;
+  return T3_HIGHLIGHT_CHUNK_END;
+}
+
+int t3_highlight_match_chunk(t3_highlight_match_t *match, const char *data, size_t size,
+                             size_t offset, t3_bool last) {
+  int result;
+
+  if (match->time_limit == 0) {
+    return match_chunk(match, data, size, offset, last);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &match->call_start);
+  result = match_chunk(match, data, size, offset, last);
+  match->time_used += elapsed_nsec(&match->call_start);
+  return result;
 }
 
 void t3_highlight_reset(t3_highlight_match_t *match, dst_idx_t state) {
@@ -292,9 +576,15 @@ void t3_highlight_reset(t3_highlight_match_t *match, dst_idx_t state) {
   match->begin_attribute = 0;
   match->match_attribute = 0;
   match->state = state;
-  match->utf8_checked = t3_false;
+  match->utf8_checked = 0;
+  match->chunk_keep = 0;
+  match->chunk_resume = t3_false;
   match->last_progress = 0;
   match->last_progress_state = -1;
+  match->last_progress_entries = 0;
+  match->steps = 0;
+  match->time_used = 0;
+  match->budget_exceeded = t3_false;
 }
 
 t3_highlight_match_t *t3_highlight_new_match(const t3_highlight_t *highlight) {
@@ -310,6 +600,14 @@ t3_highlight_match_t *t3_highlight_new_match(const t3_highlight_t *highlight) {
   }
 
   result->highlight = highlight;
+  result->profile = NULL;
+  result->trace = NULL;
+  result->trace_data = NULL;
+  result->match_context = NULL;
+  result->step_limit = 0;
+  result->time_limit = 0;
+  result->chunk_wait = t3_false;
+  result->max_lookbehind = highlight->max_lookbehind;
   memset(&VECTOR_LAST(result->mapping), 0, sizeof(state_mapping_t));
   result->match_data = pcre2_match_data_create_8(15, NULL);
   if (result->match_data == NULL) {
@@ -338,6 +636,8 @@ void t3_highlight_free_match(t3_highlight_match_t *match) {
   VECTOR_ITERATE(match->mapping, free_dynamic);
   VECTOR_FREE(match->mapping);
   pcre2_match_data_free_8(match->match_data);
+  pcre2_match_context_free_8(match->match_context);
+  free(match->profile);
   free(match);
 }
 
@@ -347,6 +647,8 @@ size_t t3_highlight_get_match_start(t3_highlight_match_t *match) { return match-
 
 size_t t3_highlight_get_end(t3_highlight_match_t *match) { return match->end; }
 
+size_t t3_highlight_get_chunk_keep(t3_highlight_match_t *match) { return match->chunk_keep; }
+
 int t3_highlight_get_begin_attr(t3_highlight_match_t *match) { return match->begin_attribute; }
 
 int t3_highlight_get_match_attr(t3_highlight_match_t *match) { return match->match_attribute; }
@@ -355,8 +657,160 @@ int t3_highlight_get_state(t3_highlight_match_t *match) { return match->state; }
 
 int t3_highlight_next_line(t3_highlight_match_t *match) {
   match->end = 0;
-  match->utf8_checked = t3_false;
+  match->utf8_checked = 0;
+  match->chunk_keep = 0;
+  match->chunk_resume = t3_false;
   match->last_progress = 0;
   match->last_progress_state = -1;
+  match->last_progress_entries = 0;
+  match->steps = 0;
+  match->time_used = 0;
+  match->budget_exceeded = t3_false;
   return match->state;
 }
+
+t3_bool t3_highlight_set_profile(t3_highlight_match_t *match, t3_bool enable) {
+  const t3_highlight_t *highlight = match->highlight;
+  size_t i;
+
+  free(match->profile);
+  match->profile = NULL;
+  if (!enable) {
+    return t3_true;
+  }
+
+  /* Always allocate at least one entry, such that a NULL result always indicates failure. */
+  if ((match->profile = calloc(highlight->sources.used == 0 ? 1 : highlight->sources.used,
+                               sizeof(t3_highlight_profile_t))) == NULL) {
+    return t3_false;
+  }
+  for (i = 0; i < highlight->sources.used; i++) {
+    match->profile[i].file_name = highlight->sources.data[i].file_name;
+    match->profile[i].line_number = highlight->sources.data[i].line_number;
+  }
+  return t3_true;
+}
+
+const t3_highlight_profile_t *t3_highlight_get_profile(const t3_highlight_match_t *match,
+                                                       size_t *count) {
+  *count = match->profile == NULL ? 0 : match->highlight->sources.used;
+  return match->profile;
+}
+
+void t3_highlight_set_trace(t3_highlight_match_t *match, const t3_highlight_trace_t *trace,
+                            void *data) {
+  match->trace = trace;
+  match->trace_data = data;
+}
+
+static uint32_t pcre2_limit(unsigned long value) {
+  return value > UINT32_MAX ? UINT32_MAX : (uint32_t)value;
+}
+
+t3_bool t3_highlight_set_budget(t3_highlight_match_t *match, const t3_highlight_budget_t *budget) {
+  pcre2_match_context_8 *match_context = NULL;
+
+  if (budget != NULL &&
+      (budget->match_limit != 0 || budget->depth_limit != 0 || budget->heap_limit != 0)) {
+    if ((match_context = pcre2_match_context_create_8(NULL)) == NULL) {
+      return t3_false;
+    }
+    if (budget->match_limit != 0) {
+      pcre2_set_match_limit_8(match_context, pcre2_limit(budget->match_limit));
+    }
+    if (budget->depth_limit != 0) {
+      pcre2_set_depth_limit_8(match_context, pcre2_limit(budget->depth_limit));
+    }
+    if (budget->heap_limit != 0) {
+      pcre2_set_heap_limit_8(match_context, pcre2_limit(budget->heap_limit));
+    }
+  }
+
+  pcre2_match_context_free_8(match->match_context);
+  match->match_context = match_context;
+  match->step_limit = budget == NULL ? 0 : budget->step_limit;
+  match->time_limit = budget == NULL ? 0 : (long long)budget->time_limit_usec * 1000;
+  return t3_true;
+}
+
+t3_bool t3_highlight_budget_exceeded(const t3_highlight_match_t *match) {
+  return match->budget_exceeded;
+}
+
+/** Copy the list of states from the outermost state up to the current state of @p match.
+    The result is independent of @p match, and can be used to create the same state in another
+    ::t3_highlight_match_t for the same ::t3_highlight_t. */
+t3_bool _t3_highlight_snapshot_state(const t3_highlight_match_t *match,
+                                     state_snapshot_t **snapshot, int *depth) {
+  dst_idx_t state;
+  int i;
+
+  *depth = 0;
+  *snapshot = NULL;
+  for (state = match->state; state > 0; state = match->mapping.data[state].parent) {
+    (*depth)++;
+  }
+  if (*depth == 0) {
+    return t3_true;
+  }
+
+  if ((*snapshot = malloc(*depth * sizeof(state_snapshot_t))) == NULL) {
+    return t3_false;
+  }
+  for (state = match->state, i = *depth - 1; state > 0;
+       state = match->mapping.data[state].parent, i--) {
+    const dynamic_state_t *dynamic = match->mapping.data[state].dynamic;
+    state_snapshot_t *entry = *snapshot + i;
+
+    entry->highlight_state = match->mapping.data[state].highlight_state;
+    entry->extra = NULL;
+    entry->dynamic_pattern = NULL;
+    entry->extracted = NULL;
+    entry->extracted_length = 0;
+    if (dynamic == NULL) {
+      continue;
+    }
+    entry->extra = dynamic->extra;
+    entry->dynamic_pattern = dynamic->dynamic_pattern;
+    entry->extracted_length = dynamic->extracted_length;
+    /* Allocate at least one byte, such that NULL only signals an error. */
+    if ((entry->extracted = malloc(dynamic->extracted_length + 1)) == NULL) {
+      _t3_highlight_free_snapshot(*snapshot + i + 1, *depth - i - 1);
+      free(*snapshot);
+      *snapshot = NULL;
+      return t3_false;
+    }
+    memcpy(entry->extracted, dynamic->extracted, dynamic->extracted_length);
+  }
+  return t3_true;
+}
+
+/** Free the extracted texts in a list created by ::_t3_highlight_snapshot_state.
+    The list itself is not freed. */
+void _t3_highlight_free_snapshot(state_snapshot_t *snapshot, int depth) {
+  int i;
+  for (i = 0; i < depth; i++) {
+    free(snapshot[i].extracted);
+  }
+}
+
+/** Reset @p match to the start of a line, in the state described by @p snapshot.
+    Returns @c t3_false if out of memory, in which case @p match is reset to state 0. */
+t3_bool _t3_highlight_restore_state(t3_highlight_match_t *match,
+                                    const state_snapshot_t *snapshot, int depth) {
+  dst_idx_t state = 0;
+  int i;
+
+  for (i = 0; i < depth; i++) {
+    match->state = state;
+    /* None of the states in a snapshot is the outermost state, so 0 signals an error. */
+    if ((state = find_state(match, snapshot[i].highlight_state, snapshot[i].extra,
+                            snapshot[i].extracted, snapshot[i].extracted_length,
+                            snapshot[i].dynamic_pattern)) == 0) {
+      t3_highlight_reset(match, 0);
+      return t3_false;
+    }
+  }
+  t3_highlight_reset(match, state);
+  return t3_true;
+}
@@ -47,12 +47,20 @@ pcre2_code_8 *pcre2_compile_8(PCRE2_SPTR8 pattern, PCRE2_SIZE pattern_size, uint
 int pcre2_pattern_info_8(const pcre2_code_8 *code, uint32_t what, void *where) {
   uint32_t value;
   int result;
-  if (what != PCRE2_INFO_MINLENGTH) {
+  if (what == PCRE2_INFO_SIZE || what == PCRE2_INFO_JITSIZE) {
+    /* Both are reported as size_t by PCRE as well as PCRE2. */
+    return pcre_fullinfo(code->regex, code->extra, what, where);
+  }
+  if (what != PCRE2_INFO_MINLENGTH && what != PCRE2_INFO_MAXLOOKBEHIND) {
     return PCRE2_ERROR_BADOPTION;
   }
   result = pcre_fullinfo(code->regex, code->extra, what, &value);
   if (result == 0) {
-    *(int *)where = value;
+    if (what == PCRE2_INFO_MAXLOOKBEHIND) {
+      *(uint32_t *)where = value;
+    } else {
+      *(int *)where = value;
+    }
   }
   return result;
 }
@@ -102,13 +110,55 @@ void pcre2_code_free_8(pcre2_code_8 *code) {
 
 int pcre2_match_8(const pcre2_code_8 *code, PCRE2_SPTR8 subject, PCRE2_SIZE length,
                   PCRE2_SIZE startoffset, uint32_t options, pcre2_match_data_8 *match_data,
-                  void *mcontext) {
-  (void)mcontext;
-  return pcre_exec(code->regex, code->extra, (const char *)subject,
+                  pcre2_match_context_8 *mcontext) {
+  pcre_extra limited_extra, *extra = code->extra;
+
+  /* PCRE sets the limits through the extra data of the regex, which is shared. Use a copy
+     with the limits added instead. */
+  if (mcontext != NULL) {
+    if (extra != NULL) {
+      limited_extra = *extra;
+    } else {
+      memset(&limited_extra, 0, sizeof(limited_extra));
+    }
+    if (mcontext->match_limit != 0) {
+      limited_extra.flags |= PCRE_EXTRA_MATCH_LIMIT;
+      limited_extra.match_limit = mcontext->match_limit;
+    }
+    if (mcontext->depth_limit != 0) {
+      limited_extra.flags |= PCRE_EXTRA_MATCH_LIMIT_RECURSION;
+      limited_extra.match_limit_recursion = mcontext->depth_limit;
+    }
+    extra = &limited_extra;
+  }
+  return pcre_exec(code->regex, extra, (const char *)subject,
                    length == PCRE2_ZERO_TERMINATED ? strlen((const char *)subject) : length,
                    startoffset, options, match_data + 1, *match_data);
 }
 
+pcre2_match_context_8 *pcre2_match_context_create_8(void *gcontext) {
+  (void)gcontext;
+  return calloc(1, sizeof(pcre2_match_context_8));
+}
+
+void pcre2_match_context_free_8(pcre2_match_context_8 *mcontext) { free(mcontext); }
+
+int pcre2_set_match_limit_8(pcre2_match_context_8 *mcontext, uint32_t value) {
+  mcontext->match_limit = value;
+  return 0;
+}
+
+int pcre2_set_depth_limit_8(pcre2_match_context_8 *mcontext, uint32_t value) {
+  mcontext->depth_limit = value;
+  return 0;
+}
+
+int pcre2_set_heap_limit_8(pcre2_match_context_8 *mcontext, uint32_t value) {
+  (void)mcontext;
+  (void)value;
+  return 0;
+}
+
 int pcre2_get_error_message_8(int errorcode, PCRE2_UCHAR8 *buffer, PCRE2_SIZE bufflen) {
   char *copy_end;
   if (errorcode == last_error_code) {
@@ -31,6 +31,9 @@
 #define PCRE2_SPTR8 const unsigned char *
 #define PCRE2_ZERO_TERMINATED ((PCRE2_SIZE)-1)
 #define PCRE2_INFO_MINLENGTH PCRE_INFO_MINLENGTH
+#define PCRE2_INFO_SIZE PCRE_INFO_SIZE
+#define PCRE2_INFO_JITSIZE PCRE_INFO_JITSIZE
+#define PCRE2_INFO_MAXLOOKBEHIND PCRE_INFO_MAXLOOKBEHIND
 #define PCRE2_UTF PCRE_UTF8
 #define PCRE2_ANCHORED PCRE_ANCHORED
 #define PCRE2_ERROR_NOMEMORY PCRE_ERROR_NOMEMORY
@@ -39,9 +42,17 @@
 
 #define PCRE2_NO_UTF_CHECK PCRE_NO_UTF8_CHECK
 #define PCRE2_NOTEMPTY PCRE_NOTEMPTY
+#define PCRE2_NOTBOL PCRE_NOTBOL
+#define PCRE2_PARTIAL_HARD PCRE_PARTIAL_HARD
 #define PCRE2_CASELESS PCRE_CASELESS
 
 #define PCRE2_ERROR_BADOPTION PCRE_ERROR_BADOPTION
+#define PCRE2_ERROR_NOMATCH PCRE_ERROR_NOMATCH
+#define PCRE2_ERROR_PARTIAL PCRE_ERROR_PARTIAL
+#define PCRE2_ERROR_MATCHLIMIT PCRE_ERROR_MATCHLIMIT
+#define PCRE2_ERROR_DEPTHLIMIT PCRE_ERROR_RECURSIONLIMIT
+/* PCRE has no heap limit, so this value is never returned. */
+#define PCRE2_ERROR_HEAPLIMIT (-63)
 
 typedef struct {
   pcre *regex;
@@ -50,6 +61,12 @@ typedef struct {
 
 typedef int pcre2_match_data_8;
 
+/* A value of 0 means the limit is not set. */
+typedef struct {
+  uint32_t match_limit;
+  uint32_t depth_limit;
+} pcre2_match_context_8;
+
 /* Redefine the symbol names to prevent potential symbol clashes with the actual pcre2 library. */
 #define pcre2_compile_8 t3_highlight_pcre2_compile
 #define pcre2_pattern_info_8 t3_highlight_pcre2_pattern_info
@@ -63,6 +80,11 @@ typedef int pcre2_match_data_8;
 #define pcre2_match_8 t3_highlight_pcre2_match
 #define pcre2_get_error_message_8 t3_highlight_pcre2_get_error_message
 #define pcre2_substring_number_from_name_8 t3_highlight_pcre2_substring_number_from_name
+#define pcre2_match_context_create_8 t3_highlight_pcre2_match_context_create
+#define pcre2_match_context_free_8 t3_highlight_pcre2_match_context_free
+#define pcre2_set_match_limit_8 t3_highlight_pcre2_set_match_limit
+#define pcre2_set_depth_limit_8 t3_highlight_pcre2_set_depth_limit
+#define pcre2_set_heap_limit_8 t3_highlight_pcre2_set_heap_limit
 
 T3_HIGHLIGHT_LOCAL pcre2_code_8 *pcre2_compile_8(PCRE2_SPTR8 pattern, PCRE2_SIZE pattern_size,
                                                  uint32_t options, int *errorcode,
@@ -79,7 +101,13 @@ T3_HIGHLIGHT_LOCAL uint32_t pcre2_get_ovector_count_8(pcre2_match_data_8 *match_
 T3_HIGHLIGHT_LOCAL void pcre2_code_free_8(pcre2_code_8 *code);
 T3_HIGHLIGHT_LOCAL int pcre2_match_8(const pcre2_code_8 *code, PCRE2_SPTR8 subject,
                                      PCRE2_SIZE length, PCRE2_SIZE startoffset, uint32_t options,
-                                     pcre2_match_data_8 *match_data, void *mcontext);
+                                     pcre2_match_data_8 *match_data,
+                                     pcre2_match_context_8 *mcontext);
+T3_HIGHLIGHT_LOCAL pcre2_match_context_8 *pcre2_match_context_create_8(void *gcontext);
+T3_HIGHLIGHT_LOCAL void pcre2_match_context_free_8(pcre2_match_context_8 *mcontext);
+T3_HIGHLIGHT_LOCAL int pcre2_set_match_limit_8(pcre2_match_context_8 *mcontext, uint32_t value);
+T3_HIGHLIGHT_LOCAL int pcre2_set_depth_limit_8(pcre2_match_context_8 *mcontext, uint32_t value);
+T3_HIGHLIGHT_LOCAL int pcre2_set_heap_limit_8(pcre2_match_context_8 *mcontext, uint32_t value);
 
 T3_HIGHLIGHT_LOCAL int pcre2_get_error_message_8(int errorcode, PCRE2_UCHAR8 *buffer,
                                                  PCRE2_SIZE bufflen);
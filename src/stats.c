@@ -0,0 +1,112 @@
+/* Copyright (C) 2026 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifdef PCRE_COMPAT
+#include "pcre_compat.h"
+#else
+#include <pcre2.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+
+#include "highlight.h"
+#include "internal.h"
+
+static size_t string_size(const char *str) { return str == NULL ? 0 : strlen(str) + 1; }
+
+static void add_regex_stats(const pcre2_code_8 *regex, t3_highlight_stats_t *stats) {
+  size_t size;
+
+  if (regex == NULL) {
+    return;
+  }
+  if (pcre2_pattern_info_8(regex, PCRE2_INFO_SIZE, &size) == 0) {
+    stats->regex_bytes += size;
+  }
+  if (pcre2_pattern_info_8(regex, PCRE2_INFO_JITSIZE, &size) == 0) {
+    stats->jit_bytes += size;
+  }
+}
+
+void t3_highlight_get_stats(const t3_highlight_t *highlight, t3_highlight_stats_t *stats) {
+  size_t i, j;
+  int k;
+
+  memset(stats, 0, sizeof(t3_highlight_stats_t));
+  stats->states = highlight->states.used;
+  stats->line_end_states = highlight->line_end_states;
+  stats->table_bytes = sizeof(t3_highlight_t) + string_size(highlight->lang_file) +
+                       highlight->states.allocated * sizeof(state_t) +
+                       highlight->states.used * sizeof(t3_bool);
+  stats->table_bytes += highlight->sources.allocated * sizeof(pattern_source_t) +
+                        highlight->file_names.allocated * sizeof(char *);
+  for (i = 0; i < highlight->file_names.used; i++) {
+    stats->table_bytes += string_size(highlight->file_names.data[i]);
+  }
+
+  for (i = 0; i < highlight->states.used; i++) {
+    const patterns_t *patterns = &highlight->states.data[i].patterns;
+
+    stats->patterns += patterns->used;
+    stats->table_bytes += patterns->allocated * sizeof(pattern_t);
+    for (j = 0; j < patterns->used; j++) {
+      const pattern_extra_t *extra = patterns->data[j].extra;
+
+      add_regex_stats(patterns->data[j].regex, stats);
+      if (extra == NULL) {
+        continue;
+      }
+      stats->table_bytes += sizeof(pattern_extra_t) + string_size(extra->dynamic_name) +
+                            string_size(extra->dynamic_pattern) +
+                            extra->on_entry_cnt * sizeof(on_entry_info_t);
+      if (extra->keywords != NULL) {
+        stats->table_bytes += extra->keywords->size;
+      }
+      for (k = 0; k < extra->on_entry_cnt; k++) {
+        stats->table_bytes += string_size(extra->on_entry[k].end_pattern);
+      }
+    }
+  }
+
+  stats->table_bytes += highlight->sync_patterns.allocated * sizeof(sync_pattern_t);
+  for (i = 0; i < highlight->sync_patterns.used; i++) {
+    add_regex_stats(highlight->sync_patterns.data[i].regex, stats);
+  }
+}
+
+void t3_highlight_get_match_stats(const t3_highlight_match_t *match, t3_highlight_stats_t *stats) {
+  size_t i;
+
+  memset(stats, 0, sizeof(t3_highlight_stats_t));
+  stats->states = match->highlight->states.used;
+  stats->line_end_states = match->highlight->line_end_states;
+  for (i = 0; i < match->highlight->states.used; i++) {
+    stats->patterns += match->highlight->states.data[i].patterns.used;
+  }
+  /* Mapping 0 is the initial state, which is always present. */
+  stats->dynamic_mappings = match->mapping.used - 1;
+  stats->table_bytes =
+      sizeof(t3_highlight_match_t) + match->mapping.allocated * sizeof(state_mapping_t);
+  if (match->profile != NULL) {
+    stats->table_bytes += match->highlight->sources.used * sizeof(t3_highlight_profile_t);
+  }
+
+  for (i = 0; i < match->mapping.used; i++) {
+    const dynamic_state_t *dynamic = match->mapping.data[i].dynamic;
+    if (dynamic == NULL) {
+      continue;
+    }
+    stats->table_bytes += sizeof(dynamic_state_t) + dynamic->extracted_length;
+    add_regex_stats(dynamic->regex, stats);
+  }
+}
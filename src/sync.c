@@ -0,0 +1,80 @@
+/* Copyright (C) 2026 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "highlight.h"
+#include "internal.h"
+
+/** Check the sync patterns against a single line. Returns the index of the first matching
+    pattern, or -1 if none matches. */
+static int match_sync(t3_highlight_match_t *match, const char *text, size_t size) {
+  const t3_highlight_t *highlight = match->highlight;
+  size_t i;
+
+  for (i = 0; i < highlight->sync_patterns.used; i++) {
+    if (pcre2_match_8(highlight->sync_patterns.data[i].regex, (PCRE2_SPTR8)text, size, 0, 0,
+                      match->match_data, match->match_context) >= 0) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+int t3_highlight_sync(t3_highlight_match_t *match, size_t line,
+                      const char *(*get_line)(void *data, size_t line, size_t *size),
+                      void *data, size_t *sync_line) {
+  const t3_highlight_t *highlight = match->highlight;
+  size_t first = line > highlight->sync_max_lines ? line - highlight->sync_max_lines : 0;
+  size_t current;
+
+  if (highlight->line_end_states == 0) {
+    *sync_line = line;
+    t3_highlight_reset(match, 0);
+    return T3_HIGHLIGHT_SYNC_FOUND;
+  }
+
+  for (current = line; current > 0; current--) {
+    const char *text;
+    size_t size;
+    int idx;
+
+    if ((text = get_line(data, current, &size)) != NULL &&
+        (idx = match_sync(match, text, size)) >= 0) {
+      state_snapshot_t state;
+
+      *sync_line = current;
+      if (highlight->sync_patterns.data[idx].state == 0) {
+        t3_highlight_reset(match, 0);
+        return T3_HIGHLIGHT_SYNC_FOUND;
+      }
+      state.highlight_state = highlight->sync_patterns.data[idx].state;
+      state.extra = NULL;
+      state.dynamic_pattern = NULL;
+      state.extracted = NULL;
+      state.extracted_length = 0;
+      return _t3_highlight_restore_state(match, &state, 1) ? T3_HIGHLIGHT_SYNC_FOUND
+                                                            : T3_HIGHLIGHT_SYNC_ERROR;
+    }
+    if (current == first) {
+      /* Highlighting from here gives the best chance of getting back on track before
+         reaching line. */
+      *sync_line = current;
+      t3_highlight_reset(match, 0);
+      return T3_HIGHLIGHT_SYNC_GUESS;
+    }
+  }
+
+  /* The start of the text is always in the outermost state. */
+  *sync_line = 0;
+  t3_highlight_reset(match, 0);
+  return T3_HIGHLIGHT_SYNC_FOUND;
+}
@@ -0,0 +1,370 @@
+/* Copyright (C) 2026 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "highlight.h"
+#include "internal.h"
+
+/* The time the worker holds the lock for a single slice, in nanoseconds. */
+#define WORKER_SLICE_NSEC 1000000
+/* The time the worker pauses between slices once the visible lines are done, in
+   nanoseconds. */
+#define WORKER_BACKGROUND_PAUSE_NSEC 1000000
+/* The number of lines outside the visible range for which the result is collected before
+   reporting it. */
+#define WORKER_BATCH_LINES 1024
+
+typedef struct {
+  /* The state at the start of the line, or -1 if not known. */
+  int state;
+  /* Set if the line changed since it was last highlighted. */
+  t3_bool changed;
+} line_info_t;
+
+struct t3_highlight_worker_t {
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  /* Protects hosts_waiting. The worker waits on hosts_done between slices until no host is
+     waiting for the lock any more. */
+  pthread_mutex_t wait_lock;
+  pthread_cond_t hosts_done;
+  int hosts_waiting;
+  pthread_t thread;
+  t3_highlight_match_t *match;
+  t3_highlight_cursor_t *cursor;
+  const t3_highlight_worker_callbacks_t *callbacks;
+  void *data;
+  /* The states of the first valid lines are correct for the current document. Those of the
+     lines after that were correct before the last edits. Once the state at the start of such
+     a line turns out to be unchanged, the following lines up to the next changed line need
+     not be highlighted again. The worker continues highlighting at line valid - 1. */
+  VECTOR(line_info_t) lines;
+  size_t valid;
+  size_t viewport_first, viewport_last;
+  /* Lines which have been highlighted, but have not been reported through lines_done. */
+  size_t done_first, done_last;
+  /* Set when the state of a line turned out to be unchanged, or memory ran out. */
+  t3_bool converged, failed;
+  t3_bool complete, quit;
+};
+
+static const char *worker_get_line(void *data, size_t line, size_t *size) {
+  t3_highlight_worker_t *worker = data;
+  return worker->callbacks->get_line(worker->data, line, size);
+}
+
+static void worker_section(void *data, size_t line, size_t start, size_t end, int attribute) {
+  t3_highlight_worker_t *worker = data;
+  worker->callbacks->section(worker->data, line, start, end, attribute);
+}
+
+/** Record the state at the start of the line following @p line. */
+static void worker_end_line(void *data, size_t line, int state) {
+  t3_highlight_worker_t *worker = data;
+  size_t next = line + 1;
+
+  worker->lines.data[line].changed = t3_false;
+  if (worker->done_first == worker->done_last) {
+    worker->done_first = line;
+  }
+  worker->done_last = next;
+
+  if (next == worker->lines.used) {
+    if (!VECTOR_RESERVE(worker->lines)) {
+      worker->failed = t3_true;
+      t3_highlight_cursor_cancel(worker->cursor);
+      return;
+    }
+    VECTOR_LAST(worker->lines).state = state;
+    VECTOR_LAST(worker->lines).changed = t3_false;
+    worker->valid = next + 1;
+    return;
+  }
+
+  if (worker->lines.data[next].state == state) {
+    /* The lines up to the next changed line will be highlighted the same as before. */
+    for (; next < worker->lines.used && !worker->lines.data[next].changed; next++) {
+    }
+    worker->valid = next == worker->lines.used ? next : next + 1;
+    worker->converged = t3_true;
+    t3_highlight_cursor_cancel(worker->cursor);
+    return;
+  }
+  worker->lines.data[next].state = state;
+  worker->valid = next + 1;
+}
+
+static const t3_highlight_cursor_callbacks_t worker_callbacks = {worker_get_line, worker_section,
+                                                                  worker_end_line};
+
+static void report_done(t3_highlight_worker_t *worker) {
+  if (worker->done_first == worker->done_last) {
+    return;
+  }
+  if (worker->callbacks->lines_done != NULL) {
+    worker->callbacks->lines_done(worker->data, worker->done_first, worker->done_last);
+  }
+  worker->done_first = worker->done_last = 0;
+}
+
+/** Wait for WORKER_BACKGROUND_PAUSE_NSEC, or until the visible lines need highlighting. */
+static void background_pause(t3_highlight_worker_t *worker) {
+  struct timespec deadline;
+
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_nsec += WORKER_BACKGROUND_PAUSE_NSEC;
+  if (deadline.tv_nsec >= 1000000000L) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+  while (!worker->quit && worker->valid > worker->viewport_last) {
+    if (pthread_cond_timedwait(&worker->wake, &worker->lock, &deadline) == ETIMEDOUT) {
+      break;
+    }
+  }
+}
+
+static void *worker_thread(void *data) {
+  static const t3_highlight_slice_t slice = {0, 0, WORKER_SLICE_NSEC};
+  t3_highlight_worker_t *worker = data;
+
+  pthread_mutex_lock(&worker->lock);
+  for (;;) {
+    int result;
+
+    while (!worker->quit && (worker->complete || worker->failed)) {
+      pthread_cond_wait(&worker->wake, &worker->lock);
+    }
+    if (worker->quit) {
+      break;
+    }
+
+    result = t3_highlight_cursor_run(worker->cursor, &slice);
+    if (result == T3_HIGHLIGHT_RUN_DONE) {
+      worker->lines.used = worker->valid;
+      worker->complete = t3_true;
+    }
+    if (worker->converged) {
+      worker->converged = t3_false;
+      t3_highlight_cursor_seek(worker->cursor, worker->valid - 1,
+                               worker->lines.data[worker->valid - 1].state);
+    }
+
+    /* Report results for the visible lines immediately, but collect those for the rest of
+       the document, to limit the overhead of reporting. */
+    if ((worker->done_first < worker->viewport_last &&
+         worker->done_last > worker->viewport_first) ||
+        result != T3_HIGHLIGHT_RUN_PAUSED ||
+        worker->done_last - worker->done_first >= WORKER_BATCH_LINES) {
+      report_done(worker);
+    }
+
+    /* Let any host waiting to lock the worker in before starting the next slice. Simply
+       unlocking and locking again does not guarantee that, as the worker may well get the
+       lock back before the waiting thread is scheduled. */
+    pthread_mutex_unlock(&worker->lock);
+    pthread_mutex_lock(&worker->wait_lock);
+    while (worker->hosts_waiting > 0) {
+      pthread_cond_wait(&worker->hosts_done, &worker->wait_lock);
+    }
+    pthread_mutex_unlock(&worker->wait_lock);
+    pthread_mutex_lock(&worker->lock);
+
+    /* Once the visible lines are done, the rest of the document is less urgent. Pause
+       between slices, unless the viewport moves to lines that are not done or the document
+       is edited. */
+    if (!worker->complete && worker->valid > worker->viewport_last) {
+      background_pause(worker);
+    }
+  }
+  pthread_mutex_unlock(&worker->lock);
+  return NULL;
+}
+
+t3_highlight_worker_t *t3_highlight_new_worker(const t3_highlight_t *highlight,
+                                               const t3_highlight_worker_callbacks_t *callbacks,
+                                               void *data) {
+  t3_highlight_worker_t *result = malloc(sizeof(t3_highlight_worker_t));
+  if (result == NULL) {
+    return NULL;
+  }
+
+  result->callbacks = callbacks;
+  result->data = data;
+  result->valid = 1;
+  result->viewport_first = 0;
+  result->viewport_last = 0;
+  result->done_first = 0;
+  result->done_last = 0;
+  result->converged = t3_false;
+  result->failed = t3_false;
+  result->complete = t3_false;
+  result->quit = t3_false;
+  result->hosts_waiting = 0;
+  result->cursor = NULL;
+  VECTOR_INIT(result->lines);
+  if ((result->match = t3_highlight_new_match(highlight)) == NULL ||
+      (result->cursor = t3_highlight_new_cursor(result->match, &worker_callbacks, result)) ==
+          NULL ||
+      !VECTOR_RESERVE(result->lines)) {
+    goto return_error;
+  }
+  VECTOR_LAST(result->lines).state = 0;
+  VECTOR_LAST(result->lines).changed = t3_false;
+
+  if (pthread_mutex_init(&result->lock, NULL) != 0) {
+    goto return_error;
+  }
+  if (pthread_cond_init(&result->wake, NULL) != 0) {
+    pthread_mutex_destroy(&result->lock);
+    goto return_error;
+  }
+  if (pthread_mutex_init(&result->wait_lock, NULL) != 0) {
+    pthread_cond_destroy(&result->wake);
+    pthread_mutex_destroy(&result->lock);
+    goto return_error;
+  }
+  if (pthread_cond_init(&result->hosts_done, NULL) != 0) {
+    pthread_mutex_destroy(&result->wait_lock);
+    pthread_cond_destroy(&result->wake);
+    pthread_mutex_destroy(&result->lock);
+    goto return_error;
+  }
+  if (pthread_create(&result->thread, NULL, worker_thread, result) != 0) {
+    pthread_cond_destroy(&result->hosts_done);
+    pthread_mutex_destroy(&result->wait_lock);
+    pthread_cond_destroy(&result->wake);
+    pthread_mutex_destroy(&result->lock);
+    goto return_error;
+  }
+  return result;
+
+return_error:
+  t3_highlight_free_cursor(result->cursor);
+  t3_highlight_free_match(result->match);
+  VECTOR_FREE(result->lines);
+  free(result);
+  return NULL;
+}
+
+void t3_highlight_free_worker(t3_highlight_worker_t *worker) {
+  if (worker == NULL) {
+    return;
+  }
+  t3_highlight_worker_lock(worker);
+  worker->quit = t3_true;
+  pthread_cond_signal(&worker->wake);
+  pthread_mutex_unlock(&worker->lock);
+  pthread_join(worker->thread, NULL);
+
+  pthread_cond_destroy(&worker->hosts_done);
+  pthread_mutex_destroy(&worker->wait_lock);
+  pthread_cond_destroy(&worker->wake);
+  pthread_mutex_destroy(&worker->lock);
+  t3_highlight_free_cursor(worker->cursor);
+  t3_highlight_free_match(worker->match);
+  VECTOR_FREE(worker->lines);
+  free(worker);
+}
+
+void t3_highlight_worker_lock(t3_highlight_worker_t *worker) {
+  pthread_mutex_lock(&worker->wait_lock);
+  worker->hosts_waiting++;
+  pthread_mutex_unlock(&worker->wait_lock);
+
+  pthread_mutex_lock(&worker->lock);
+
+  pthread_mutex_lock(&worker->wait_lock);
+  if (--worker->hosts_waiting == 0) {
+    pthread_cond_signal(&worker->hosts_done);
+  }
+  pthread_mutex_unlock(&worker->wait_lock);
+}
+
+void t3_highlight_worker_unlock(t3_highlight_worker_t *worker) {
+  pthread_mutex_unlock(&worker->lock);
+}
+
+void t3_highlight_worker_edit(t3_highlight_worker_t *worker, size_t line, size_t removed,
+                              size_t inserted) {
+  size_t used = worker->lines.used, new_used, i;
+
+  /* The line the worker was highlighting has only been reported partially, so it must not be
+     skipped when the state at the start of an earlier line turns out to be unchanged. */
+  if (worker->valid - 1 >= line + removed && worker->valid - 1 < used) {
+    worker->lines.data[worker->valid - 1].changed = t3_true;
+  }
+
+  if (line >= used) {
+    /* Nothing is known about these lines yet. */
+  } else if (line + removed >= used) {
+    /* The edit extends past the known lines. Only the state at the start of line is still
+       known. */
+    worker->lines.used = line + 1;
+    worker->lines.data[line].changed = t3_true;
+  } else if (inserted == 0) {
+    /* Line now holds the first line after the removed ones, which starts in the state of the
+       first removed line. It was highlighted starting in the state that is dropped here, so
+       it must be highlighted again. */
+    worker->lines.data[line].changed = t3_true;
+    memmove(worker->lines.data + line + 1, worker->lines.data + line + removed + 1,
+            (used - line - removed - 1) * sizeof(line_info_t));
+    worker->lines.used -= removed;
+  } else {
+    /* The state recorded for the first line after the replaced ones is kept, to detect that
+       highlighting after the edit continues as before. */
+    new_used = used - removed + inserted;
+    while (worker->lines.used < new_used && VECTOR_RESERVE(worker->lines)) {
+    }
+    if (worker->lines.used >= new_used) {
+      memmove(worker->lines.data + line + inserted, worker->lines.data + line + removed,
+              (used - line - removed) * sizeof(line_info_t));
+      for (i = line + 1; i < line + inserted; i++) {
+        worker->lines.data[i].state = -1;
+        worker->lines.data[i].changed = t3_true;
+      }
+      worker->lines.used = new_used;
+    } else {
+      /* Out of memory. Forget about the lines after the edit instead. */
+      worker->lines.used = line + 1;
+    }
+    worker->lines.data[line].changed = t3_true;
+  }
+
+  if (worker->valid > line) {
+    worker->valid = line + 1;
+    t3_highlight_cursor_seek(worker->cursor, line, worker->lines.data[line].state);
+  }
+  /* Lines from the changed line onwards may have moved, so only report those before it. */
+  if (worker->done_last > line) {
+    worker->done_last = line > worker->done_first ? line : worker->done_first;
+  }
+  worker->complete = t3_false;
+  worker->failed = t3_false;
+  pthread_cond_signal(&worker->wake);
+}
+
+void t3_highlight_worker_set_viewport(t3_highlight_worker_t *worker, size_t first, size_t last) {
+  worker->viewport_first = first;
+  worker->viewport_last = last;
+  pthread_cond_signal(&worker->wake);
+}
+
+size_t t3_highlight_worker_get_done(const t3_highlight_worker_t *worker) {
+  return worker->valid - 1;
+}
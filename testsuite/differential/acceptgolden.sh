@@ -0,0 +1,15 @@
+#!/bin/bash
+
+# Accept the token streams from the last test run as the new golden outputs. Only use this
+# after verifying that the differences are intended.
+
+cd `dirname $0`
+
+if [ $# -eq 0 ] ; then
+	echo "Usage: acceptgolden.sh <language>..."
+	exit 1
+fi
+
+for i in "$@" ; do
+	cp "work/$i.tokens" "golden/$i.tokens"
+done
@@ -0,0 +1,1212 @@
+/* Copyright (C) 2026 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/* Differential tester for the matcher. The input is highlighted with the reference matcher,
+   t3_highlight_match on whole lines, and with each alternative way of matching. The token
+   streams, including the state at the end of each line, must be identical. The stream of the
+   reference matcher is written to standard output, such that it can be compared to a golden
+   output. */
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <t3highlight/highlight.h>
+
+/* This header must be included after all the others to prevent issues with the
+   definition of _. */
+/* clang-format off */
+#include "optionMacros.h"
+/* clang-format on */
+
+#define MAX_STYLES 256
+
+typedef struct {
+  char *data;
+  size_t size, allocated;
+} buffer_t;
+
+/* A way of matching the lines of the input. Each appends the token stream for one line to
+   the output buffer. */
+typedef struct {
+  const char *name;
+  void (*match_line)(t3_highlight_match_t *match, const char *line, size_t size,
+                     buffer_t *out);
+  /* Called before the first line. May be NULL. */
+  void (*setup)(t3_highlight_match_t *match);
+} matcher_t;
+
+/* Attribute 0 is used for text without a style of its own. */
+static const char *styles[MAX_STYLES] = {"normal"};
+static int styles_used = 1;
+
+static long option_seed = -1;
+static long option_lines = 1000;
+static t3_bool option_sync;
+static t3_bool option_line_independent;
+
+static const char *language_file;
+static const char *input_file;
+
+/* The state at the end of the previous line, for the restart matcher. */
+static int restart_state;
+
+/** Alert the user of a fatal error and quit.
+    @param fmt The format string for the message. See fprintf(3) for details.
+    @param ... The arguments for printing.
+*/
+#ifdef __GNUC__
+void fatal(const char *fmt, ...) __attribute__((noreturn));
+#endif
+void fatal(const char *fmt, ...) {
+  va_list args;
+
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  exit(EXIT_FAILURE);
+}
+
+/* clang-format off */
+static PARSE_FUNCTION(parse_args)
+  OPTIONS
+    OPTION('g', "generate", REQUIRED_ARG)
+      PARSE_INT(option_seed, 0, 0x7fffffffL);
+    END_OPTION
+    OPTION('n', "lines", REQUIRED_ARG)
+      PARSE_INT(option_lines, 1, 100000000L);
+    END_OPTION
+    OPTION('i', "line-independent", NO_ARG)
+      option_line_independent = t3_true;
+    END_OPTION
+    OPTION('s', "sync", NO_ARG)
+      option_sync = t3_true;
+    END_OPTION
+    OPTION('h', "help", NO_ARG)
+      printf("Usage: difftest [<options>] <language file> <input>\n"
+        "  -g<seed>,--generate=<seed>      Test random lines made from <input>\n"
+        "  -i,--line-independent           Expect every line to end in the initial state\n"
+        "  -n<lines>,--lines=<lines>       Generate <lines> lines (default 1000)\n"
+        "  -s,--sync                       Write the results of t3_highlight_sync instead of\n"
+        "                                  the token stream\n"
+      );
+      exit(EXIT_SUCCESS);
+    END_OPTION
+    DOUBLE_DASH
+      NO_MORE_OPTIONS;
+    END_OPTION
+
+    fatal(_("No such option %.*s\n"), OPTPRARG);
+  NO_OPTION
+    if (language_file == NULL) {
+      language_file = optcurrent;
+    } else if (input_file == NULL) {
+      input_file = optcurrent;
+    } else {
+      fatal(_("Too many arguments\n"));
+    }
+  END_OPTIONS
+
+  if (input_file == NULL) {
+    fatal(_("Usage: difftest [<options>] <language file> <input>\n"));
+  }
+END_FUNCTION
+/* clang-format on */
+
+static void append(buffer_t *buffer, const char *data, size_t size) {
+  if (size == 0) {
+    return;
+  }
+  if (buffer->allocated - buffer->size < size) {
+    size_t new_allocated = buffer->allocated == 0 ? 65536 : buffer->allocated;
+    char *new_data;
+
+    while (new_allocated - buffer->size < size) {
+      new_allocated *= 2;
+    }
+    if ((new_data = realloc(buffer->data, new_allocated)) == NULL) {
+      fatal(_("Out of memory\n"));
+    }
+    buffer->data = new_data;
+    buffer->allocated = new_allocated;
+  }
+  memcpy(buffer->data + buffer->size, data, size);
+  buffer->size += size;
+}
+
+static void append_format(buffer_t *buffer, const char *fmt, ...) {
+  char text[512];
+  va_list args;
+
+  va_start(args, fmt);
+  vsnprintf(text, sizeof(text), fmt, args);
+  va_end(args);
+  append(buffer, text, strlen(text));
+}
+
+/** Map each style name to a distinct number, such that the names can be printed. */
+static int map_style(void *data, const char *name) {
+  int i;
+
+  for (i = 0; i < styles_used; i++) {
+    if (strcmp(styles[i], name) == 0) {
+      return i;
+    }
+  }
+  if (styles_used == MAX_STYLES) {
+    fatal(_("Too many styles\n"));
+  }
+  if ((styles[styles_used] = strdup(name)) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  return styles_used++;
+}
+
+static const char *style_name(int attribute) {
+  return attribute >= 0 && attribute < styles_used ? styles[attribute] : "?";
+}
+
+/** Add a match result to the token stream. The begin section starts at @p start. */
+static void append_match(buffer_t *out, t3_highlight_match_t *match, size_t start) {
+  append_format(out, " %zu %s %zu %s %zu;", start,
+                style_name(t3_highlight_get_begin_attr(match)),
+                t3_highlight_get_match_start(match),
+                style_name(t3_highlight_get_match_attr(match)), t3_highlight_get_end(match));
+}
+
+/** Add the final part of a line to the token stream. */
+static void append_end(buffer_t *out, t3_highlight_match_t *match, size_t start) {
+  append_format(out, " %zu %s %zu | %d\n", start, style_name(t3_highlight_get_begin_attr(match)),
+                t3_highlight_get_match_start(match), t3_highlight_get_state(match));
+}
+
+/** The reference matcher. */
+static void match_whole(t3_highlight_match_t *match, const char *line, size_t size,
+                        buffer_t *out) {
+  t3_highlight_next_line(match);
+  while (t3_highlight_match(match, line, size)) {
+    append_match(out, match, t3_highlight_get_start(match));
+  }
+  append_end(out, match, t3_highlight_get_start(match));
+}
+
+/** Match the line in chunks of @p chunk_size bytes, using t3_highlight_match_chunk. */
+static void match_chunked(t3_highlight_match_t *match, const char *line, size_t size,
+                          size_t chunk_size, buffer_t *out) {
+  size_t offset = 0, available = chunk_size < size ? chunk_size : size;
+  /* Start of the section that is split by requests for more data. */
+  size_t start = (size_t)-1;
+
+  t3_highlight_next_line(match);
+  for (;;) {
+    int result = t3_highlight_match_chunk(match, line + offset, available - offset, offset,
+                                          available == size);
+    if (result == T3_HIGHLIGHT_CHUNK_MORE) {
+      if (start == (size_t)-1) {
+        start = t3_highlight_get_start(match);
+      }
+      offset = t3_highlight_get_chunk_keep(match);
+      available = size - available > chunk_size ? available + chunk_size : size;
+      continue;
+    }
+    if (start == (size_t)-1) {
+      start = t3_highlight_get_start(match);
+    }
+    if (result == T3_HIGHLIGHT_CHUNK_MATCH) {
+      append_match(out, match, start);
+    } else if (result == T3_HIGHLIGHT_CHUNK_END) {
+      append_end(out, match, start);
+      return;
+    } else {
+      append_format(out, " invalid\n");
+      return;
+    }
+    start = (size_t)-1;
+  }
+}
+
+static void match_chunked_1(t3_highlight_match_t *match, const char *line, size_t size,
+                            buffer_t *out) {
+  match_chunked(match, line, size, 1, out);
+}
+
+static void match_chunked_7(t3_highlight_match_t *match, const char *line, size_t size,
+                            buffer_t *out) {
+  match_chunked(match, line, size, 7, out);
+}
+
+static void match_chunked_64(t3_highlight_match_t *match, const char *line, size_t size,
+                             buffer_t *out) {
+  match_chunked(match, line, size, 64, out);
+}
+
+/** Use t3_highlight_reset with the state of the previous line, instead of next_line. */
+static void match_restart(t3_highlight_match_t *match, const char *line, size_t size,
+                          buffer_t *out) {
+  t3_highlight_reset(match, restart_state);
+  while (t3_highlight_match(match, line, size)) {
+    append_match(out, match, t3_highlight_get_start(match));
+  }
+  append_end(out, match, t3_highlight_get_start(match));
+  restart_state = t3_highlight_get_state(match);
+}
+
+static void setup_restart(t3_highlight_match_t *match) { restart_state = 0; }
+
+static void trace_state(void *data, int state) {}
+static void trace_try(void *data, int pattern, size_t position) {}
+static void trace_match(void *data, int pattern, size_t start, size_t end) {}
+static void trace_create(void *data, int state, int parent) {}
+
+/** Enable profiling and tracing, which use a separate code path to try patterns. */
+static void setup_instrumented(t3_highlight_match_t *match) {
+  static const t3_highlight_trace_t trace = {trace_state, trace_state, trace_try, trace_match,
+                                             trace_create};
+
+  if (!t3_highlight_set_profile(match, t3_true)) {
+    fatal(_("Out of memory\n"));
+  }
+  t3_highlight_set_trace(match, &trace, NULL);
+}
+
+/* The first entry is the reference matcher. Alternative matchers are added here. */
+static const matcher_t matchers[] = {
+    {"reference", match_whole, NULL},
+    {"chunked-1", match_chunked_1, NULL},
+    {"chunked-7", match_chunked_7, NULL},
+    {"chunked-64", match_chunked_64, NULL},
+    {"restart", match_restart, setup_restart},
+    {"instrumented", match_whole, setup_instrumented},
+};
+
+static void read_file(const char *name, buffer_t *buffer) {
+  char block[65536];
+  size_t bytes_read;
+  FILE *file;
+
+  if ((file = fopen(name, "rb")) == NULL) {
+    fatal(_("Can't open '%s': %s\n"), name, strerror(errno));
+  }
+  while ((bytes_read = fread(block, 1, sizeof(block), file)) > 0) {
+    append(buffer, block, bytes_read);
+  }
+  if (ferror(file)) {
+    fatal(_("Error reading '%s': %s\n"), name, strerror(errno));
+  }
+  fclose(file);
+}
+
+/** Return a pseudo random number in the range [0, @p range). */
+static unsigned long next_random(unsigned long *state, unsigned long range) {
+  *state = *state * 6364136223846793005UL + 1442695040888963407UL;
+  return (*state >> 33) % range;
+}
+
+/** Generate random lines, consisting of pieces of @p sample and random characters. Pieces of
+    the sample make it likely that patterns match, while the random characters and the
+    arbitrary boundaries of the pieces exercise the less common paths. */
+static void generate(const buffer_t *sample, unsigned long seed, buffer_t *result) {
+  static const char characters[] = "\t \"'`\\/*#<>{}()[]$@%&!?=:;,.-+_0123456789azAZ\xc3\xa9";
+  unsigned long state = seed;
+  long line;
+
+  for (line = 0; line < option_lines; line++) {
+    int pieces = next_random(&state, 8), i;
+
+    for (i = 0; i < pieces; i++) {
+      if (sample->size > 0 && next_random(&state, 4) != 0) {
+        size_t start = next_random(&state, sample->size);
+        size_t length = next_random(&state, 40), j;
+
+        for (j = start; j < sample->size && j - start < length && sample->data[j] != '\n'; j++) {
+        }
+        append(result, sample->data + start, j - start);
+      } else {
+        append(result, characters + next_random(&state, sizeof(characters) - 1), 1);
+      }
+    }
+    append(result, "\n", 1);
+  }
+}
+
+static void run_matcher(const t3_highlight_t *highlight, const matcher_t *matcher,
+                        const buffer_t *input, buffer_t *out) {
+  t3_highlight_match_t *match;
+  const char *line = input->data, *end = input->data + input->size;
+  size_t line_number = 1;
+
+  if ((match = t3_highlight_new_match(highlight)) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  if (matcher->setup != NULL) {
+    matcher->setup(match);
+  }
+  for (; line < end; line_number++) {
+    const char *newline = memchr(line, '\n', end - line);
+    size_t size = newline == NULL ? (size_t)(end - line) : (size_t)(newline - line);
+
+    append_format(out, "%zu:", line_number);
+    matcher->match_line(match, line, size, out);
+    line += size + 1;
+  }
+  t3_highlight_free_match(match);
+}
+
+/* Section streams are used to compare t3_highlight_cursor_run, which reports sections rather
+   than match results, with the reference matcher. Each line is written as the end position and
+   style of each maximal run of text with a single style, followed by the state at the end of
+   the line if it is not negative. */
+typedef struct {
+  buffer_t *out;
+  size_t start, end;
+  int attribute;
+} section_stream_t;
+
+static void add_section(section_stream_t *stream, size_t start, size_t end, int attribute) {
+  if (start == end) {
+    return;
+  }
+  if (stream->attribute != attribute || stream->end != start) {
+    if (stream->attribute >= 0) {
+      append_format(stream->out, " %zu %s", stream->end, style_name(stream->attribute));
+    }
+    stream->attribute = attribute;
+  }
+  stream->end = end;
+}
+
+static void end_section_line(section_stream_t *stream, const char *result, int state) {
+  if (stream->attribute >= 0) {
+    append_format(stream->out, " %zu %s", stream->end, style_name(stream->attribute));
+  }
+  if (state >= 0) {
+    append_format(stream->out, "%s | %d\n", result, state);
+  } else {
+    append_format(stream->out, "%s\n", result);
+  }
+  stream->attribute = -1;
+  stream->end = 0;
+}
+
+/** Match a single line as the reference matcher does, and append it to a section stream. */
+static void match_section_line(t3_highlight_match_t *match, const char *line, size_t size,
+                               section_stream_t *stream, t3_bool with_state) {
+  int result;
+
+  t3_highlight_next_line(match);
+  /* This is t3_highlight_match, but distinguishes invalid lines from the end of the line. */
+  while ((result = t3_highlight_match_chunk(match, line, size, 0, t3_true)) ==
+         T3_HIGHLIGHT_CHUNK_MATCH) {
+    add_section(stream, t3_highlight_get_start(match), t3_highlight_get_match_start(match),
+                t3_highlight_get_begin_attr(match));
+    add_section(stream, t3_highlight_get_match_start(match), t3_highlight_get_end(match),
+                t3_highlight_get_match_attr(match));
+  }
+  if (result == T3_HIGHLIGHT_CHUNK_ERROR) {
+    end_section_line(stream, " invalid", with_state ? t3_highlight_get_state(match) : -1);
+  } else {
+    add_section(stream, t3_highlight_get_start(match), t3_highlight_get_match_start(match),
+                t3_highlight_get_begin_attr(match));
+    end_section_line(stream, "", with_state ? t3_highlight_get_state(match) : -1);
+  }
+}
+
+/** The reference matcher, writing a section stream. */
+static void run_sections_reference(const t3_highlight_t *highlight, const buffer_t *input,
+                                   t3_bool with_state, buffer_t *out) {
+  section_stream_t stream = {out, 0, 0, -1};
+  t3_highlight_match_t *match;
+  const char *line = input->data, *end = input->data + input->size;
+
+  if ((match = t3_highlight_new_match(highlight)) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  for (; line < end;) {
+    const char *newline = memchr(line, '\n', end - line);
+    size_t size = newline == NULL ? (size_t)(end - line) : (size_t)(newline - line);
+
+    match_section_line(match, line, size, &stream, with_state);
+    line += size + 1;
+  }
+  t3_highlight_free_match(match);
+}
+
+typedef struct {
+  section_stream_t stream;
+  const buffer_t *input;
+  /* The start of each line in the input, and one past the end of the last line. */
+  size_t *line_starts;
+  size_t lines;
+  /* The end of a line is only written once it is known whether the line was invalid, which
+     t3_highlight_cursor_run reports after calling end_line. A negative state means that no
+     line end is pending. */
+  int pending_state;
+} cursor_data_t;
+
+static void flush_line_end(cursor_data_t *cursor_data, t3_bool invalid) {
+  if (cursor_data->pending_state >= 0) {
+    end_section_line(&cursor_data->stream, invalid ? " invalid" : "", cursor_data->pending_state);
+    cursor_data->pending_state = -1;
+  }
+}
+
+/** Fill the line_starts and lines members of @p cursor_data. The input is treated as if it
+    ends in a newline, like the other matchers do. */
+static void find_line_starts(cursor_data_t *cursor_data) {
+  const buffer_t *input = cursor_data->input;
+  size_t i;
+
+  if ((cursor_data->line_starts = malloc((input->size + 2) * sizeof(size_t))) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  cursor_data->line_starts[0] = 0;
+  cursor_data->lines = 0;
+  for (i = 0; i < input->size; i++) {
+    if (input->data[i] == '\n') {
+      cursor_data->line_starts[++cursor_data->lines] = i + 1;
+    }
+  }
+  if (cursor_data->line_starts[cursor_data->lines] < input->size) {
+    cursor_data->line_starts[++cursor_data->lines] = input->size + 1;
+  }
+}
+
+static const char *cursor_get_line(void *data, size_t line, size_t *size) {
+  cursor_data_t *cursor_data = data;
+
+  if (line >= cursor_data->lines) {
+    return NULL;
+  }
+  *size = cursor_data->line_starts[line + 1] - cursor_data->line_starts[line] - 1;
+  return cursor_data->input->data + cursor_data->line_starts[line];
+}
+
+static void cursor_section(void *data, size_t line, size_t start, size_t end, int attribute) {
+  flush_line_end(data, t3_false);
+  add_section(&((cursor_data_t *)data)->stream, start, end, attribute);
+}
+
+static void cursor_end_line(void *data, size_t line, int state) {
+  flush_line_end(data, t3_false);
+  ((cursor_data_t *)data)->pending_state = state;
+}
+
+/** Highlight the input with t3_highlight_cursor_run, in slices of at most @p slice. */
+static void run_sections_cursor(const t3_highlight_t *highlight, const buffer_t *input,
+                                const t3_highlight_slice_t *slice, buffer_t *out) {
+  static const t3_highlight_cursor_callbacks_t callbacks = {cursor_get_line, cursor_section,
+                                                            cursor_end_line};
+  cursor_data_t data = {{out, 0, 0, -1}, input, NULL, 0, -1};
+  t3_highlight_match_t *match;
+  t3_highlight_cursor_t *cursor;
+  int result;
+
+  find_line_starts(&data);
+
+  if ((match = t3_highlight_new_match(highlight)) == NULL ||
+      (cursor = t3_highlight_new_cursor(match, &callbacks, &data)) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  while ((result = t3_highlight_cursor_run(cursor, slice)) != T3_HIGHLIGHT_RUN_DONE) {
+    if (result == T3_HIGHLIGHT_RUN_ERROR) {
+      /* The cursor has already ended the invalid line, and continues with the next. */
+      flush_line_end(&data, t3_true);
+    } else if (result != T3_HIGHLIGHT_RUN_PAUSED) {
+      fatal(_("Unexpected result %d from t3_highlight_cursor_run\n"), result);
+    }
+  }
+  flush_line_end(&data, t3_false);
+  t3_highlight_free_cursor(cursor);
+  t3_highlight_free_match(match);
+  free(data.line_starts);
+}
+
+/* Slices for t3_highlight_cursor_run, which must give the same result as the reference. */
+static const struct {
+  const char *name;
+  t3_highlight_slice_t slice;
+} slices[] = {
+    {"cursor-bytes-1", {1, 0, 0}},
+    {"cursor-bytes-7", {7, 0, 0}},
+    {"cursor-sections-1", {0, 1, 0}},
+    {"cursor-sections-3", {0, 3, 0}},
+    {"cursor-time", {0, 0, 20000}},
+};
+
+/* The document for the worker test, which is edited while the worker highlights it. The
+   sections reported for each line are kept with the line. */
+typedef struct {
+  char *text;
+  size_t size;
+  buffer_t sections;
+} doc_line_t;
+
+typedef struct {
+  doc_line_t *lines;
+  size_t used, allocated;
+} document_t;
+
+typedef struct {
+  size_t start, end;
+  int attribute;
+} section_t;
+
+static const char *worker_get_line(void *data, size_t line, size_t *size) {
+  document_t *document = data;
+
+  if (line >= document->used) {
+    return NULL;
+  }
+  *size = document->lines[line].size;
+  /* Return a valid pointer for empty lines as well. */
+  return document->lines[line].text == NULL ? "" : document->lines[line].text;
+}
+
+static void worker_section(void *data, size_t line, size_t start, size_t end, int attribute) {
+  document_t *document = data;
+  section_t section = {start, end, attribute};
+
+  /* A line is always highlighted from the start, so this is the first section of a line
+     that is highlighted again. */
+  if (start == 0) {
+    document->lines[line].sections.size = 0;
+  }
+  append(&document->lines[line].sections, (const char *)&section, sizeof(section));
+}
+
+static void set_doc_line(doc_line_t *line, const char *text, size_t size) {
+  free(line->text);
+  line->text = NULL;
+  if (size > 0) {
+    if ((line->text = malloc(size)) == NULL) {
+      fatal(_("Out of memory\n"));
+    }
+    memcpy(line->text, text, size);
+  }
+  line->size = size;
+  line->sections.size = 0;
+}
+
+/** Replace @p removed lines at @p line by @p inserted empty lines. */
+static void splice_document(document_t *document, size_t line, size_t removed,
+                            size_t inserted) {
+  size_t i;
+
+  for (i = line; i < line + removed; i++) {
+    free(document->lines[i].text);
+    free(document->lines[i].sections.data);
+  }
+  if (document->used - removed + inserted > document->allocated) {
+    document->allocated = (document->used - removed + inserted) * 2;
+    if ((document->lines = realloc(document->lines, document->allocated * sizeof(doc_line_t))) ==
+        NULL) {
+      fatal(_("Out of memory\n"));
+    }
+  }
+  memmove(document->lines + line + inserted, document->lines + line + removed,
+          (document->used - line - removed) * sizeof(doc_line_t));
+  memset(document->lines + line, 0, inserted * sizeof(doc_line_t));
+  document->used = document->used - removed + inserted;
+}
+
+/** Apply a random edit to @p document, using lines from @p input as new text. */
+static void edit_document(t3_highlight_worker_t *worker, document_t *document,
+                          const document_t *input, unsigned long *random) {
+  size_t line = next_random(random, document->used + 1), removed, inserted, i;
+
+  switch (next_random(random, 4)) {
+    case 0:
+      /* Replace, insert and delete lines. */
+      removed = next_random(random, 4);
+      inserted = next_random(random, 4);
+      break;
+    case 1:
+      /* Split a line, keeping the text. */
+      removed = 1;
+      inserted = 2;
+      break;
+    case 2:
+      /* Join two lines, keeping the text. */
+      removed = 2;
+      inserted = 1;
+      break;
+    default:
+      /* Change a single line. */
+      removed = 1;
+      inserted = 1;
+      break;
+  }
+  if (line + removed > document->used) {
+    removed = document->used - line;
+  }
+
+  if (removed == 1 && inserted == 2) {
+    size_t size = document->lines[line].size, position = next_random(random, size + 1);
+    char *text = document->lines[line].text;
+
+    document->lines[line].text = NULL;
+    splice_document(document, line + 1, 0, 1);
+    set_doc_line(&document->lines[line + 1], text + position, size - position);
+    set_doc_line(&document->lines[line], text, position);
+    free(text);
+  } else if (removed == 2 && inserted == 1) {
+    buffer_t joined = {NULL, 0, 0};
+
+    append(&joined, document->lines[line].text, document->lines[line].size);
+    append(&joined, document->lines[line + 1].text, document->lines[line + 1].size);
+    splice_document(document, line + 1, 1, 0);
+    set_doc_line(&document->lines[line], joined.data, joined.size);
+    free(joined.data);
+  } else {
+    splice_document(document, line, removed, inserted);
+    for (i = line; i < line + inserted; i++) {
+      const doc_line_t *source = &input->lines[next_random(random, input->used)];
+      set_doc_line(&document->lines[i], source->text, source->size);
+    }
+  }
+  t3_highlight_worker_edit(worker, line, removed, inserted);
+}
+
+/** Highlight @p input using a ::t3_highlight_worker_t, while editing it. The final document
+    is stored in @p final, and its section stream in @p out. */
+static void run_worker(const t3_highlight_t *highlight, const buffer_t *input, buffer_t *final,
+                       buffer_t *out) {
+  static const t3_highlight_worker_callbacks_t callbacks = {worker_get_line, worker_section,
+                                                            NULL};
+  static const struct timespec pause = {0, 100000};
+  document_t document = {NULL, 0, 0}, sample = {NULL, 0, 0};
+  section_stream_t stream = {out, 0, 0, -1};
+  unsigned long random = option_seed < 0 ? 1 : (unsigned long)option_seed;
+  t3_highlight_worker_t *worker;
+  const char *line = input->data, *end = input->data + input->size;
+  size_t i;
+  int edit;
+
+  for (; line < end;) {
+    const char *newline = memchr(line, '\n', end - line);
+    size_t size = newline == NULL ? (size_t)(end - line) : (size_t)(newline - line);
+
+    splice_document(&sample, sample.used, 0, 1);
+    set_doc_line(&sample.lines[sample.used - 1], line, size);
+    line += size + 1;
+  }
+  splice_document(&document, 0, 0, sample.used);
+  for (i = 0; i < sample.used; i++) {
+    set_doc_line(&document.lines[i], sample.lines[i].text, sample.lines[i].size);
+  }
+
+  if ((worker = t3_highlight_new_worker(highlight, &callbacks, &document)) == NULL) {
+    fatal(_("Could not start the worker\n"));
+  }
+  t3_highlight_worker_lock(worker);
+  t3_highlight_worker_set_viewport(worker, 0, 50);
+  t3_highlight_worker_unlock(worker);
+  /* Edit the document while the worker is highlighting it, and after it is done. */
+  for (edit = 0; edit < 200; edit++) {
+    t3_highlight_worker_lock(worker);
+    edit_document(worker, &document, &sample, &random);
+    /* Move the viewport now and then, which wakes the worker if it is pausing. */
+    if (next_random(&random, 8) == 0) {
+      size_t first = next_random(&random, document.used + 1);
+      t3_highlight_worker_set_viewport(worker, first, first + 50);
+    }
+    t3_highlight_worker_unlock(worker);
+    if (next_random(&random, 4) == 0) {
+      nanosleep(&pause, NULL);
+    }
+  }
+  for (;;) {
+    size_t done;
+
+    t3_highlight_worker_lock(worker);
+    done = t3_highlight_worker_get_done(worker);
+    t3_highlight_worker_unlock(worker);
+    if (done >= document.used) {
+      break;
+    }
+    nanosleep(&pause, NULL);
+  }
+  t3_highlight_free_worker(worker);
+
+  for (i = 0; i < document.used; i++) {
+    const section_t *sections = (const section_t *)document.lines[i].sections.data;
+    size_t j;
+
+    for (j = 0; j < document.lines[i].sections.size / sizeof(section_t); j++) {
+      add_section(&stream, sections[j].start, sections[j].end, sections[j].attribute);
+    }
+    end_section_line(&stream, "", -1);
+    append(final, document.lines[i].text, document.lines[i].size);
+    append(final, "\n", 1);
+  }
+  splice_document(&document, 0, document.used, 0);
+  splice_document(&sample, 0, sample.used, 0);
+  free(document.lines);
+  free(sample.lines);
+}
+
+/* Checkpoints are made every INDEX_INTERVAL lines, and at most INDEX_MAX_CHECKPOINTS are
+   kept, such that dropping checkpoints is tested as well. Every INDEX_STEP-th line is
+   highlighted starting from the nearest checkpoint. */
+#define INDEX_INTERVAL 3
+#define INDEX_MAX_CHECKPOINTS 8
+#define INDEX_STEP 7
+
+/** Highlight lines starting from the checkpoints in a t3_highlight_index_t, writing the
+    section stream for every INDEX_STEP-th line. The index is written and read back before
+    use. The states are not written, because the state numbers depend on the order in which
+    the states were created. */
+static void run_sections_index(const t3_highlight_t *highlight, const buffer_t *input,
+                               buffer_t *out) {
+  section_stream_t stream = {out, 0, 0, -1};
+  buffer_t scratch = {NULL, 0, 0};
+  section_stream_t scratch_stream = {&scratch, 0, 0, -1};
+  t3_highlight_index_t *index;
+  t3_highlight_match_t *match;
+  size_t *line_starts = NULL, lines = 0, i;
+  const char *line = input->data, *end = input->data + input->size;
+
+  if ((index = t3_highlight_new_index(INDEX_INTERVAL, 0, INDEX_MAX_CHECKPOINTS)) == NULL ||
+      (match = t3_highlight_new_match(highlight)) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  /* Fill the index in a first pass. */
+  for (; line < end; lines++) {
+    const char *newline = memchr(line, '\n', end - line);
+    size_t size = newline == NULL ? (size_t)(end - line) : (size_t)(newline - line);
+
+    if ((line_starts = realloc(line_starts, (lines + 2) * sizeof(size_t))) == NULL) {
+      fatal(_("Out of memory\n"));
+    }
+    line_starts[lines] = line - input->data;
+    t3_highlight_next_line(match);
+    if (!t3_highlight_index_update(index, match, lines, line - input->data)) {
+      fatal(_("Out of memory\n"));
+    }
+    match_section_line(match, line, size, &scratch_stream, t3_false);
+    line += size + 1;
+  }
+  t3_highlight_free_match(match);
+  if (line_starts != NULL) {
+    line_starts[lines] = line - input->data;
+  }
+
+  /* Continue with a copy of the index, which must be equivalent. */
+  {
+    t3_highlight_index_t *copy;
+    size_t size;
+    char *data;
+
+    if ((data = t3_highlight_write_index(index, highlight, &size)) == NULL) {
+      fatal(_("Out of memory\n"));
+    }
+    if ((copy = t3_highlight_read_index(highlight, data, size)) == NULL) {
+      fatal(_("Index could not be read back\n"));
+    }
+    free(data);
+    t3_highlight_free_index(index);
+    index = copy;
+  }
+
+  /* Use a new match, such that the states must be recreated from the checkpoints. */
+  if ((match = t3_highlight_new_match(highlight)) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  for (i = 0; i < lines; i += INDEX_STEP) {
+    size_t checkpoint_line, checkpoint_offset, j;
+
+    if (!t3_highlight_index_seek(index, match, i, &checkpoint_line, &checkpoint_offset)) {
+      fatal(_("Out of memory\n"));
+    }
+    if (checkpoint_offset != line_starts[checkpoint_line]) {
+      fatal(_("Checkpoint for line %zu has offset %zu instead of %zu\n"), checkpoint_line,
+            checkpoint_offset, line_starts[checkpoint_line]);
+    }
+    for (j = checkpoint_line; j <= i; j++) {
+      match_section_line(match, input->data + line_starts[j],
+                         line_starts[j + 1] - line_starts[j] - 1,
+                         j == i ? &stream : &scratch_stream, t3_false);
+    }
+  }
+  t3_highlight_free_match(match);
+  t3_highlight_free_index(index);
+  free(line_starts);
+  free(scratch.data);
+}
+
+/** Check t3_highlight_sync for every line of @p input. When it reports that the state at the
+    start of the returned line is known, highlighting from there must reach the state which the
+    reference matcher has at the start of the line. This relies on the sync patterns of the
+    language file being correct for the input. The result for each line is written to @p log.
+    Returns @c t3_false if a difference was found. */
+static t3_bool run_sync(const t3_highlight_t *highlight, const buffer_t *input, buffer_t *log) {
+  cursor_data_t data = {{NULL, 0, 0, -1}, input, NULL, 0, -1};
+  t3_highlight_match_t *match;
+  t3_bool success = t3_true;
+  int *states;
+  size_t i, j;
+
+  find_line_starts(&data);
+  if ((states = malloc((data.lines + 1) * sizeof(int))) == NULL ||
+      (match = t3_highlight_new_match(highlight)) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  /* The state at the start of each line, according to the reference matcher. */
+  for (i = 0; i < data.lines; i++) {
+    size_t size;
+    const char *line = cursor_get_line(&data, i, &size);
+
+    t3_highlight_next_line(match);
+    states[i] = t3_highlight_get_state(match);
+    while (t3_highlight_match(match, line, size)) {
+    }
+  }
+
+  for (i = 0; i < data.lines; i++) {
+    size_t sync_line;
+    int result = t3_highlight_sync(match, i, cursor_get_line, &data, &sync_line);
+
+    if (result == T3_HIGHLIGHT_SYNC_ERROR) {
+      fatal(_("Out of memory\n"));
+    }
+    append_format(log, "%zu: %s from %zu, state %d\n", i,
+                  result == T3_HIGHLIGHT_SYNC_FOUND ? "found" : "guess", sync_line,
+                  t3_highlight_get_state(match));
+    if (sync_line > i) {
+      fprintf(stderr, "t3_highlight_sync for line %zu returned later line %zu\n", i, sync_line);
+      success = t3_false;
+      continue;
+    }
+    for (j = sync_line; j < i; j++) {
+      size_t size;
+      const char *line = cursor_get_line(&data, j, &size);
+
+      t3_highlight_next_line(match);
+      while (t3_highlight_match(match, line, size)) {
+      }
+    }
+    t3_highlight_next_line(match);
+    if (result == T3_HIGHLIGHT_SYNC_FOUND && t3_highlight_get_state(match) != states[i]) {
+      fprintf(stderr,
+              "t3_highlight_sync for line %zu found line %zu, from which line %zu starts in "
+              "state %d instead of %d\n",
+              i, sync_line, i, t3_highlight_get_state(match), states[i]);
+      success = t3_false;
+    }
+  }
+  t3_highlight_free_match(match);
+  free(states);
+  free(data.line_starts);
+  return success;
+}
+
+/** Check the analysis of the states at the end of a line. Each state at the end of a line of
+    @p input must be reported by t3_highlight_state_can_end_line, and
+    t3_highlight_is_line_independent must return @c option_line_independent. Returns
+    @c t3_false if either does not hold. */
+static t3_bool run_line_ends(const t3_highlight_t *highlight, const buffer_t *input) {
+  cursor_data_t data = {{NULL, 0, 0, -1}, input, NULL, 0, -1};
+  t3_highlight_match_t *match;
+  t3_bool success = t3_true;
+  size_t i;
+
+  if (t3_highlight_is_line_independent(highlight) != option_line_independent) {
+    fprintf(stderr, "t3_highlight_is_line_independent returned %s\n",
+            option_line_independent ? "false" : "true");
+    success = t3_false;
+  }
+
+  find_line_starts(&data);
+  if ((match = t3_highlight_new_match(highlight)) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  for (i = 0; i < data.lines; i++) {
+    size_t size;
+    const char *line = cursor_get_line(&data, i, &size);
+    int state;
+
+    t3_highlight_next_line(match);
+    while (t3_highlight_match(match, line, size)) {
+    }
+    state = t3_highlight_get_state(match);
+    if (!t3_highlight_state_can_end_line(match, state)) {
+      fprintf(stderr, "Line %zu ends in state %d, which can not end a line\n", i + 1, state);
+      success = t3_false;
+    }
+  }
+  t3_highlight_free_match(match);
+  free(data.line_starts);
+  return success;
+}
+
+/* Step limits for the budget test. With these, highlighting is cut short on many lines. */
+static const unsigned long step_limits[] = {1, 4, 16, 64};
+
+/** Append the matches on a line to @p out. Returns the end of the last match, or 0 if there is
+    none, and stores the state after it in @p state. The states are not appended, because
+    states entered with on-entry patterns get a new number each time they are entered. */
+static size_t append_line_matches(t3_highlight_match_t *match, const char *line, size_t size,
+                                  buffer_t *out, int *state) {
+  size_t last_end = 0;
+
+  while (t3_highlight_match(match, line, size)) {
+    append_match(out, match, t3_highlight_get_start(match));
+    *state = t3_highlight_get_state(match);
+    last_end = t3_highlight_get_end(match);
+  }
+  return last_end;
+}
+
+/** Check highlighting with a budget of @p step_limit patterns per line. Each line is first
+    highlighted without a budget, and then again from the same state with the budget. The
+    matches found within the budget must be the first matches found without it. When the budget
+    is exceeded, the rest of the line must be returned as a single section, the budget must
+    stay exceeded until the next line, and the next line must start in the state in which
+    highlighting stopped. Returns @c t3_false if a difference was found. */
+static t3_bool run_budget(const t3_highlight_t *highlight, const buffer_t *input,
+                          unsigned long step_limit) {
+  cursor_data_t data = {{NULL, 0, 0, -1}, input, NULL, 0, -1};
+  t3_highlight_budget_t budget = {0, 0, 0, 0, 0};
+  buffer_t unlimited = {NULL, 0, 0}, limited = {NULL, 0, 0};
+  t3_highlight_match_t *match;
+  const char *error = NULL;
+  int expected_state = 0;
+  size_t i;
+
+  budget.step_limit = step_limit;
+  find_line_starts(&data);
+  if ((match = t3_highlight_new_match(highlight)) == NULL) {
+    fatal(_("Out of memory\n"));
+  }
+  for (i = 0; i < data.lines; i++) {
+    size_t size, last_end;
+    const char *line = cursor_get_line(&data, i, &size);
+    int start_state = t3_highlight_next_line(match);
+
+    if (start_state != expected_state) {
+      error = "the line does not start in the state in which the previous line ended";
+      break;
+    }
+    if (t3_highlight_budget_exceeded(match)) {
+      error = "the budget is still exceeded at the start of the line";
+      break;
+    }
+
+    unlimited.size = 0;
+    if (!t3_highlight_set_budget(match, NULL)) {
+      fatal(_("Out of memory\n"));
+    }
+    expected_state = start_state;
+    append_line_matches(match, line, size, &unlimited, &expected_state);
+    /* The default PCRE2 limits may cut the line short without a budget as well. */
+    if (t3_highlight_budget_exceeded(match)) {
+      continue;
+    }
+
+    limited.size = 0;
+    t3_highlight_reset(match, start_state);
+    if (!t3_highlight_set_budget(match, &budget)) {
+      fatal(_("Out of memory\n"));
+    }
+    expected_state = start_state;
+    last_end = append_line_matches(match, line, size, &limited, &expected_state);
+
+    if (!t3_highlight_budget_exceeded(match)) {
+      if (limited.size != unlimited.size ||
+          (limited.size > 0 && memcmp(limited.data, unlimited.data, limited.size) != 0)) {
+        error = "the result within the budget differs from the result without a budget";
+        break;
+      }
+      continue;
+    }
+
+    if (limited.size > unlimited.size ||
+        (limited.size > 0 && memcmp(limited.data, unlimited.data, limited.size) != 0)) {
+      error = "the matches before the budget was exceeded differ from those without a budget";
+    } else if (t3_highlight_get_start(match) != last_end ||
+               t3_highlight_get_match_start(match) != size ||
+               t3_highlight_get_end(match) != size) {
+      error = "the rest of the line is not returned as a single section";
+    } else if (t3_highlight_get_state(match) != expected_state) {
+      error = "the state changed after the budget was exceeded";
+    } else if (t3_highlight_match(match, line, size) || !t3_highlight_budget_exceeded(match)) {
+      error = "the budget is not exceeded until the next line";
+    }
+    if (error != NULL) {
+      break;
+    }
+  }
+  if (error != NULL) {
+    fprintf(stderr, "Budget of %lu steps, line %zu: %s\n", step_limit, i + 1, error);
+  }
+  t3_highlight_free_match(match);
+  free(unlimited.data);
+  free(limited.data);
+  free(data.line_starts);
+  return error == NULL;
+}
+
+/** Append every @p step-th line of @p in to @p out. */
+static void select_lines(const buffer_t *in, size_t step, buffer_t *out) {
+  const char *line = in->data, *end = in->data + in->size;
+  size_t i;
+
+  for (i = 0; line < end; i++) {
+    const char *newline = memchr(line, '\n', end - line);
+    size_t size = newline == NULL ? (size_t)(end - line) : (size_t)(newline - line + 1);
+
+    if (i % step == 0) {
+      append(out, line, size);
+    }
+    line += size;
+  }
+}
+
+/** Report the first line that differs between @p expected and @p result. */
+static void report_difference(const char *name, const buffer_t *expected,
+                              const buffer_t *result) {
+  size_t i, line_start = 0;
+  const char *expected_end, *result_end;
+
+  for (i = 0; i < expected->size && i < result->size && expected->data[i] == result->data[i];
+       i++) {
+    if (expected->data[i] == '\n') {
+      line_start = i + 1;
+    }
+  }
+  expected_end = memchr(expected->data + line_start, '\n', expected->size - line_start);
+  result_end = memchr(result->data + line_start, '\n', result->size - line_start);
+  fprintf(stderr, "Matcher %s differs from the reference matcher:\n", name);
+  fprintf(stderr, "  reference: %.*s\n",
+          (int)((expected_end == NULL ? expected->data + expected->size : expected_end) -
+                (expected->data + line_start)),
+          expected->data + line_start);
+  fprintf(stderr, "  %s: %.*s\n", name,
+          (int)((result_end == NULL ? result->data + result->size : result_end) -
+                (result->data + line_start)),
+          result->data + line_start);
+}
+
+int main(int argc, char *argv[]) {
+  t3_highlight_error_t error;
+  t3_highlight_t *highlight;
+  buffer_t input = {NULL, 0, 0}, reference = {NULL, 0, 0}, sections = {NULL, 0, 0};
+  size_t i;
+  int result = EXIT_SUCCESS;
+
+  parse_args(argc, argv);
+
+  if ((highlight = t3_highlight_load(language_file, map_style, NULL,
+                                     T3_HIGHLIGHT_VERBOSE_ERROR | T3_HIGHLIGHT_UTF8, &error)) ==
+      NULL) {
+    fatal("%s:%d: %s\n", error.file_name == NULL ? language_file : error.file_name,
+          error.line_number, t3_highlight_strerror(error.error));
+  }
+
+  if (option_seed >= 0) {
+    buffer_t sample = {NULL, 0, 0};
+    read_file(input_file, &sample);
+    generate(&sample, option_seed, &input);
+    free(sample.data);
+  } else {
+    read_file(input_file, &input);
+  }
+
+  run_matcher(highlight, &matchers[0], &input, &reference);
+  for (i = 1; i < sizeof(matchers) / sizeof(matchers[0]); i++) {
+    buffer_t out = {NULL, 0, 0};
+
+    run_matcher(highlight, &matchers[i], &input, &out);
+    if (out.size != reference.size || memcmp(out.data, reference.data, out.size) != 0) {
+      report_difference(matchers[i].name, &reference, &out);
+      result = EXIT_FAILURE;
+    }
+    free(out.data);
+  }
+
+  run_sections_reference(highlight, &input, t3_true, &sections);
+  for (i = 0; i < sizeof(slices) / sizeof(slices[0]); i++) {
+    buffer_t out = {NULL, 0, 0};
+
+    run_sections_cursor(highlight, &input, &slices[i].slice, &out);
+    if (out.size != sections.size || memcmp(out.data, sections.data, out.size) != 0) {
+      report_difference(slices[i].name, &sections, &out);
+      result = EXIT_FAILURE;
+    }
+    free(out.data);
+  }
+
+  {
+    buffer_t expected = {NULL, 0, 0}, out = {NULL, 0, 0};
+
+    sections.size = 0;
+    run_sections_reference(highlight, &input, t3_false, &sections);
+    select_lines(&sections, INDEX_STEP, &expected);
+    run_sections_index(highlight, &input, &out);
+    if (out.size != expected.size || memcmp(out.data, expected.data, out.size) != 0) {
+      report_difference("index", &expected, &out);
+      result = EXIT_FAILURE;
+    }
+    free(expected.data);
+    free(out.data);
+  }
+
+  /* The worker is compared with the reference matcher on the edited document. */
+  {
+    buffer_t final = {NULL, 0, 0}, out = {NULL, 0, 0};
+
+    run_worker(highlight, &input, &final, &out);
+    sections.size = 0;
+    run_sections_reference(highlight, &final, t3_false, &sections);
+    if (out.size != sections.size || memcmp(out.data, sections.data, out.size) != 0) {
+      report_difference("worker", &sections, &out);
+      result = EXIT_FAILURE;
+    }
+    free(final.data);
+    free(out.data);
+  }
+
+  for (i = 0; i < sizeof(step_limits) / sizeof(step_limits[0]); i++) {
+    if (!run_budget(highlight, &input, step_limits[i])) {
+      result = EXIT_FAILURE;
+    }
+  }
+
+  if (!run_line_ends(highlight, &input)) {
+    result = EXIT_FAILURE;
+  }
+
+  {
+    buffer_t log = {NULL, 0, 0};
+
+    if (!run_sync(highlight, &input, &log)) {
+      result = EXIT_FAILURE;
+    }
+    if (option_sync) {
+      fwrite(log.data, 1, log.size, stdout);
+    }
+    free(log.data);
+  }
+
+  /* The golden outputs are only kept for the inputs in the corpus, not for generated ones. */
+  if (option_seed < 0 && !option_sync) {
+    fwrite(reference.data, 1, reference.size, stdout);
+  }
+
+  free(reference.data);
+  free(sections.data);
+  free(input.data);
+  t3_highlight_free(highlight);
+  return result;
+}
@@ -0,0 +1,58 @@
+#!/bin/bash
+
+# Compare the token streams of the alternative matchers with those of the reference matcher,
+# for the benchmark corpus and for generated input. For the corpus, the token stream is also
+# compared with the golden output. The results of t3_highlight_sync for the language files in
+# sync are compared with the expected results.
+
+cd `dirname $0`
+
+make -s difftest || exit 1
+
+[ -d work ] || mkdir work
+
+SEEDS=${SEEDS:-10}
+RETVAL=0
+for i in ../../src/data/*.lang ; do
+	NAME="`basename \"$i\" .lang`"
+	CORPUS="../../src.bench/corpus/$NAME"
+	# Only these language files are expected to end every line in the initial state.
+	case "$NAME" in
+		group|lang|passwd|shadow) INDEPENDENT=-i ;;
+		*) INDEPENDENT= ;;
+	esac
+	if [ ! -f "$CORPUS" ] ; then
+		echo -e "\\033[31;1mNo corpus file for $i\\033[0m"
+		RETVAL=1
+		continue
+	fi
+	if ! ./difftest $INDEPENDENT "$i" "$CORPUS" > "work/$NAME.tokens" ; then
+		RETVAL=1
+	elif ! diff -u "golden/$NAME.tokens" "work/$NAME.tokens" > "work/$NAME.diff" ; then
+		echo -e "\\033[31;1mToken stream for $NAME differs from the golden output\\033[0m"
+		head -20 "work/$NAME.diff"
+		RETVAL=1
+	fi
+	for (( seed = 1 ; seed <= SEEDS ; seed++ )) ; do
+		if ! ./difftest $INDEPENDENT -g$seed "$i" "$CORPUS" ; then
+			echo "  (generated input: difftest $INDEPENDENT -g$seed $i $CORPUS)"
+			RETVAL=1
+		fi
+	done
+done
+
+# The inputs for the sync tests start in known states on the lines matched by the sync patterns.
+for i in sync/*.lang ; do
+	NAME="`basename \"$i\" .lang`"
+	if ! ./difftest --sync "$i" "sync/$NAME.txt" > "work/sync-$NAME.log" ; then
+		RETVAL=1
+	elif ! diff -u "sync/$NAME.log" "work/sync-$NAME.log" ; then
+		echo -e "\\033[31;1mSync results for $NAME differ from the expected results\\033[0m"
+		RETVAL=1
+	fi
+done
+
+if [ "$RETVAL" -eq 0 ] ; then
+	echo "Testsuite passed correctly"
+fi
+exit $RETVAL
@@ -0,0 +1,98 @@
+/* Copyright (C) 2026 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/* Stand-alone driver for the fuzz targets, for use without libFuzzer. Each file named on the
+   command line is passed to the target, or standard input if there are none. This is suitable
+   both for AFL (using @@ or standard input) and for running the regression corpus.
+
+   Inputs that hang inside the library never return to the checks in the target, so an alarm
+   of FUZZ_TIMEOUT seconds (default 60) is set for each input as well. */
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "fuzz.h"
+
+static void alarm_handler(int sig) {
+  static const char message[] = "Timeout: input did not finish within FUZZ_TIMEOUT seconds\n";
+  (void)sig;
+  /* Only async-signal-safe functions may be used here. */
+  if (write(STDERR_FILENO, message, sizeof(message) - 1) < 0) {
+    /* Nothing to do, we abort anyway. */
+  }
+  abort();
+}
+
+static uint8_t *read_input(FILE *file, const char *name, size_t *size) {
+  uint8_t *data = NULL, *new_data;
+  size_t allocated = 0, bytes_read;
+
+  *size = 0;
+  do {
+    if (allocated - *size < 65536) {
+      allocated = allocated == 0 ? 65536 : allocated * 2;
+      if ((new_data = realloc(data, allocated)) == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(EXIT_FAILURE);
+      }
+      data = new_data;
+    }
+    bytes_read = fread(data + *size, 1, allocated - *size, file);
+    *size += bytes_read;
+  } while (bytes_read > 0);
+  if (ferror(file)) {
+    fprintf(stderr, "Error reading '%s': %s\n", name, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+  return data;
+}
+
+static void run_input(FILE *file, const char *name, unsigned timeout) {
+  uint8_t *data;
+  size_t size;
+
+  data = read_input(file, name, &size);
+  alarm(timeout);
+  LLVMFuzzerTestOneInput(data, size);
+  alarm(0);
+  free(data);
+}
+
+int main(int argc, char *argv[]) {
+  const char *timeout_text = getenv("FUZZ_TIMEOUT");
+  unsigned timeout = timeout_text == NULL ? 60 : (unsigned)atoi(timeout_text);
+  int i;
+
+  signal(SIGALRM, alarm_handler);
+  LLVMFuzzerInitialize(&argc, &argv);
+
+  if (argc < 2) {
+    run_input(stdin, "<stdin>", timeout);
+    return EXIT_SUCCESS;
+  }
+
+  for (i = 1; i < argc; i++) {
+    FILE *file;
+
+    if ((file = fopen(argv[i], "rb")) == NULL) {
+      fprintf(stderr, "Can't open '%s': %s\n", argv[i], strerror(errno));
+      return EXIT_FAILURE;
+    }
+    run_input(file, argv[i], timeout);
+    fclose(file);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,25 @@
+#!/bin/bash
+
+# Write a language file with all %include directives replaced by the contents of the included
+# files. The load fuzz target does not resolve includes, so this is used to make seed inputs
+# that contain a complete grammar.
+
+DATADIR="`dirname $0`/../../src/data"
+
+if [ $# -ne 1 ] ; then
+	echo "Usage: flatten.sh <language file>"
+	exit 1
+fi
+
+flatten() {
+	local LINE
+	while IFS= read -r LINE || [ -n "$LINE" ] ; do
+		if [[ "$LINE" =~ ^[[:space:]]*%include[[:space:]]*=[[:space:]]*\"([^\"]*)\" ]] ; then
+			flatten "$DATADIR/${BASH_REMATCH[1]}"
+		else
+			printf '%s\n' "$LINE"
+		fi
+	done < "$1"
+}
+
+flatten "$1"
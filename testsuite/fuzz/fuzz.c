@@ -0,0 +1,94 @@
+/* Copyright (C) 2026 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fuzz.h"
+
+static long base_ns = -1, ns_per_byte;
+static struct timespec start_time;
+static size_t input_size;
+static double budget_ns;
+
+static long get_env_long(const char *name, long default_value) {
+  const char *value = getenv(name);
+  char *end;
+  long result;
+
+  if (value == NULL || *value == 0) {
+    return default_value;
+  }
+  result = strtol(value, &end, 10);
+  if (*end != 0 || result < 0) {
+    fprintf(stderr, "Invalid value for %s: %s\n", name, value);
+    exit(EXIT_FAILURE);
+  }
+  return result;
+}
+
+void fuzz_start(size_t size) {
+  if (base_ns < 0) {
+    base_ns = get_env_long("FUZZ_BASE_MS", 200) * 1000000L;
+    ns_per_byte = get_env_long("FUZZ_NS_PER_BYTE", 20000);
+  }
+  input_size = size;
+  budget_ns = (double)base_ns + (double)ns_per_byte * (double)size;
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+}
+
+void fuzz_check(void) {
+  struct timespec now;
+  double elapsed_ns;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  elapsed_ns = (double)(now.tv_sec - start_time.tv_sec) * 1e9 +
+               (double)(now.tv_nsec - start_time.tv_nsec);
+  if (elapsed_ns > budget_ns) {
+    fprintf(stderr, "Slow input: %lu bytes took more than %.0f ms (%.0f ns per byte)\n",
+            (unsigned long)input_size, elapsed_ns / 1e6,
+            elapsed_ns / (double)(input_size == 0 ? 1 : input_size));
+    abort();
+  }
+}
+
+void fuzz_highlight(const t3_highlight_t *highlight, const char *data, size_t size) {
+  t3_highlight_match_t *match;
+  const char *line, *end = data + size;
+
+  if ((match = t3_highlight_new_match(highlight)) == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    abort();
+  }
+
+  for (line = data; line < end;) {
+    const char *newline = memchr(line, '\n', end - line);
+    size_t length = newline == NULL ? (size_t)(end - line) : (size_t)(newline - line);
+
+    t3_highlight_next_line(match);
+    while (t3_highlight_match(match, line, length)) {
+      fuzz_check();
+    }
+    fuzz_check();
+    line += length + 1;
+  }
+  t3_highlight_free_match(match);
+}
+
+int fuzz_map_style(void *data, const char *name) {
+  (void)data;
+  (void)name;
+  return 0;
+}
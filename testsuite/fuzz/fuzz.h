@@ -0,0 +1,42 @@
+/* Copyright (C) 2026 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef FUZZ_H
+#define FUZZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <t3highlight/highlight.h>
+
+/* The entry points used by libFuzzer. For AFL and for running the regression corpus, they are
+   called from the main function in driver.c. */
+int LLVMFuzzerInitialize(int *argc, char ***argv);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+/** Start timing the handling of an input of @p size bytes. */
+void fuzz_start(size_t size);
+/** Abort if the time since ::fuzz_start exceeds the budget for the input.
+
+    The budget is FUZZ_BASE_MS milliseconds (default 200) plus FUZZ_NS_PER_BYTE nanoseconds
+    (default 20000) for each byte of input, both taken from the environment. Aborting makes
+    libFuzzer and AFL store the input, such that slow inputs are found like crashes.
+*/
+void fuzz_check(void);
+
+/** Highlight @p data as a sequence of lines, calling ::fuzz_check after each match. */
+void fuzz_highlight(const t3_highlight_t *highlight, const char *data, size_t size);
+
+/** Style mapping function for loading highlighting patterns, which maps all styles to 0. */
+int fuzz_map_style(void *data, const char *name);
+
+#endif
@@ -0,0 +1,59 @@
+#!/bin/bash
+
+# Run libFuzzer on one of the fuzz targets. The corpus is kept in work/, and inputs that crash,
+# hang or are too slow (see fuzz.h) are written to work/artifacts/. Use minimize.sh to add them
+# to the regression corpus.
+#
+# For AFL, build the stand-alone targets with CC=afl-clang-fast instead, and run them with the
+# same environment variables (FUZZ_LANGUAGE, FUZZ_BASE_MS, FUZZ_NS_PER_BYTE).
+
+cd `dirname $0`
+
+usage() {
+	echo "Usage: fuzz.sh match <language> [<libFuzzer options>]"
+	echo "       fuzz.sh load [<libFuzzer options>]"
+	echo "<language> is the name of a language file in src/data, without .lang"
+	exit 1
+}
+
+[ $# -ge 1 ] || usage
+TARGET="$1"
+shift
+
+case "$TARGET" in
+	match)
+		[ $# -ge 1 ] || usage
+		NAME="$1"
+		shift
+		export FUZZ_LANGUAGE="../../src/data/$NAME.lang"
+		if [ ! -f "$FUZZ_LANGUAGE" ] ; then
+			echo "No language file $FUZZ_LANGUAGE"
+			exit 1
+		fi
+		CORPUS="work/corpus-match-$NAME"
+		SEEDS="../../src.bench/corpus/$NAME regress/match/$NAME"
+		;;
+	load)
+		NAME=all
+		CORPUS="work/corpus-load"
+		SEEDS="work/seeds-load regress/load"
+		mkdir -p work/seeds-load
+		for i in ../../src/data/*.lang ; do
+			./flatten.sh "$i" > "work/seeds-load/`basename \"$i\"`"
+		done
+		;;
+	*)
+		usage
+		;;
+esac
+
+make -s libfuzzer-$TARGET || exit 1
+mkdir -p "$CORPUS" "work/artifacts/$TARGET-$NAME"
+
+EXISTING_SEEDS=
+for i in $SEEDS ; do
+	[ -e "$i" ] && EXISTING_SEEDS="$EXISTING_SEEDS $i"
+done
+
+exec ./libfuzzer-$TARGET -timeout=${TIMEOUT:-10} -max_len=${MAX_LEN:-65536} \
+	-artifact_prefix="work/artifacts/$TARGET-$NAME/" "$@" "$CORPUS" $EXISTING_SEEDS
@@ -0,0 +1,60 @@
+/* Copyright (C) 2026 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/* Fuzz target for t3_highlight_new. The input is a language file. If it is accepted, a fixed
+   sample and the input itself are highlighted with it, such that patterns which only cause
+   trouble while matching (e.g. empty start patterns and catastrophic backtracking) are
+   found as well. */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fuzz.h"
+
+static const char sample[] =
+    "int main(int argc, char *argv[]) { /* comment */ return 0; } // end\n"
+    "#include <stdio.h>\n"
+    "<html><body class=\"x\">text &amp; more</body></html>\n"
+    "x = 'str\\'ing' + \"str\\\"ing\" + `${a}` if a else b # comment\n"
+    "$var @array %hash <<EOF s/a/b/g qw(a b) 0x1F 1.5e10\n"
+    "\t  \n"
+    "\n"
+    "\xc3\xa9\xe2\x82\xac aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa!\n";
+
+int LLVMFuzzerInitialize(int *argc, char ***argv) {
+  (void)argc;
+  (void)argv;
+  return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  t3_config_error_t config_error;
+  t3_config_t *config;
+  t3_highlight_t *highlight;
+
+  fuzz_start(size);
+  if ((config = t3_config_read_buffer((const char *)data, size, &config_error, NULL)) == NULL) {
+    return 0;
+  }
+
+  highlight = t3_highlight_new(config, fuzz_map_style, NULL, T3_HIGHLIGHT_UTF8, NULL);
+  t3_config_delete(config);
+  fuzz_check();
+  if (highlight == NULL) {
+    return 0;
+  }
+
+  fuzz_highlight(highlight, sample, sizeof(sample) - 1);
+  fuzz_highlight(highlight, (const char *)data, size);
+  t3_highlight_free(highlight);
+  return 0;
+}
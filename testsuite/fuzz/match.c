@@ -0,0 +1,57 @@
+/* Copyright (C) 2026 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/* Fuzz target for t3_highlight_match. The input is highlighted as text, using the language
+   named by the FUZZ_LANGUAGE environment variable. This is either the name of a bundled
+   language, or the name of a language file if it contains a slash. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fuzz.h"
+
+static t3_highlight_t *highlight;
+
+int LLVMFuzzerInitialize(int *argc, char ***argv) {
+  const char *language = getenv("FUZZ_LANGUAGE");
+  t3_highlight_error_t error;
+
+  (void)argc;
+  (void)argv;
+
+  if (language == NULL || *language == 0) {
+    fprintf(stderr, "FUZZ_LANGUAGE must be set to the language to highlight\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (strchr(language, '/') != NULL) {
+    highlight = t3_highlight_load(language, fuzz_map_style, NULL,
+                                  T3_HIGHLIGHT_UTF8 | T3_HIGHLIGHT_VERBOSE_ERROR, &error);
+  } else {
+    highlight = t3_highlight_load_by_langname(language, fuzz_map_style, NULL,
+                                              T3_HIGHLIGHT_UTF8 | T3_HIGHLIGHT_VERBOSE_ERROR |
+                                                  T3_HIGHLIGHT_USE_PATH,
+                                              &error);
+  }
+  if (highlight == NULL) {
+    fprintf(stderr, "Error loading %s: %s\n", language, t3_highlight_strerror(error.error));
+    exit(EXIT_FAILURE);
+  }
+  return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  fuzz_start(size);
+  fuzz_highlight(highlight, (const char *)data, size);
+  return 0;
+}
@@ -0,0 +1,33 @@
+#!/bin/bash
+
+# Minimize an input found by fuzz.sh and add it to the regression corpus, which is run by
+# runtests.sh. libFuzzer can only minimize inputs that still fail, so do this before fixing
+# the problem.
+
+cd `dirname $0`
+
+if [ $# -lt 2 ] || { [ "$1" = match ] && [ $# -lt 3 ] ; } ; then
+	echo "Usage: minimize.sh match <language> <input> [<name>]"
+	echo "       minimize.sh load <input> [<name>]"
+	exit 1
+fi
+
+TARGET="$1"
+if [ "$TARGET" = match ] ; then
+	export FUZZ_LANGUAGE="../../src/data/$2.lang"
+	DIR="regress/match/$2"
+	shift
+else
+	DIR="regress/load"
+fi
+INPUT="$2"
+NAME="${3:-`basename \"$INPUT\"`}"
+
+make -s libfuzzer-$TARGET || exit 1
+mkdir -p "$DIR"
+
+./libfuzzer-$TARGET -minimize_crash=1 -runs=${RUNS:-10000} -timeout=${TIMEOUT:-10} \
+	-exact_artifact_path="$DIR/$NAME" "$INPUT"
+# If the input no longer fails, libFuzzer does not write a result and the input is kept as is.
+[ -f "$DIR/$NAME" ] || cp "$INPUT" "$DIR/$NAME"
+echo "Added $DIR/$NAME"
@@ -0,0 +1,41 @@
+#!/bin/bash
+
+# Run the fuzz targets on the benchmark corpus, the bundled language files and the regression
+# corpus. This uses the stand-alone driver, so no fuzzer is required. Inputs that crash or take
+# more than the allowed time per byte (see fuzz.h) make the testsuite fail.
+
+cd `dirname $0`
+
+make -s fuzz-match fuzz-load || exit 1
+
+[ -d work ] || mkdir work
+
+RETVAL=0
+
+run() {
+	if ! "$@" 2> work/fuzz.log ; then
+		echo -e "\\033[31;1mFailed: $*\\033[0m"
+		sed -r 's/^/  /' work/fuzz.log | head -20
+		RETVAL=1
+	fi
+}
+
+for i in ../../src/data/*.lang ; do
+	NAME="`basename \"$i\" .lang`"
+	for j in "../../src.bench/corpus/$NAME" regress/match/"$NAME"/* ; do
+		[ -f "$j" ] || continue
+		FUZZ_LANGUAGE="$i" run ./fuzz-match "$j"
+	done
+	./flatten.sh "$i" > "work/$NAME.lang"
+	run ./fuzz-load "work/$NAME.lang"
+done
+
+for i in regress/load/* ; do
+	[ -f "$i" ] || continue
+	run ./fuzz-load "$i"
+done
+
+if [ "$RETVAL" -eq 0 ] ; then
+	echo "Testsuite passed correctly"
+fi
+exit $RETVAL
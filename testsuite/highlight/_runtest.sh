@@ -33,7 +33,6 @@ fail() {
 
 csplit "$1" -ftest -z -s '/^#TEST/' '{*}' 2>/dev/null
 mv test00 pattern
-sed -i '/^#TEST/d' test*
 
 failed=0
 for i in test[0-9][0-9] ; do
@@ -41,9 +40,13 @@ for i in test[0-9][0-9] ; do
 		continue
 	fi
 
+	# Extra options for t3highlight can be given after #TEST.
+	options="`sed -n 's/^#TEST//p' $i`"
+	sed -i '/^#TEST/d' $i
 	csplit $i -z -s '/^==/' {*} 2>/dev/null
 	sed -i '/^==/d' xx*
-	../../../src.util/t3highlight -s $PWD/../test.style --language-file=$PWD/pattern xx00 > out
+	../../../src.util/t3highlight $options -s $PWD/../test.style --language-file=$PWD/pattern xx00 | \
+		sed "s%$PWD/%%g" > out
 	if ! diff -u xx01 out ; then
 		let failed++
 	fi